@@ -11,6 +11,10 @@
 
 #include <stdint.h>
 
+#ifdef RTE_NET_NTACC
+#include <rte_pmd_ntacc.h>
+#endif
+
 #include "flow_gen.h"
 #include "items_gen.h"
 #include "actions_gen.h"
@@ -34,6 +38,36 @@ fill_attributes(struct rte_flow_attr *attr,
 	attr->group = group;
 }
 
+static void
+fill_rule(struct rte_flow_attr *attr,
+	struct rte_flow_item *items,
+	struct rte_flow_action *actions,
+	uint16_t group,
+	uint64_t *flow_attrs,
+	uint64_t *flow_items,
+	uint64_t *flow_actions,
+	uint16_t next_table,
+	uint32_t outer_ip_src,
+	uint16_t hairpinq,
+	uint64_t encap_data,
+	uint64_t decap_data,
+	uint8_t core_idx,
+	bool unique_data)
+{
+	memset(items, 0, sizeof(struct rte_flow_item) * MAX_ITEMS_NUM);
+	memset(actions, 0, sizeof(struct rte_flow_action) * MAX_ACTIONS_NUM);
+	memset(attr, 0, sizeof(struct rte_flow_attr));
+
+	fill_attributes(attr, flow_attrs, group);
+
+	fill_actions(actions, flow_actions,
+		outer_ip_src, next_table, hairpinq,
+		encap_data, decap_data, core_idx,
+		unique_data);
+
+	fill_items(items, flow_items, outer_ip_src, core_idx);
+}
+
 struct rte_flow *
 generate_flow(uint16_t port_id,
 	uint16_t group,
@@ -54,19 +88,44 @@ generate_flow(uint16_t port_id,
 	struct rte_flow_action actions[MAX_ACTIONS_NUM];
 	struct rte_flow *flow = NULL;
 
-	memset(items, 0, sizeof(items));
-	memset(actions, 0, sizeof(actions));
-	memset(&attr, 0, sizeof(struct rte_flow_attr));
-
-	fill_attributes(&attr, flow_attrs, group);
-
-	fill_actions(actions, flow_actions,
-		outer_ip_src, next_table, hairpinq,
+	fill_rule(&attr, items, actions, group,
+		flow_attrs, flow_items, flow_actions,
+		next_table, outer_ip_src, hairpinq,
 		encap_data, decap_data, core_idx,
 		unique_data);
 
-	fill_items(items, flow_items, outer_ip_src, core_idx);
-
 	flow = rte_flow_create(port_id, &attr, items, actions, error);
 	return flow;
 }
+
+#ifdef RTE_NET_NTACC
+struct rte_flow *
+generate_flow_ntacc_async(uint16_t port_id,
+	uint16_t group,
+	uint64_t *flow_attrs,
+	uint64_t *flow_items,
+	uint64_t *flow_actions,
+	uint16_t next_table,
+	uint32_t outer_ip_src,
+	uint16_t hairpinq,
+	uint64_t encap_data,
+	uint64_t decap_data,
+	uint8_t core_idx,
+	bool unique_data,
+	struct rte_flow_error *error)
+{
+	struct rte_flow_attr attr;
+	struct rte_flow_item items[MAX_ITEMS_NUM];
+	struct rte_flow_action actions[MAX_ACTIONS_NUM];
+
+	fill_rule(&attr, items, actions, group,
+		flow_attrs, flow_items, flow_actions,
+		next_table, outer_ip_src, hairpinq,
+		encap_data, decap_data, core_idx,
+		unique_data);
+
+	/* The rule is copied, so the stack arrays can go out of scope. */
+	return rte_pmd_ntacc_flow_create_async(port_id, &attr, items,
+		actions, NULL, error);
+}
+#endif
@@ -38,4 +38,25 @@ generate_flow(uint16_t port_id,
 	bool unique_data,
 	struct rte_flow_error *error);
 
+#ifdef RTE_NET_NTACC
+/*
+ * Same as generate_flow(), but only enqueues the flow on a Napatech port.
+ * The flow is created after rte_pmd_ntacc_flow_push().
+ */
+struct rte_flow *
+generate_flow_ntacc_async(uint16_t port_id,
+	uint16_t group,
+	uint64_t *flow_attrs,
+	uint64_t *flow_items,
+	uint64_t *flow_actions,
+	uint16_t next_table,
+	uint32_t outer_ip_src,
+	uint16_t hairpinq,
+	uint64_t encap_data,
+	uint64_t decap_data,
+	uint8_t core_idx,
+	bool unique_data,
+	struct rte_flow_error *error);
+#endif
+
 #endif /* FLOW_PERF_FLOW_GEN */
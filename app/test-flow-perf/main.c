@@ -35,6 +35,10 @@
 #include <rte_ethdev.h>
 #include <rte_flow.h>
 #include <rte_mtr.h>
+#ifdef RTE_NET_NTACC
+#include <rte_pause.h>
+#include <rte_pmd_ntacc.h>
+#endif
 
 #include "config.h"
 #include "flow_gen.h"
@@ -62,6 +66,9 @@ static bool delete_flag;
 static bool dump_socket_mem_flag;
 static bool enable_fwd;
 static bool unique_data;
+#ifdef RTE_NET_NTACC
+static bool ntacc_async;
+#endif
 
 static struct rte_mempool *mbuf_mp;
 static uint32_t nb_lcores;
@@ -134,6 +141,10 @@ usage(char *progname)
 	printf("  --portmask=N: hexadecimal bitmask of ports used\n");
 	printf("  --unique-data: flag to set using unique data for all"
 		" actions that support data, such as header modify and encap actions\n");
+#ifdef RTE_NET_NTACC
+	printf("  --ntacc-async: use the asynchronous flow API of Napatech"
+		" ports, one push per rules batch\n");
+#endif
 
 	printf("To set flow attributes:\n");
 	printf("  --ingress: set ingress attribute in flows\n");
@@ -573,6 +584,9 @@ args_parse(int argc, char **argv)
 		{ "unique-data",                0, 0, 0 },
 		{ "portmask",                   1, 0, 0 },
 		{ "cores",                      1, 0, 0 },
+#ifdef RTE_NET_NTACC
+		{ "ntacc-async",                0, 0, 0 },
+#endif
 		/* Attributes */
 		{ "ingress",                    0, 0, 0 },
 		{ "egress",                     0, 0, 0 },
@@ -772,6 +786,11 @@ args_parse(int argc, char **argv)
 			if (strcmp(lgopts[opt_idx].name,
 					"deletion-rate") == 0)
 				delete_flag = true;
+#ifdef RTE_NET_NTACC
+			if (strcmp(lgopts[opt_idx].name,
+					"ntacc-async") == 0)
+				ntacc_async = true;
+#endif
 			if (strcmp(lgopts[opt_idx].name,
 					"dump-socket-mem") == 0)
 				dump_socket_mem_flag = true;
@@ -1068,6 +1087,40 @@ create_meter_profile(void)
 	}
 }
 
+#ifdef RTE_NET_NTACC
+/*
+ * Push the enqueued flow operations and wait for nb_ops results.
+ */
+static void
+ntacc_async_complete(int port_id, uint32_t nb_ops)
+{
+	struct rte_pmd_ntacc_flow_result res[64];
+	struct rte_flow_error error;
+	int i, n;
+
+	if (rte_pmd_ntacc_flow_push(port_id, &error)) {
+		print_flow_error(error);
+		rte_exit(EXIT_FAILURE, "Error in pushing flows\n");
+	}
+	while (nb_ops) {
+		n = rte_pmd_ntacc_flow_pull(port_id, res, RTE_DIM(res), &error);
+		if (n < 0) {
+			print_flow_error(error);
+			rte_exit(EXIT_FAILURE, "Error in pulling flows\n");
+		}
+		for (i = 0; i < n; i++) {
+			if (res[i].status) {
+				print_flow_error(res[i].error);
+				rte_exit(EXIT_FAILURE, "Error in flow operation\n");
+			}
+		}
+		nb_ops -= n;
+		if (n == 0)
+			rte_pause();
+	}
+}
+#endif
+
 static inline void
 destroy_flows(int port_id, uint8_t core_id, struct rte_flow **flows_list)
 {
@@ -1080,6 +1133,9 @@ destroy_flows(int port_id, uint8_t core_id, struct rte_flow **flows_list)
 	uint32_t i;
 	int rules_batch_idx;
 	int rules_count_per_core;
+#ifdef RTE_NET_NTACC
+	uint32_t pending = 0;
+#endif
 
 	rules_count_per_core = rules_count / mc_pool.cores_count;
 	/* If group > 0 , should add 1 flow which created in group 0 */
@@ -1092,6 +1148,21 @@ destroy_flows(int port_id, uint8_t core_id, struct rte_flow **flows_list)
 			break;
 
 		memset(&error, 0x33, sizeof(error));
+#ifdef RTE_NET_NTACC
+		if (ntacc_async) {
+			if (rte_pmd_ntacc_flow_destroy_async(port_id,
+					flows_list[i], NULL, &error)) {
+				print_flow_error(error);
+				rte_exit(EXIT_FAILURE, "Error in deleting flow\n");
+			}
+			if (!((i + 1) % rules_batch)) {
+				ntacc_async_complete(port_id, pending + 1);
+				pending = 0;
+			} else {
+				pending++;
+			}
+		} else
+#endif
 		if (rte_flow_destroy(port_id, flows_list[i], &error)) {
 			print_flow_error(error);
 			rte_exit(EXIT_FAILURE, "Error in deleting flow\n");
@@ -1113,6 +1184,15 @@ destroy_flows(int port_id, uint8_t core_id, struct rte_flow **flows_list)
 		}
 	}
 
+#ifdef RTE_NET_NTACC
+	/* Wait for the flows after the last full batch. */
+	if (pending) {
+		ntacc_async_complete(port_id, pending);
+		cpu_time_used += (double)(rte_get_timer_cycles() -
+			start_batch) / rte_get_timer_hz();
+	}
+#endif
+
 	/* Print deletion rates for all batches */
 	if (dump_iterations)
 		print_rules_batches(cpu_time_per_batch);
@@ -1144,6 +1224,9 @@ insert_flows(int port_id, uint8_t core_id)
 	uint64_t global_actions[MAX_ACTIONS_NUM] = { 0 };
 	int rules_batch_idx;
 	int rules_count_per_core;
+#ifdef RTE_NET_NTACC
+	uint32_t pending = 0;
+#endif
 
 	rules_count_per_core = rules_count / mc_pool.cores_count;
 
@@ -1185,6 +1268,16 @@ insert_flows(int port_id, uint8_t core_id)
 
 	start_batch = rte_get_timer_cycles();
 	for (counter = start_counter; counter < end_counter; counter++) {
+#ifdef RTE_NET_NTACC
+		if (ntacc_async)
+			flow = generate_flow_ntacc_async(port_id, flow_group,
+				flow_attrs, flow_items, flow_actions,
+				JUMP_ACTION_TABLE, counter,
+				hairpin_queues_num,
+				encap_data, decap_data,
+				core_id, unique_data, &error);
+		else
+#endif
 		flow = generate_flow(port_id, flow_group,
 			flow_attrs, flow_items, flow_actions,
 			JUMP_ACTION_TABLE, counter,
@@ -1211,6 +1304,10 @@ insert_flows(int port_id, uint8_t core_id)
 		}
 
 		flows_list[flow_index++] = flow;
+#ifdef RTE_NET_NTACC
+		if (ntacc_async)
+			pending++;
+#endif
 
 		/*
 		 * Save the insertion rate for rules batch.
@@ -1219,6 +1316,12 @@ insert_flows(int port_id, uint8_t core_id)
 		 * for this batch.
 		 */
 		if (!((counter + 1) % rules_batch)) {
+#ifdef RTE_NET_NTACC
+			if (ntacc_async) {
+				ntacc_async_complete(port_id, pending);
+				pending = 0;
+			}
+#endif
 			end_batch = rte_get_timer_cycles();
 			delta = (double) (end_batch - start_batch);
 			rules_batch_idx = ((counter + 1) / rules_batch) - 1;
@@ -1228,6 +1331,15 @@ insert_flows(int port_id, uint8_t core_id)
 		}
 	}
 
+#ifdef RTE_NET_NTACC
+	/* Wait for the flows after the last full batch. */
+	if (pending) {
+		ntacc_async_complete(port_id, pending);
+		cpu_time_used += (double)(rte_get_timer_cycles() -
+			start_batch) / rte_get_timer_hz();
+	}
+#endif
+
 	/* Print insertion rates for all batches */
 	if (dump_iterations)
 		print_rules_batches(cpu_time_per_batch);
@@ -14,6 +14,7 @@
 #include <rte_malloc.h>
 #include <rte_cycles.h>
 #include <rte_random.h>
+#include <rte_errno.h>
 #include <rte_memory.h>
 #include <rte_eal.h>
 #include <rte_ip.h>
@@ -777,6 +778,94 @@ static int test_five_keys(void)
 	return 0;
 }
 
+/*
+ * Bulk add and delete of five keys.
+ *	- add the 5 keys with data in bulk: 5 OK
+ *	- lookup the 5 keys: 5 hits with their data
+ *	- add the 5 keys again with new data: 5 OK at the same positions
+ *	- delete the 5 keys in bulk, plus an absent one: 5 OK
+ *	- lookup the 5 keys: 5 misses
+ */
+static int test_five_keys_bulk(void)
+{
+	struct rte_hash *handle;
+	const void *key_array[6] = {0};
+	void *data_array[5];
+	void *data;
+	int32_t pos[6];
+	int32_t expected_pos[5];
+	struct flow_key absent_key;
+	unsigned i;
+	int ret;
+
+	ut_params.name = "test_bulk";
+	handle = rte_hash_create(&ut_params);
+	RETURN_IF_ERROR(handle == NULL, "hash creation failed");
+
+	for (i = 0; i < 5; i++) {
+		key_array[i] = &keys[i];
+		data_array[i] = (void *)(uintptr_t)(i + 1);
+	}
+
+	/* Add */
+	ret = rte_hash_add_bulk(handle, key_array, data_array, 5, pos);
+	RETURN_IF_ERROR(ret != 5, "failed to add keys in bulk (%d)", ret);
+	for (i = 0; i < 5; i++) {
+		print_key_info("Add", &keys[i], pos[i]);
+		RETURN_IF_ERROR(pos[i] < 0,
+				"failed to add key (pos[%u]=%d)", i, pos[i]);
+		expected_pos[i] = pos[i];
+	}
+
+	/* Lookup */
+	for (i = 0; i < 5; i++) {
+		ret = rte_hash_lookup_data(handle, &keys[i], &data);
+		print_key_info("Lkp", &keys[i], ret);
+		RETURN_IF_ERROR(ret != expected_pos[i] ||
+				data != data_array[i],
+				"failed to find key (pos[%u]=%d)", i, ret);
+	}
+
+	/* Add - update */
+	for (i = 0; i < 5; i++)
+		data_array[i] = (void *)(uintptr_t)(i + 10);
+	ret = rte_hash_add_bulk(handle, key_array, data_array, 5, pos);
+	RETURN_IF_ERROR(ret != 5, "failed to update keys in bulk (%d)", ret);
+	for (i = 0; i < 5; i++) {
+		RETURN_IF_ERROR(pos[i] != expected_pos[i],
+				"failed to add key (pos[%u]=%d)", i, pos[i]);
+		ret = rte_hash_lookup_data(handle, &keys[i], &data);
+		RETURN_IF_ERROR(data != data_array[i],
+				"key %u data not updated", i);
+	}
+
+	/* Delete, with one key not in the table */
+	memcpy(&absent_key, &keys[0], sizeof(absent_key));
+	absent_key.proto++;
+	key_array[5] = &absent_key;
+	ret = rte_hash_del_bulk(handle, key_array, 6, pos);
+	RETURN_IF_ERROR(ret != 5, "failed to delete keys in bulk (%d)", ret);
+	for (i = 0; i < 5; i++) {
+		print_key_info("Del", &keys[i], pos[i]);
+		RETURN_IF_ERROR(pos[i] != expected_pos[i],
+				"failed to delete key (pos[%u]=%d)", i, pos[i]);
+	}
+	RETURN_IF_ERROR(pos[5] != -ENOENT,
+			"deleted non-existent key (pos[5]=%d)", pos[5]);
+
+	/* Lookup */
+	for (i = 0; i < 5; i++) {
+		pos[i] = rte_hash_lookup(handle, &keys[i]);
+		print_key_info("Lkp", &keys[i], pos[i]);
+		RETURN_IF_ERROR(pos[i] != -ENOENT,
+				"found non-existent key (pos[%u]=%d)", i, pos[i]);
+	}
+
+	rte_hash_free(handle);
+
+	return 0;
+}
+
 /*
  * Add keys to the same bucket until bucket full.
  *	- add 5 keys to the same bucket (hash created with 4 keys per bucket):
@@ -1818,7 +1907,7 @@ test_hash_add_delete_jhash_3word(void)
 static struct rte_hash *g_handle;
 static struct rte_rcu_qsbr *g_qsv;
 static volatile uint8_t writer_done;
-struct flow_key g_rand_keys[9];
+struct flow_key g_rand_keys[RTE_HASH_BUCKET_ENTRIES + 1];
 
 /*
  * rte_hash_rcu_qsbr_add positive and negative tests.
@@ -1889,9 +1978,10 @@ test_hash_rcu_qsbr_add(void)
 /*
  * rte_hash_rcu_qsbr_add DQ mode functional test.
  * Reader and writer are in the same thread in this test.
- *  - Create hash which supports maximum 8 (9 if ext bkt is enabled) entries
+ *  - Create hash which supports maximum RTE_HASH_BUCKET_ENTRIES (+1 if ext
+ *    bkt is enabled) entries
  *  - Add RCU QSBR variable to hash
- *  - Add 8 hash entries and fill the bucket
+ *  - Add RTE_HASH_BUCKET_ENTRIES hash entries and fill the bucket
  *  - If ext bkt is enabled, add 1 extra entry that is available in the ext bkt
  *  - Register a reader thread (not a real thread)
  *  - Reader lookup existing entry
@@ -1905,7 +1995,8 @@ test_hash_rcu_qsbr_add(void)
 static int
 test_hash_rcu_qsbr_dq_mode(uint8_t ext_bkt)
 {
-	uint32_t total_entries = (ext_bkt == 0) ? 8 : 9;
+	uint32_t total_entries = (ext_bkt == 0) ? RTE_HASH_BUCKET_ENTRIES :
+			RTE_HASH_BUCKET_ENTRIES + 1;
 
 	uint8_t hash_extra_flag = RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF;
 
@@ -2067,7 +2158,8 @@ test_hash_rcu_qsbr_reader(void *arg)
 /*
  * rte_hash_rcu_qsbr_add sync mode functional test.
  * 1 Reader and 1 writer. They cannot be in the same thread in this test.
- *  - Create hash which supports maximum 8 (9 if ext bkt is enabled) entries
+ *  - Create hash which supports maximum RTE_HASH_BUCKET_ENTRIES (+1 if ext
+ *    bkt is enabled) entries
  *  - Add RCU QSBR variable to hash
  *  - Register a reader thread. Reader keeps looking up a specific key.
  *  - Writer keeps adding and deleting a specific key.
@@ -2075,7 +2167,8 @@ test_hash_rcu_qsbr_reader(void *arg)
 static int
 test_hash_rcu_qsbr_sync_mode(uint8_t ext_bkt)
 {
-	uint32_t total_entries = (ext_bkt == 0) ? 8 : 9;
+	uint32_t total_entries = (ext_bkt == 0) ? RTE_HASH_BUCKET_ENTRIES :
+			RTE_HASH_BUCKET_ENTRIES + 1;
 
 	uint8_t hash_extra_flag = RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF;
 
@@ -2174,6 +2267,465 @@ test_hash_rcu_qsbr_sync_mode(uint8_t ext_bkt)
 
 }
 
+/*
+ * rte_hash_resize functional test.
+ *  - Fill a table of 32 entries
+ *  - Grow it to 128 entries, check keys kept their positions
+ *  - Fill the new entries
+ *  - Shrink it back while it holds more than 32 keys (-ENOSPC)
+ *  - Delete all but 32 keys, spread over all positions, and shrink.
+ *    Check the remaining keys and their data, and that the table
+ *    is full again
+ */
+#define RESIZE_SMALL_ENTRIES	32
+#define RESIZE_LARGE_ENTRIES	128
+
+static int
+test_hash_resize(uint8_t lf)
+{
+	struct rte_hash *handle;
+	struct rte_hash_parameters params;
+	struct rte_hash_rcu_config rcu_cfg = {0};
+	struct rte_rcu_qsbr *qsv = NULL;
+	struct flow_key resize_keys[RESIZE_LARGE_ENTRIES];
+	int32_t pos[RESIZE_SMALL_ENTRIES];
+	unsigned int i, remaining = 0;
+	int ret;
+
+	if (lf)
+		printf("\n# Running hash resize test with lock free "
+		       "concurrency\n");
+	else
+		printf("\n# Running hash resize test\n");
+
+	memcpy(&params, &ut_params, sizeof(params));
+	params.name = "test_hash_resize";
+	params.entries = RESIZE_SMALL_ENTRIES;
+	params.extra_flag = RTE_HASH_EXTRA_FLAGS_EXT_TABLE;
+	if (lf)
+		params.extra_flag |= RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF;
+	handle = rte_hash_create(&params);
+	RETURN_IF_ERROR(handle == NULL, "hash creation failed");
+
+	if (lf) {
+		/* Lock free tables are resized through RCU QSBR */
+		ret = rte_hash_resize(handle, RESIZE_LARGE_ENTRIES);
+		RETURN_IF_ERROR(ret != -ENOTSUP,
+				"resize without RCU QSBR returned %d", ret);
+
+		qsv = rte_zmalloc(NULL, rte_rcu_qsbr_get_memsize(RTE_MAX_LCORE),
+				  RTE_CACHE_LINE_SIZE);
+		RETURN_IF_ERROR(qsv == NULL, "RCU QSBR variable creation failed");
+		rte_rcu_qsbr_init(qsv, RTE_MAX_LCORE);
+
+		rcu_cfg.v = qsv;
+		rcu_cfg.mode = RTE_HASH_QSBR_MODE_DQ;
+		ret = rte_hash_rcu_qsbr_add(handle, &rcu_cfg);
+		RETURN_IF_ERROR(ret != 0, "attach RCU QSBR to hash table failed");
+	}
+
+	ret = rte_hash_resize(handle, 0);
+	RETURN_IF_ERROR(ret != -EINVAL, "resize to 0 entries returned %d",
+			ret);
+
+	memset(resize_keys, 0, sizeof(resize_keys));
+	for (i = 0; i < RESIZE_LARGE_ENTRIES; i++) {
+		resize_keys[i].ip_src = i;
+		resize_keys[i].port_src = i;
+	}
+
+	for (i = 0; i < RESIZE_SMALL_ENTRIES; i++) {
+		ret = rte_hash_add_key_data(handle, &resize_keys[i],
+				(void *)(uintptr_t)i);
+		RETURN_IF_ERROR(ret != 0, "failed to add key %u (%d)", i, ret);
+		pos[i] = rte_hash_lookup(handle, &resize_keys[i]);
+	}
+	ret = rte_hash_add_key(handle, &resize_keys[i]);
+	RETURN_IF_ERROR(ret != -ENOSPC, "added key to a full table (%d)", ret);
+
+	ret = rte_hash_resize(handle, RESIZE_LARGE_ENTRIES);
+	RETURN_IF_ERROR(ret != 0, "failed to grow table (%d)", ret);
+
+	for (i = 0; i < RESIZE_SMALL_ENTRIES; i++) {
+		ret = rte_hash_lookup(handle, &resize_keys[i]);
+		RETURN_IF_ERROR(ret != pos[i], "key %u moved from %d to %d",
+				i, pos[i], ret);
+	}
+	for (; i < RESIZE_LARGE_ENTRIES; i++) {
+		ret = rte_hash_add_key_data(handle, &resize_keys[i],
+				(void *)(uintptr_t)i);
+		RETURN_IF_ERROR(ret != 0, "failed to add key %u (%d)", i, ret);
+	}
+	ret = rte_hash_count(handle);
+	RETURN_IF_ERROR(ret != RESIZE_LARGE_ENTRIES,
+			"hash count is %d after grow", ret);
+
+	ret = rte_hash_resize(handle, RESIZE_SMALL_ENTRIES);
+	RETURN_IF_ERROR(ret != -ENOSPC, "shrink below the key count "
+			"returned %d", ret);
+
+	/* Keep one key in four, so keys remain at high positions */
+	for (i = 0; i < RESIZE_LARGE_ENTRIES; i++) {
+		if (i % (RESIZE_LARGE_ENTRIES / RESIZE_SMALL_ENTRIES) == 0)
+			continue;
+		ret = rte_hash_del_key(handle, &resize_keys[i]);
+		RETURN_IF_ERROR(ret < 0, "failed to delete key %u (%d)", i,
+				ret);
+	}
+
+	ret = rte_hash_resize(handle, RESIZE_SMALL_ENTRIES);
+	RETURN_IF_ERROR(ret != 0, "failed to shrink table (%d)", ret);
+
+	for (i = 0; i < RESIZE_LARGE_ENTRIES; i++) {
+		void *data;
+
+		ret = rte_hash_lookup_data(handle, &resize_keys[i], &data);
+		if (i % (RESIZE_LARGE_ENTRIES / RESIZE_SMALL_ENTRIES) == 0) {
+			RETURN_IF_ERROR(ret < 0 || ret >= RESIZE_SMALL_ENTRIES,
+					"key %u found at %d after shrink",
+					i, ret);
+			RETURN_IF_ERROR((uintptr_t)data != i,
+					"key %u lost its data", i);
+			remaining++;
+		} else
+			RETURN_IF_ERROR(ret != -ENOENT,
+					"deleted key %u found at %d", i, ret);
+	}
+	ret = rte_hash_count(handle);
+	RETURN_IF_ERROR(ret != (int)remaining,
+			"hash count is %d after shrink", ret);
+	ret = rte_hash_add_key(handle, &resize_keys[1]);
+	RETURN_IF_ERROR(ret != -ENOSPC, "added key to a full table after "
+			"shrink (%d)", ret);
+
+	rte_hash_free(handle);
+	rte_free(qsv);
+
+	return 0;
+}
+
+/*
+ * Lookups running on another lcore while the table is resized.
+ *  - Fill half of a table of 1024 entries
+ *  - A reader keeps looking up these keys, they must always be found
+ *  - The writer adds and deletes other keys, and grows and shrinks the
+ *    table repeatedly
+ */
+#define RESIZE_CONC_ENTRIES	1024
+#define RESIZE_CONC_KEYS	256
+#define RESIZE_CONC_ROUNDS	32
+
+/*
+ * Keys 0 to RESIZE_CONC_KEYS - 1 stay in the table, the others are added
+ * in each round to place RESIZE_CONC_KEYS of them at positions past the
+ * shrunk size.
+ */
+static struct flow_key resize_conc_keys[RESIZE_CONC_KEYS +
+					RESIZE_CONC_ENTRIES * 2];
+static const void *resize_conc_lookup[RESIZE_CONC_KEYS * 2];
+static uint32_t resize_conc_num_lookup;
+static uint32_t resize_conc_passes;
+static uint32_t resize_conc_misses;
+
+static int
+test_hash_resize_reader(void *arg)
+{
+	uint8_t lf = *(uint8_t *)arg;
+	int32_t positions[RTE_HASH_LOOKUP_BULK_MAX];
+	unsigned int i, j, n, num;
+
+	if (lf) {
+		(void)rte_rcu_qsbr_thread_register(g_qsv, 0);
+		rte_rcu_qsbr_thread_online(g_qsv, 0);
+	}
+
+	do {
+		num = __atomic_load_n(&resize_conc_num_lookup,
+				__ATOMIC_ACQUIRE);
+		for (i = 0; i < num; i++) {
+			if (rte_hash_lookup(g_handle,
+					resize_conc_lookup[i]) < 0)
+				__atomic_fetch_add(&resize_conc_misses, 1,
+						__ATOMIC_RELAXED);
+		}
+		for (i = 0; i < num; i += n) {
+			n = RTE_MIN(num - i,
+				(unsigned int)RTE_HASH_LOOKUP_BULK_MAX);
+			rte_hash_lookup_bulk(g_handle, &resize_conc_lookup[i],
+					n, positions);
+			for (j = 0; j < n; j++) {
+				if (positions[j] < 0)
+					__atomic_fetch_add(&resize_conc_misses,
+						1, __ATOMIC_RELAXED);
+			}
+		}
+		if (lf)
+			rte_rcu_qsbr_quiescent(g_qsv, 0);
+		__atomic_fetch_add(&resize_conc_passes, 1, __ATOMIC_RELEASE);
+	} while (!writer_done);
+
+	if (lf) {
+		rte_rcu_qsbr_thread_offline(g_qsv, 0);
+		(void)rte_rcu_qsbr_thread_unregister(g_qsv, 0);
+	}
+
+	return 0;
+}
+
+/* Wait until the reader started a pass after the lookup set changed */
+static void
+test_hash_resize_reader_sync(void)
+{
+	uint32_t passes = __atomic_load_n(&resize_conc_passes,
+			__ATOMIC_ACQUIRE);
+
+	while (__atomic_load_n(&resize_conc_passes, __ATOMIC_ACQUIRE) -
+			passes < 2)
+		rte_pause();
+}
+
+/*
+ * Resize a table while a reader looks keys up. In each round the table
+ * grows, keys are placed at positions past the size it shrinks back to,
+ * and the reader looks them up while the shrink moves them.
+ */
+static int
+test_hash_resize_concurrent(uint8_t lf)
+{
+	struct rte_hash_parameters params;
+	struct rte_hash_rcu_config rcu_cfg = {0};
+	unsigned int i, round, num_hi = 0, next = 0;
+	int32_t pos;
+	int ret;
+
+	if (rte_lcore_count() < 2) {
+		printf("\n# Not enough lcores for the concurrent hash resize "
+		       "test, skipping\n");
+		return 0;
+	}
+	if (lf)
+		printf("\n# Running concurrent hash resize test with lock "
+		       "free concurrency\n");
+	else
+		printf("\n# Running concurrent hash resize test with "
+		       "read/write concurrency\n");
+
+	memcpy(&params, &ut_params, sizeof(params));
+	params.name = "test_hash_resize_conc";
+	params.entries = RESIZE_CONC_ENTRIES;
+	params.extra_flag = lf ? RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF :
+				 RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY;
+	g_qsv = NULL;
+	g_handle = rte_hash_create(&params);
+	RETURN_IF_ERROR_RCU_QSBR(g_handle == NULL, "hash creation failed");
+
+	if (lf) {
+		g_qsv = rte_zmalloc(NULL,
+				rte_rcu_qsbr_get_memsize(RTE_MAX_LCORE),
+				RTE_CACHE_LINE_SIZE);
+		RETURN_IF_ERROR_RCU_QSBR(g_qsv == NULL,
+				"RCU QSBR variable creation failed");
+		rte_rcu_qsbr_init(g_qsv, RTE_MAX_LCORE);
+		rcu_cfg.v = g_qsv;
+		rcu_cfg.mode = RTE_HASH_QSBR_MODE_DQ;
+		ret = rte_hash_rcu_qsbr_add(g_handle, &rcu_cfg);
+		RETURN_IF_ERROR_RCU_QSBR(ret != 0,
+				"attach RCU QSBR to hash table failed");
+	}
+
+	memset(resize_conc_keys, 0, sizeof(resize_conc_keys));
+	for (i = 0; i < RTE_DIM(resize_conc_keys); i++) {
+		resize_conc_keys[i].ip_src = i;
+		resize_conc_keys[i].ip_dst = ~i;
+	}
+	for (i = 0; i < RESIZE_CONC_KEYS; i++) {
+		ret = rte_hash_add_key(g_handle, &resize_conc_keys[i]);
+		RETURN_IF_ERROR_RCU_QSBR(ret < 0, "failed to add key %u (%d)",
+				i, ret);
+		resize_conc_lookup[i] = &resize_conc_keys[i];
+	}
+
+	resize_conc_num_lookup = RESIZE_CONC_KEYS;
+	resize_conc_passes = 0;
+	resize_conc_misses = 0;
+	writer_done = 0;
+	rte_eal_remote_launch(test_hash_resize_reader, &lf,
+			      rte_get_next_lcore(-1, 1, 0));
+
+	for (round = 0; round < RESIZE_CONC_ROUNDS; round++) {
+		ret = rte_hash_resize(g_handle, 4 * RESIZE_CONC_ENTRIES);
+		if (ret != 0)
+			break;
+
+		/* Fill the low positions until enough keys sit past the
+		 * shrunk size, then take the others out again.
+		 */
+		num_hi = 0;
+		for (next = RESIZE_CONC_KEYS;
+				next < RTE_DIM(resize_conc_keys) &&
+				num_hi < RESIZE_CONC_KEYS; next++) {
+			pos = rte_hash_add_key(g_handle,
+					&resize_conc_keys[next]);
+			if (pos < 0)
+				break;
+			if (pos >= RESIZE_CONC_ENTRIES)
+				resize_conc_lookup[RESIZE_CONC_KEYS +
+					num_hi++] = &resize_conc_keys[next];
+			else
+				rte_hash_del_key(g_handle,
+						&resize_conc_keys[next]);
+		}
+		if (num_hi < RESIZE_CONC_KEYS) {
+			ret = -ENOSPC;
+			break;
+		}
+		__atomic_store_n(&resize_conc_num_lookup,
+				RESIZE_CONC_KEYS + num_hi, __ATOMIC_RELEASE);
+
+		ret = rte_hash_resize(g_handle, RESIZE_CONC_ENTRIES);
+		if (ret != 0)
+			break;
+
+		/* The moved keys are still found after the shrink */
+		for (i = RESIZE_CONC_KEYS; i < RESIZE_CONC_KEYS + num_hi;
+				i++) {
+			pos = rte_hash_lookup(g_handle, resize_conc_lookup[i]);
+			if (pos < 0 || pos >= RESIZE_CONC_ENTRIES) {
+				ret = -EFAULT;
+				break;
+			}
+		}
+		if (ret != 0)
+			break;
+
+		__atomic_store_n(&resize_conc_num_lookup, RESIZE_CONC_KEYS,
+				__ATOMIC_RELEASE);
+		test_hash_resize_reader_sync();
+		for (i = RESIZE_CONC_KEYS; i < RESIZE_CONC_KEYS + num_hi; i++)
+			rte_hash_del_key(g_handle, resize_conc_lookup[i]);
+	}
+
+	writer_done = 1;
+	rte_eal_mp_wait_lcore();
+
+	RETURN_IF_ERROR_RCU_QSBR(ret != 0, "resize round %u failed (%d)",
+			round, ret);
+	RETURN_IF_ERROR_RCU_QSBR(resize_conc_misses != 0,
+			"%u lookups missed during resize", resize_conc_misses);
+
+	rte_hash_free(g_handle);
+	rte_free(g_qsv);
+
+	return 0;
+}
+
+/*
+ * Test entry aging:
+ *	- Add keys before and after enabling aging
+ *	- Touch some of them and check only the idle ones expire
+ *	- Check expired keys are reported in several calls when asked to
+ *	- Check deleted keys are not reported and idle keys are reported
+ *	  again after another timeout
+ */
+#define AGING_KEYS 5
+#define AGING_TIMEOUT (1ULL << 20)
+
+static int
+test_hash_aging(void)
+{
+	struct rte_hash *handle;
+	struct rte_hash_parameters params;
+	struct rte_hash_aging_config cfg = {0};
+	struct flow_key aging_keys[AGING_KEYS];
+	const void *key_array[2];
+	int32_t pos[AGING_KEYS], expired[2 * AGING_KEYS], bulk_pos[2];
+	uint64_t now;
+	unsigned int i, j;
+	int ret, n;
+
+	printf("\n# Running hash aging test\n");
+
+	memcpy(&params, &ut_params, sizeof(params));
+	params.name = "test_hash_aging";
+	handle = rte_hash_create(&params);
+	RETURN_IF_ERROR(handle == NULL, "hash creation failed");
+
+	memset(aging_keys, 0, sizeof(aging_keys));
+	for (i = 0; i < AGING_KEYS; i++) {
+		aging_keys[i].ip_src = i;
+		aging_keys[i].port_src = i;
+	}
+
+	ret = rte_hash_aging_expire(handle, rte_get_timer_cycles(), expired,
+				    RTE_DIM(expired));
+	RETURN_IF_ERROR(ret != -EINVAL, "expire without aging returned %d",
+			ret);
+
+	/* Keys already in the table are aged too */
+	for (i = 0; i < 3; i++) {
+		pos[i] = rte_hash_add_key(handle, &aging_keys[i]);
+		RETURN_IF_ERROR(pos[i] < 0, "failed to add key %u (%d)", i,
+				pos[i]);
+	}
+
+	cfg.timeout = AGING_TIMEOUT;
+	ret = rte_hash_aging_add(handle, &cfg);
+	RETURN_IF_ERROR(ret != 0, "failed to enable aging");
+	ret = rte_hash_aging_add(handle, &cfg);
+	RETURN_IF_ERROR(ret == 0 || rte_errno != EEXIST,
+			"aging enabled twice");
+
+	for (; i < AGING_KEYS; i++) {
+		pos[i] = rte_hash_add_key(handle, &aging_keys[i]);
+		RETURN_IF_ERROR(pos[i] < 0, "failed to add key %u (%d)", i,
+				pos[i]);
+	}
+	now = rte_get_timer_cycles() + 2 * AGING_TIMEOUT;
+
+	ret = rte_hash_resize(handle, 2 * ut_params.entries);
+	RETURN_IF_ERROR(ret != -ENOTSUP, "resize with aging returned %d",
+			ret);
+
+	/* Keys 0 and 1 are in use, keys 2 to 4 are idle */
+	key_array[0] = &aging_keys[0];
+	key_array[1] = &aging_keys[1];
+	ret = rte_hash_lookup_bulk_touch(handle, key_array, 2, bulk_pos, now);
+	RETURN_IF_ERROR(ret != 0 || bulk_pos[0] != pos[0] ||
+			bulk_pos[1] != pos[1], "bulk touch lookup failed");
+	ret = rte_hash_lookup_touch(handle, &aging_keys[0], now);
+	RETURN_IF_ERROR(ret != pos[0], "touch lookup returned %d", ret);
+
+	n = rte_hash_aging_expire(handle, now, expired, 2);
+	RETURN_IF_ERROR(n != 2, "first expire returned %d", n);
+	ret = rte_hash_aging_expire(handle, now, &expired[n], 2);
+	RETURN_IF_ERROR(ret != 1, "second expire returned %d", ret);
+	n += ret;
+	for (i = 2; i < AGING_KEYS; i++) {
+		for (j = 0; j < (unsigned int)n; j++)
+			if (expired[j] == pos[i])
+				break;
+		RETURN_IF_ERROR(j == (unsigned int)n,
+				"idle key %u not expired", i);
+	}
+	ret = rte_hash_aging_expire(handle, now, expired, RTE_DIM(expired));
+	RETURN_IF_ERROR(ret != 0, "keys expired twice (%d)", ret);
+
+	/* Deleted keys are dropped, the others all expire in turn */
+	ret = rte_hash_del_key(handle, &aging_keys[2]);
+	RETURN_IF_ERROR(ret != pos[2], "failed to delete key 2 (%d)", ret);
+
+	now += 2 * AGING_TIMEOUT;
+	n = rte_hash_aging_expire(handle, now, expired, RTE_DIM(expired));
+	RETURN_IF_ERROR(n != AGING_KEYS - 1, "last expire returned %d", n);
+	for (j = 0; j < (unsigned int)n; j++)
+		RETURN_IF_ERROR(expired[j] == pos[2],
+				"deleted key reported expired");
+
+	rte_hash_free(handle);
+
+	return 0;
+}
+
 /*
  * Do all unit and performance tests.
  */
@@ -2204,6 +2756,8 @@ test_hash(void)
 		return -1;
 	if (test_five_keys() < 0)
 		return -1;
+	if (test_five_keys_bulk() < 0)
+		return -1;
 	if (test_full_bucket() < 0)
 		return -1;
 	if (test_extendable_bucket() < 0)
@@ -2250,6 +2804,21 @@ test_hash(void)
 	if (test_hash_rcu_qsbr_sync_mode(1) < 0)
 		return -1;
 
+	if (test_hash_resize(0) < 0)
+		return -1;
+
+	if (test_hash_resize(1) < 0)
+		return -1;
+
+	if (test_hash_resize_concurrent(0) < 0)
+		return -1;
+
+	if (test_hash_resize_concurrent(1) < 0)
+		return -1;
+
+	if (test_hash_aging() < 0)
+		return -1;
+
 	return 0;
 }
 
@@ -21,8 +21,7 @@
 #define KEYS_TO_ADD (MAX_ENTRIES)
 #define ADD_PERCENT 0.75 /* 75% table utilization */
 #define NUM_LOOKUPS (KEYS_TO_ADD * 5) /* Loop among keys added, several times */
-/* BUCKET_SIZE should be same as RTE_HASH_BUCKET_ENTRIES in rte_hash library */
-#define BUCKET_SIZE 8
+#define BUCKET_SIZE RTE_HASH_BUCKET_ENTRIES
 #define NUM_BUCKETS (MAX_ENTRIES / BUCKET_SIZE)
 #define MAX_KEYSIZE 64
 #define NUM_KEYSIZES 10
@@ -34,6 +33,8 @@ enum operations {
 	LOOKUP,
 	LOOKUP_MULTI,
 	DELETE,
+	ADD_BULK,
+	DELETE_BULK,
 	NUM_OPERATIONS
 };
 
@@ -555,6 +556,85 @@ timed_deletes(unsigned int with_hash, unsigned int with_data,
 	return 0;
 }
 
+static int
+timed_adds_bulk(unsigned int with_data, unsigned int table_index,
+				unsigned int ext)
+{
+	unsigned int j, k;
+	int32_t positions_burst[BURST_SIZE];
+	const void *keys_burst[BURST_SIZE];
+	void *data_burst[BURST_SIZE];
+	int ret;
+	unsigned int keys_to_add;
+
+	if (!ext)
+		keys_to_add = KEYS_TO_ADD * ADD_PERCENT;
+	else
+		keys_to_add = KEYS_TO_ADD;
+
+	const uint64_t start_tsc = rte_rdtsc();
+
+	for (j = 0; j < keys_to_add/BURST_SIZE; j++) {
+		for (k = 0; k < BURST_SIZE; k++) {
+			keys_burst[k] = keys[j * BURST_SIZE + k];
+			data_burst[k] = (void *) ((uintptr_t)
+					signatures[j * BURST_SIZE + k]);
+		}
+		ret = rte_hash_add_bulk(h[table_index], keys_burst,
+				with_data ? data_burst : NULL,
+				BURST_SIZE, positions_burst);
+		if (ret != BURST_SIZE) {
+			printf("Failed to add keys in burst %u\n", j);
+			return -1;
+		}
+		for (k = 0; k < BURST_SIZE; k++)
+			positions[j * BURST_SIZE + k] = positions_burst[k];
+	}
+
+	const uint64_t end_tsc = rte_rdtsc();
+	const uint64_t time_taken = end_tsc - start_tsc;
+
+	cycles[table_index][ADD_BULK][0][with_data] = time_taken/keys_to_add;
+
+	return 0;
+}
+
+static int
+timed_deletes_bulk(unsigned int with_data, unsigned int table_index,
+				unsigned int ext)
+{
+	unsigned int j, k;
+	int32_t positions_burst[BURST_SIZE];
+	const void *keys_burst[BURST_SIZE];
+	int ret;
+	unsigned int keys_to_add;
+
+	if (!ext)
+		keys_to_add = KEYS_TO_ADD * ADD_PERCENT;
+	else
+		keys_to_add = KEYS_TO_ADD;
+
+	const uint64_t start_tsc = rte_rdtsc();
+
+	for (j = 0; j < keys_to_add/BURST_SIZE; j++) {
+		for (k = 0; k < BURST_SIZE; k++)
+			keys_burst[k] = keys[j * BURST_SIZE + k];
+		ret = rte_hash_del_bulk(h[table_index], keys_burst,
+				BURST_SIZE, positions_burst);
+		if (ret != BURST_SIZE) {
+			printf("Failed to delete keys in burst %u\n", j);
+			return -1;
+		}
+	}
+
+	const uint64_t end_tsc = rte_rdtsc();
+	const uint64_t time_taken = end_tsc - start_tsc;
+
+	cycles[table_index][DELETE_BULK][0][with_data] = time_taken/keys_to_add;
+
+	return 0;
+}
+
 static void
 free_table(unsigned table_index)
 {
@@ -600,6 +680,16 @@ run_all_tbl_perf_tests(unsigned int with_pushes, unsigned int with_locks,
 				if (timed_deletes(with_hash, with_data, i, ext) < 0)
 					return -1;
 
+				/* Bulk operations hash the keys themselves */
+				if (!with_hash) {
+					if (timed_adds_bulk(with_data, i,
+							ext) < 0)
+						return -1;
+					if (timed_deletes_bulk(with_data, i,
+							ext) < 0)
+						return -1;
+				}
+
 				/* Print a dot to show progress on operations */
 				printf(".");
 				fflush(stdout);
@@ -623,12 +713,18 @@ run_all_tbl_perf_tests(unsigned int with_pushes, unsigned int with_locks,
 			else
 				printf("\nWithout pre-computed hash values\n");
 
-			printf("\n%-18s%-18s%-18s%-18s%-18s\n",
-			"Keysize", "Add", "Lookup", "Lookup_bulk", "Delete");
+			printf("\n%-18s%-18s%-18s%-18s%-18s%-18s%-18s\n",
+			"Keysize", "Add", "Lookup", "Lookup_bulk", "Delete",
+			"Add_bulk", "Delete_bulk");
 			for (i = 0; i < NUM_KEYSIZES; i++) {
 				printf("%-18d", hashtest_key_lens[i]);
-				for (j = 0; j < NUM_OPERATIONS; j++)
+				for (j = 0; j < NUM_OPERATIONS; j++) {
+					if (with_hash && j >= ADD_BULK) {
+						printf("%-18s", "-");
+						continue;
+					}
 					printf("%-18"PRIu64, cycles[i][j][with_hash][with_data]);
+				}
 				printf("\n");
 			}
 		}
@@ -636,6 +732,52 @@ run_all_tbl_perf_tests(unsigned int with_pushes, unsigned int with_locks,
 	return 0;
 }
 
+/*
+ * Measure how full a table without extendable buckets gets before the
+ * first key cannot be added, which depends on the number of entries per
+ * bucket.
+ */
+static int
+load_factor_test(void)
+{
+	struct rte_hash *handle;
+	unsigned int i, j;
+	uint64_t r;
+	int32_t ret = 0;
+
+	ut_params.name = "test_hash_load";
+	ut_params.key_len = 16;
+	ut_params.extra_flag = 0;
+	ut_params.socket_id = rte_socket_id();
+	handle = rte_hash_create(&ut_params);
+	if (handle == NULL) {
+		printf("Error creating table\n");
+		return -1;
+	}
+
+	for (i = 0; i < MAX_ENTRIES; i++) {
+		for (j = 0; j < ut_params.key_len; j += sizeof(r)) {
+			r = rte_rand();
+			memcpy(&keys[i][j], &r, sizeof(r));
+		}
+		ret = rte_hash_add_key(handle, keys[i]);
+		if (ret < 0)
+			break;
+	}
+	rte_hash_free(handle);
+
+	if (ret < 0 && ret != -ENOSPC) {
+		printf("Failed to add key number %u (%d)\n", i, ret);
+		return -1;
+	}
+
+	printf("\n *** Load factor at first insertion failure, "
+		"%d entries per bucket: %.2f%% ***\n",
+		BUCKET_SIZE, (double)i * 100 / MAX_ENTRIES);
+
+	return 0;
+}
+
 /* Control operation of performance testing of fbk hash. */
 #define LOAD_FACTOR 0.667	/* How full to make the hash table. */
 #define TEST_SIZE 1000000	/* How many operations to time. */
@@ -743,6 +885,9 @@ test_hash_perf(void)
 	if (run_all_tbl_perf_tests(1, 0, 1) < 0)
 		return -1;
 
+	if (load_factor_test() < 0)
+		return -1;
+
 	if (fbk_hash_perf_test() < 0)
 		return -1;
 
@@ -109,7 +109,7 @@ get_prim_bucket_index(__rte_unused const struct rte_hash *h,
 {
 	uint32_t num_buckets;
 	uint32_t bucket_bitmask;
-	num_buckets  = rte_align32pow2(TOTAL_ENTRY) / 8;
+	num_buckets  = rte_align32pow2(TOTAL_ENTRY) / RTE_HASH_BUCKET_ENTRIES;
 	bucket_bitmask = num_buckets - 1;
 	return hash & bucket_bitmask;
 }
@@ -120,7 +120,7 @@ get_alt_bucket_index(__rte_unused const struct rte_hash *h,
 {
 	uint32_t num_buckets;
 	uint32_t bucket_bitmask;
-	num_buckets  = rte_align32pow2(TOTAL_ENTRY) / 8;
+	num_buckets  = rte_align32pow2(TOTAL_ENTRY) / RTE_HASH_BUCKET_ENTRIES;
 	bucket_bitmask = num_buckets - 1;
 	return (cur_bkt_idx ^ sig) & bucket_bitmask;
 }
@@ -202,9 +202,9 @@ check_bucket(uint32_t bkt_idx, uint32_t key)
 	void *next_data;
 
 	/* Temporary bucket to hold the keys */
-	uint32_t keys_in_bkt[8];
+	uint32_t keys_in_bkt[RTE_HASH_BUCKET_ENTRIES];
 
-	iter = bkt_idx * 8;
+	iter = bkt_idx * RTE_HASH_BUCKET_ENTRIES;
 	prev_iter = iter;
 	while (rte_hash_iterate(tbl_rwc_test_param.h,
 			&next_key, &next_data, &iter) >= 0) {
@@ -223,7 +223,7 @@ check_bucket(uint32_t bkt_idx, uint32_t key)
 		count++;
 
 		/* All entries in the bucket are occupied */
-		if (count == 8) {
+		if (count == RTE_HASH_BUCKET_ENTRIES) {
 
 			/*
 			 * Check if bucket was not scanned before, to avoid
@@ -239,8 +239,9 @@ check_bucket(uint32_t bkt_idx, uint32_t key)
 				 */
 				memcpy(tbl_rwc_test_param.keys_shift_path +
 					tbl_rwc_test_param.count_keys_shift_path
-					, keys_in_bkt, 32);
-				tbl_rwc_test_param.count_keys_shift_path += 8;
+					, keys_in_bkt, sizeof(keys_in_bkt));
+				tbl_rwc_test_param.count_keys_shift_path +=
+							RTE_HASH_BUCKET_ENTRIES;
 				scanned_bkts[bkt_idx] = 1;
 			}
 			return -1;
@@ -370,7 +371,7 @@ generate_keys(void)
 	uint32_t sec_bucket_idx;
 	uint16_t short_sig;
 	uint32_t num_buckets;
-	num_buckets  = rte_align32pow2(TOTAL_ENTRY) / 8;
+	num_buckets  = rte_align32pow2(TOTAL_ENTRY) / RTE_HASH_BUCKET_ENTRIES;
 	int ret;
 
 	/*
@@ -465,12 +466,12 @@ generate_keys(void)
 	for (i = 0; i < num_buckets; i++) {
 		/* Check bucket for no keys shifted to alternate locations */
 		if (scanned_bkts[i] == 0) {
-			iter = i * 8;
+			iter = i * RTE_HASH_BUCKET_ENTRIES;
 			while (rte_hash_iterate(tbl_rwc_test_param.h,
 				&next_key, &next_data, &iter) >= 0) {
 
 				/* Check if key belongs to the current bucket */
-				if (i >= (iter-1)/8)
+				if (i >= (iter-1)/RTE_HASH_BUCKET_ENTRIES)
 					keys_non_shift_path[count++]
 						= *(const uint32_t *)next_key;
 				else
@@ -509,11 +510,11 @@ generate_keys(void)
 	/* Find keys that will shift keys in ext bucket*/
 	for (i = 0; i < num_buckets; i++) {
 		if (scanned_bkts[i] == 1) {
-			iter = i * 8;
+			iter = i * RTE_HASH_BUCKET_ENTRIES;
 			while (rte_hash_iterate(tbl_rwc_test_param.h,
 				&next_key, &next_data, &iter) >= 0) {
 				/* Check if key belongs to the current bucket */
-				if (i >= (iter-1)/8)
+				if (i >= (iter-1)/RTE_HASH_BUCKET_ENTRIES)
 					keys_ks_extbkt[count++]
 						= *(const uint32_t *)next_key;
 				else
@@ -208,6 +208,60 @@ static int test_mempool_creation_with_exceeded_cache_size(void)
 	return 0;
 }
 
+/*
+ * Move objects through the default cache of an adaptive mempool in a
+ * single direction and check that the cache grows within its bounds.
+ * A new pool is used for each direction so that both start from the
+ * cache size given at creation.
+ */
+static int
+test_mempool_cache_adaptive(void)
+{
+	struct rte_mempool *mp;
+	struct rte_mempool_cache *cache;
+	void *objtable[MAX_KEEP];
+	unsigned int i, dir;
+	int ret = -1;
+
+	/* dir 0 only allocates from the cache, dir 1 only frees to it */
+	for (dir = 0; dir < 2; dir++) {
+		mp = rte_mempool_create("test_cache_adaptive", MEMPOOL_SIZE,
+			MEMPOOL_ELT_SIZE, MAX_KEEP * 2, 0,
+			NULL, NULL,
+			my_obj_init, NULL,
+			SOCKET_ID_ANY, MEMPOOL_F_CACHE_ADAPTIVE);
+		if (mp == NULL)
+			RET_ERR();
+
+		cache = rte_mempool_default_cache(mp, rte_lcore_id());
+		if (cache == NULL || cache->size != mp->cache_size)
+			GOTO_ERR(ret, err);
+
+		for (i = 0; i < RTE_MEMPOOL_CACHE_ADAPT_PERIOD * 64; i++) {
+			if (rte_mempool_generic_get(mp, objtable, MAX_KEEP,
+					dir == 0 ? cache : NULL) < 0)
+				GOTO_ERR(ret, err);
+			rte_mempool_generic_put(mp, objtable, MAX_KEEP,
+					dir == 0 ? NULL : cache);
+		}
+		if (cache->size <= mp->cache_size ||
+				cache->size > mp->cache_size *
+				RTE_MEMPOOL_CACHE_ADAPT_GROWTH ||
+				cache->flushthresh !=
+				RTE_MEMPOOL_CACHE_FLUSHTHRESH(cache->size))
+			GOTO_ERR(ret, err);
+
+		rte_mempool_dump(stdout, mp);
+		rte_mempool_free(mp);
+	}
+
+	return 0;
+
+err:
+	rte_mempool_free(mp);
+	return ret;
+}
+
 static struct rte_mempool *mp_spsc;
 static rte_spinlock_t scsp_spinlock;
 static void *scsp_obj_table[MAX_KEEP];
@@ -640,6 +694,9 @@ test_mempool(void)
 	if (test_mempool_creation_with_exceeded_cache_size() < 0)
 		GOTO_ERR(ret, err);
 
+	if (test_mempool_cache_adaptive() < 0)
+		GOTO_ERR(ret, err);
+
 	if (test_mempool_same_name_twice_creation() < 0)
 		GOTO_ERR(ret, err);
 
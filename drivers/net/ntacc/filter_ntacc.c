@@ -38,6 +38,7 @@
 #include <rte_log.h>
 #include <rte_pci.h>
 #include <rte_malloc.h>
+#include <rte_jhash.h>
 #include <nt.h>
 
 #include "rte_eth_ntacc.h"
@@ -563,6 +564,11 @@ void CreateStreamid(char *ntpl_buf, struct pmd_internals *internals, uint32_t nb
   }
 }
 
+// Sort order and identity of a filter value in a key
+#define FILTER_VALUE_ID(a) ((uint32_t)(a)->layer +                          \
+                            (((uint32_t)(a)->offset << 16) & 0x00FF0000) +  \
+                            (((uint32_t)(a)->size << 8) & 0x0000FF00))
+
 static void InsertFilterValues(struct filter_values_s *pInsertFilterValues, struct pmd_internals *internals)
 {
   struct filter_values_s *pFilter_values;
@@ -575,13 +581,9 @@ static void InsertFilterValues(struct filter_values_s *pInsertFilterValues, stru
     return;
   }
 
-  insertVal = pInsertFilterValues->layer +
-              (((uint32_t)pInsertFilterValues->offset << 16) & 0x00FF0000) +
-              (((uint32_t)pInsertFilterValues->size << 8) & 0x0000FF00);
+  insertVal = FILTER_VALUE_ID(pInsertFilterValues);
   LIST_FOREACH(pFilter_values, &internals->filter_values, next) {
-    sortVal = pFilter_values->layer +
-              (((uint32_t)pFilter_values->offset << 16) & 0x00FF0000) +
-              (((uint32_t)pFilter_values->size << 8) & 0x0000FF00);
+    sortVal = FILTER_VALUE_ID(pFilter_values);
     if (sortVal > insertVal) {
       LIST_INSERT_BEFORE(pFilter_values, pInsertFilterValues, next);
       return;
@@ -605,11 +607,13 @@ static int SetFilter(int size,
                      struct pmd_internals *internals,
                      struct rte_flow_error *error)
 {
-  struct filter_values_s *pFilter_values = rte_zmalloc(internals->name, sizeof(struct filter_values_s), 0);
-  if (!pFilter_values) {
-    rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_UNSPECIFIED, NULL, "Failed to allocate memory while setting up filter");
+  struct filter_values_s *pFilter_values;
+
+  if (internals->nbFilterValues >= NTACC_MAX_FILTER_VALUES) {
+    rte_flow_error_set(error, ENOSPC, RTE_FLOW_ERROR_TYPE_ITEM, NULL, "Too many values in the flow pattern");
     return -1;
   }
+  pFilter_values = &internals->filterValuePool[internals->nbFilterValues++];
   memset(pFilter_values, 0, sizeof(struct filter_values_s));
 
   // Store the filter values;
@@ -686,96 +690,70 @@ static int SetFilter(int size,
   return 0;
 }
 
-void DeleteKeyset(int key, struct pmd_internals *internals, struct rte_flow_error *error) {
-  char ntpl_buf[21];
-  struct filter_keyset_s *key_set;
-
-  LIST_FOREACH(key_set, &internals->filter_keyset, next) {
-    if (key_set->key == key) {
-      LIST_REMOVE(key_set, next);
-      snprintf(ntpl_buf, 20, "delete=%d", key_set->ntpl_id2);
-      NTACC_LOCK(&internals->configlock);
-      DoNtpl(ntpl_buf, NULL, internals, error);
-      NTACC_UNLOCK(&internals->configlock);
-      snprintf(ntpl_buf, 20, "delete=%d", key_set->ntpl_id1);
-      NTACC_LOCK(&internals->configlock);
-      DoNtpl(ntpl_buf, NULL, internals, error);
-      NTACC_UNLOCK(&internals->configlock);
-      rte_free(key_set);
-      return;
-    }
-  }
+/**
+ * Drop the filter values collected from a flow pattern.
+ */
+void FlushFilterValues(struct pmd_internals *internals)
+{
+  NTACC_LOCK(&internals->lock);
+  LIST_INIT(&internals->filter_values);
+  internals->nbFilterValues = 0;
+  NTACC_UNLOCK(&internals->lock);
 }
 
 /******************************************************
-  Find the keyset for multiple shared filter commands.
+  Delete a keyset and its KeyType and KeyDef commands.
+  Must be called with configlock and lock held.
+ *******************************************************/
+void DeleteKeyset(struct filter_keyset_s *key_set, struct pmd_internals *internals, struct rte_flow_error *error) {
+  char ntpl_buf[21];
 
-  A filter command is shared when:
-    typeMask = commands and fields in the different commands
-    plist_queues = Queues used by the commands
-    port = Adapter port
-  are the same. This means that the filter can be
-  optimized to take less space in the FPGA.
+  LIST_REMOVE(key_set, next);
+  snprintf(ntpl_buf, 20, "delete=%d", key_set->ntpl_id2);
+  DoNtpl(ntpl_buf, NULL, internals, error);
+  snprintf(ntpl_buf, 20, "delete=%d", key_set->ntpl_id1);
+  DoNtpl(ntpl_buf, NULL, internals, error);
+  rte_free(key_set);
+}
 
-  If no match is found then it is the first
-  command or optimization cannot be done.
- *******************************************************/
-static int FindKeyset(uint64_t typeMask, uint8_t *plist_queues, uint8_t nb_queues, struct pmd_internals *internals)
+static inline uint32_t KeysetHash(uint64_t typeMask, uint8_t port, uint8_t *plist_queues, uint8_t nb_queues, const struct capture_s *pCapture, bool colorInfo)
 {
-  struct filter_keyset_s *key_set;
-  int match = 0;
-  int i;
-
-  LIST_FOREACH(key_set, &internals->filter_keyset, next) {
-    if (key_set->typeMask == typeMask && nb_queues == key_set->nb_queues && key_set->port == internals->port) {
-      match = 0;
-      for (i = 0; i < nb_queues; i++) {
-        if (plist_queues[i] == key_set->list_queues[i]) {
-          match++;
-        }
-      }
-      if (match == nb_queues) {
-        return key_set->key;
-      }
-    }
-  }
-  return 0;
+  return rte_jhash(plist_queues, nb_queues,
+                   (uint32_t)typeMask ^ (uint32_t)(typeMask >> 32) ^ ((uint32_t)port << 8) ^ nb_queues ^
+                   pCapture->sample ^ ((uint32_t)pCapture->slice << 16) ^ ((uint32_t)colorInfo << 31));
 }
 
 /******************************************************
-  Find the NTPL ID for the assign command as it is
-  the same assign command used when multiple shared
-  filter commands are used.
+  Find the keyset for multiple shared filter commands.
 
   A filter command is shared when:
     typeMask = commands and fields in the different commands
     plist_queues = Queues used by the commands
     port = Adapter port
+    capture = Sample rate and snap length of the assign
+    colorInfo = The KeyList color is delivered
   are the same. This means that the filter can be
   optimized to take less space in the FPGA.
 
-  If no assign NTPL ID is found then it is the first
+  The keysets are kept in a hash table, so the
+  lookup does not depend on the number of flows.
+
+  If no match is found then it is the first
   command or optimization cannot be done.
  *******************************************************/
-static inline uint32_t FindAssignNtplID(uint64_t typeMask, uint8_t *plist_queues, uint8_t nb_queues, struct pmd_internals *internals)
+static struct filter_keyset_s *FindKeyset(uint64_t typeMask, uint8_t *plist_queues, uint8_t nb_queues, const struct capture_s *pCapture, bool colorInfo, struct pmd_internals *internals)
 {
-  struct rte_flow *pFlow;
-  int match = 0;
-  int i;
-  LIST_FOREACH(pFlow, &internals->flows, next) {
-    if (pFlow->typeMask == typeMask && nb_queues == pFlow->nb_queues && pFlow->port == internals->port) {
-      match = 0;
-      for (i = 0; i < nb_queues; i++) {
-        if (plist_queues[i] == pFlow->list_queues[i]) {
-          match++;
-        }
-      }
-      if (match == nb_queues) {
-        return pFlow->assign_ntpl_id;
-      }
+  struct filter_keyset_s *key_set;
+  const uint32_t hash = KeysetHash(typeMask, internals->port, plist_queues, nb_queues, pCapture, colorInfo);
+
+  LIST_FOREACH(key_set, &internals->filter_keyset[hash & (NTACC_KEYSET_BUCKETS - 1)], next) {
+    if (key_set->hash == hash && key_set->typeMask == typeMask && key_set->nb_queues == nb_queues &&
+        key_set->port == internals->port && key_set->capture.sample == pCapture->sample &&
+        key_set->capture.slice == pCapture->slice && key_set->colorInfo == colorInfo && memcmp(key_set->list_queues, plist_queues, nb_queues) == 0) {
+      return key_set;
     }
   }
-  return 0;
+  return NULL;
 }
 
 //#define DUMP_FLOWS
@@ -807,173 +785,160 @@ bool IsFilterReuse(struct pmd_internals *internals,
                    uint64_t typeMask,
                    uint8_t *plist_queues,
                    uint8_t nb_queues,
+                   const struct capture_s *pCapture,
+                   const struct color_s *pColor,
                    int *key)
 {
-  if (LIST_EMPTY(&internals->filter_keyset)) {
+  struct filter_keyset_s *key_set = FindKeyset(typeMask, plist_queues, nb_queues, pCapture, pColor->type == ONE_COLOR, internals);
+
+  if (key_set == NULL) {
     *key = 0;
     return false;
   }
-
-  *key = FindKeyset(typeMask, plist_queues, nb_queues, internals);
-  if (*key == 0)
-    return false;
-  else
-    return true;
+  *key = key_set->key;
+  return true;
 }
 
-int CreateOptimizedFilter(char *ntpl_buf,
-                          struct pmd_internals *internals,
-                          struct rte_flow *flow,
-                          bool *fc,
-                          uint64_t typeMask,
-                          uint8_t *plist_queues,
-                          uint8_t nb_queues,
-                          int key,
-                          struct color_s *pColor,
-                          struct rte_flow_error *error)
+/**
+ * Make the KeyType and KeyDef commands of the filter values and
+ * add the keyset to the keyset table.
+ * Must be called with internals->lock taken.
+ */
+static int CreateKeyset(struct pmd_internals *internals,
+                        uint64_t typeMask,
+                        uint8_t *plist_queues,
+                        uint8_t nb_queues,
+                        const struct capture_s *pCapture,
+                        struct color_s *pColor,
+                        struct filter_keyset_s **ppKeyset,
+                        struct rte_flow_error *error)
 {
   struct filter_values_s *pFilter_values;
-  int iRet = 0;
-  bool first = true;
-  char *filter_buffer1 = NULL;
+  struct filter_keyset_s *key_set;
   char *filter_buffer2 = NULL;
   char *filter_buffer3 = NULL;
-  int i;
+  bool first = true;
   uint32_t ntplID;
-  bool reuse = true;
-
-#ifdef DUMP_FLOWS
-  DumpFlows(internals);
-#endif
+  int iRet = -1;
+  int key;
+  int i;
 
-  NTACC_LOCK(&internals->lock);
-  if (LIST_EMPTY(&internals->filter_values)) {
-    NTACC_UNLOCK(&internals->lock);
-    return 0;
+  key_set = rte_zmalloc(internals->name, sizeof(struct filter_keyset_s), 0);
+  if (!key_set) {
+    rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Allocating memory failed");
+    return -1;
   }
 
-  first = true;
-  /*************************************************************/
-  /*          Make the keytype and keydef commands             */
-  /*************************************************************/
-  if (key == 0) {
-    struct filter_keyset_s *key_set = rte_zmalloc(internals->name, sizeof(struct filter_keyset_s), 0);
-    if (!key_set) {
-      iRet = -1;
-      rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Allocating memory failed");
-      goto Errors;
-    }
-
-    key = GetKeysetValue(internals);
-    if (key < 0) {
-      rte_free(key_set);
-      iRet = -1;
-      rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Internal error: Illegal key set value returned");
-      goto Errors;
-    }
-
-    key_set->key = key;
-    key_set->typeMask = typeMask;
+  key = GetKeysetValue(internals);
+  if (key < 0) {
+    rte_free(key_set);
+    rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Internal error: Illegal key set value returned");
+    return -1;
+  }
 
-    filter_buffer2 = rte_malloc(internals->name, NTPL_BSIZE + 1, 0);
-    if (!filter_buffer2) {
-      iRet = -1;
-      rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Allocating memory failed");
-      goto Errors;
-    }
+  key_set->key = key;
+  key_set->typeMask = typeMask;
 
-    filter_buffer3 = rte_malloc(internals->name, NTPL_BSIZE + 1, 0);
-    if (!filter_buffer3) {
-      iRet = -1;
-      rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Allocating memory failed");
-      goto Errors;
-    }
+  filter_buffer2 = rte_malloc(internals->name, NTPL_BSIZE + 1, 0);
+  filter_buffer3 = rte_malloc(internals->name, NTPL_BSIZE + 1, 0);
+  if (!filter_buffer2 || !filter_buffer3) {
+    rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Allocating memory failed");
+    goto Errors;
+  }
 
-    LIST_FOREACH(pFilter_values, &internals->filter_values, next) {
-      if (first) {
-        if (pColor->type == ONE_COLOR) {
-          snprintf(filter_buffer3, NTPL_BSIZE,
-                   "KeyType[name=KT%u;Access=partial;Bank=0;colorinfo=true;tag=%s]={", key, internals->tagName);
-        }
-        else {
-          snprintf(filter_buffer3, NTPL_BSIZE,
-                   "KeyType[name=KT%u;Access=partial;Bank=0;tag=%s]={", key, internals->tagName);
-        }
-        snprintf(filter_buffer2, NTPL_BSIZE,
-                 "KeyDef[name=KDEF%u;KeyType=KT%u;tag=%s]=(", key, key, internals->tagName);
-        first=false;
+  LIST_FOREACH(pFilter_values, &internals->filter_values, next) {
+    if (first) {
+      if (pColor->type == ONE_COLOR) {
+        snprintf(filter_buffer3, NTPL_BSIZE,
+                 "KeyType[name=KT%u;Access=partial;Bank=0;colorinfo=true;tag=%s]={", key, internals->tagName);
       }
       else {
-        snprintf(&filter_buffer3[strlen(filter_buffer3)], NTPL_BSIZE - strlen(filter_buffer3) - 1, ",");
-        snprintf(&filter_buffer2[strlen(filter_buffer2)], NTPL_BSIZE - strlen(filter_buffer2) - 1, ",");
+        snprintf(filter_buffer3, NTPL_BSIZE,
+                 "KeyType[name=KT%u;Access=partial;Bank=0;tag=%s]={", key, internals->tagName);
       }
+      snprintf(filter_buffer2, NTPL_BSIZE,
+               "KeyDef[name=KDEF%u;KeyType=KT%u;tag=%s]=(", key, key, internals->tagName);
+      first=false;
+    }
+    else {
+      snprintf(&filter_buffer3[strlen(filter_buffer3)], NTPL_BSIZE - strlen(filter_buffer3) - 1, ",");
+      snprintf(&filter_buffer2[strlen(filter_buffer2)], NTPL_BSIZE - strlen(filter_buffer2) - 1, ",");
+    }
 
-      snprintf(&filter_buffer3[strlen(filter_buffer3)], NTPL_BSIZE - strlen(filter_buffer3) - 1, "%u", pFilter_values->size);
+    snprintf(&filter_buffer3[strlen(filter_buffer3)], NTPL_BSIZE - strlen(filter_buffer3) - 1, "%u", pFilter_values->size);
 
-      if (pFilter_values->size == 128 && pFilter_values->layer == LAYER2) {
-        // This is an ethernet address
-        snprintf(&filter_buffer2[strlen(filter_buffer2)], NTPL_BSIZE - strlen(filter_buffer2) - 1,
-                "{0xFFFFFFFFFFFFFFFFFFFFFFFF00000000:%s[%u]/%u}", pFilter_values->layerString, pFilter_values->offset, pFilter_values->size);
+    if (pFilter_values->size == 128 && pFilter_values->layer == LAYER2) {
+      // This is an ethernet address
+      snprintf(&filter_buffer2[strlen(filter_buffer2)], NTPL_BSIZE - strlen(filter_buffer2) - 1,
+              "{0xFFFFFFFFFFFFFFFFFFFFFFFF00000000:%s[%u]/%u}", pFilter_values->layerString, pFilter_values->offset, pFilter_values->size);
+    }
+    else {
+      if (pFilter_values->mask != 0) {
+        snprintf(&filter_buffer2[strlen(filter_buffer2)],  NTPL_BSIZE - strlen(filter_buffer2) - 1,
+                 "{0x%llX:%s[%u]/%u}", (const long long unsigned int)pFilter_values->mask, pFilter_values->layerString, pFilter_values->offset, pFilter_values->size);
       }
       else {
-        if (pFilter_values->mask != 0) {
-          snprintf(&filter_buffer2[strlen(filter_buffer2)],  NTPL_BSIZE - strlen(filter_buffer2) - 1,
-                   "{0x%llX:%s[%u]/%u}", (const long long unsigned int)pFilter_values->mask, pFilter_values->layerString, pFilter_values->offset, pFilter_values->size);
-        }
-        else {
-          snprintf(&filter_buffer2[strlen(filter_buffer2)],  NTPL_BSIZE - strlen(filter_buffer2) - 1,
-                  "%s[%u]/%u", pFilter_values->layerString, pFilter_values->offset, pFilter_values->size);
-        }
+        snprintf(&filter_buffer2[strlen(filter_buffer2)],  NTPL_BSIZE - strlen(filter_buffer2) - 1,
+                "%s[%u]/%u", pFilter_values->layerString, pFilter_values->offset, pFilter_values->size);
       }
     }
-    snprintf(&filter_buffer3[strlen(filter_buffer3)],  NTPL_BSIZE - strlen(filter_buffer3) - 1, "}");
-    snprintf(&filter_buffer2[strlen(filter_buffer2)],  NTPL_BSIZE - strlen(filter_buffer2) - 1, ")");
-
-    if (DoNtpl(filter_buffer3, &ntplID, internals, error)) {
-      rte_free(key_set);
-      iRet = -1;
-      goto Errors;
-    }
-    key_set->ntpl_id1 = ntplID;
-
-    if (DoNtpl(filter_buffer2, &ntplID, internals, error)) {
-      rte_free(key_set);
-      iRet = -1;
-      goto Errors;
-    }
-    key_set->ntpl_id2 = ntplID;
+  }
+  snprintf(&filter_buffer3[strlen(filter_buffer3)],  NTPL_BSIZE - strlen(filter_buffer3) - 1, "}");
+  snprintf(&filter_buffer2[strlen(filter_buffer2)],  NTPL_BSIZE - strlen(filter_buffer2) - 1, ")");
 
-    for (i = 0; i < nb_queues; i++) {
-      key_set->list_queues[i] = plist_queues[i];
-    }
-    key_set->nb_queues = nb_queues;
-    key_set->port = internals->port;
-    LIST_INSERT_HEAD(&internals->filter_keyset, key_set, next);
-    flow->assign_ntpl_id = 0;
-    reuse = false;
+  if (DoNtpl(filter_buffer3, &ntplID, internals, error)) {
+    goto Errors;
   }
-  else {
-    flow->assign_ntpl_id = FindAssignNtplID(typeMask, plist_queues, nb_queues, internals);
+  key_set->ntpl_id1 = ntplID;
+
+  if (DoNtpl(filter_buffer2, &ntplID, internals, error)) {
+    goto Errors;
   }
+  key_set->ntpl_id2 = ntplID;
 
   for (i = 0; i < nb_queues; i++) {
-    flow->list_queues[i] = plist_queues[i];
-  }
-  flow->nb_queues = nb_queues;
-  flow->port = internals->port;
-  flow->key = key;
-  flow->typeMask = typeMask;
-  first = true;
+    key_set->list_queues[i] = plist_queues[i];
+  }
+  key_set->nb_queues = nb_queues;
+  key_set->port = internals->port;
+  key_set->capture = *pCapture;
+  key_set->colorInfo = pColor->type == ONE_COLOR;
+  key_set->refcnt = 1;
+  key_set->hash = KeysetHash(typeMask, internals->port, plist_queues, nb_queues, pCapture, key_set->colorInfo);
+  LIST_INSERT_HEAD(&internals->filter_keyset[key_set->hash & (NTACC_KEYSET_BUCKETS - 1)], key_set, next);
+  *ppKeyset = key_set;
+  key_set = NULL;
+  iRet = 0;
 
-  /*************************************************************/
-  /*                Make the keylist command                   */
-  /*************************************************************/
-  filter_buffer1 = rte_malloc(internals->name, NTPL_BSIZE + 1, 0);
-  if (!filter_buffer1) {
-    iRet = -1;
-    rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Allocating memory failed");
-    goto Errors;
+Errors:
+  if (key_set) {
+    rte_free(key_set);
+  }
+  if (filter_buffer2) {
+    rte_free(filter_buffer2);
   }
+  if (filter_buffer3) {
+    rte_free(filter_buffer3);
+  }
+  return iRet;
+}
+
+/**
+ * Make the KeyList command of the filter values and add it to the flow.
+ * The filter values are consumed. filter_buffer1 is a scratch buffer of
+ * NTPL_BSIZE + 1 bytes.
+ * Must be called with internals->lock taken.
+ */
+static int CreateKeyList(char *filter_buffer1,
+                         struct pmd_internals *internals,
+                         struct rte_flow *flow,
+                         int key,
+                         struct color_s *pColor,
+                         struct rte_flow_error *error)
+{
+  struct filter_values_s *pFilter_values;
+  bool first = true;
+  uint32_t ntplID;
 
   while (!LIST_EMPTY(&internals->filter_values)) {
     pFilter_values = LIST_FIRST(&internals->filter_values);
@@ -1082,16 +1047,93 @@ int CreateOptimizedFilter(char *ntpl_buf,
     }
   }
   snprintf(&filter_buffer1[strlen(filter_buffer1)], NTPL_BSIZE - strlen(filter_buffer1) - 1, ")");
+  internals->nbFilterValues = 0;
 
   // Set keylist filter
   if (DoNtpl(filter_buffer1, &ntplID, internals, error)) {
-    iRet = -1;
-    goto Errors;
+    return -1;
   }
   pushNtplID(flow, ntplID);
+  return 0;
+}
+
+int CreateOptimizedFilter(char *ntpl_buf,
+                          struct pmd_internals *internals,
+                          struct rte_flow *flow,
+                          bool *fc,
+                          uint64_t typeMask,
+                          uint8_t *plist_queues,
+                          uint8_t nb_queues,
+                          int key,
+                          const struct capture_s *pCapture,
+                          struct color_s *pColor,
+                          bool keyList,
+                          struct rte_flow_error *error)
+{
+  struct filter_keyset_s *key_set;
+  char *filter_buffer1 = NULL;
+  int iRet = 0;
+  int i;
+  bool reuse = true;
+
+#ifdef DUMP_FLOWS
+  DumpFlows(internals);
+#endif
 
-  if (pFilter_values) {
-    rte_free(pFilter_values);
+  NTACC_LOCK(&internals->lock);
+  if (LIST_EMPTY(&internals->filter_values)) {
+    NTACC_UNLOCK(&internals->lock);
+    return 0;
+  }
+
+  /*************************************************************/
+  /*          Make the keytype and keydef commands             */
+  /*************************************************************/
+  if (key == 0) {
+    if (CreateKeyset(internals, typeMask, plist_queues, nb_queues, pCapture, pColor, &key_set, error) != 0) {
+      iRet = -1;
+      goto Errors;
+    }
+    key = key_set->key;
+    flow->keyset = key_set;
+    flow->assign_ntpl_id = 0;
+    reuse = false;
+  }
+  else {
+    // Share the keyset and the assign command of the existing flows
+    key_set = FindKeyset(typeMask, plist_queues, nb_queues, pCapture, pColor->type == ONE_COLOR, internals);
+    if (!key_set) {
+      iRet = -1;
+      rte_flow_error_set(error, EAGAIN, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Keyset was deleted while creating the flow");
+      goto Errors;
+    }
+    key_set->refcnt++;
+    flow->keyset = key_set;
+    flow->assign_ntpl_id = key_set->assign_ntpl_id;
+  }
+
+  for (i = 0; i < nb_queues; i++) {
+    flow->list_queues[i] = plist_queues[i];
+  }
+  flow->nb_queues = nb_queues;
+  flow->port = internals->port;
+  flow->key = key;
+  flow->typeMask = typeMask;
+
+  /*************************************************************/
+  /*                Make the keylist command                   */
+  /*************************************************************/
+  if (keyList) {
+    filter_buffer1 = rte_malloc(internals->name, NTPL_BSIZE + 1, 0);
+    if (!filter_buffer1) {
+      iRet = -1;
+      rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Allocating memory failed");
+      goto Errors;
+    }
+    if (CreateKeyList(filter_buffer1, internals, flow, key, pColor, error) != 0) {
+      iRet = -1;
+      goto Errors;
+    }
   }
 
   if (!(reuse)) {
@@ -1108,16 +1150,78 @@ int CreateOptimizedFilter(char *ntpl_buf,
   if (filter_buffer1) {
     rte_free(filter_buffer1);
   }
-  if (filter_buffer2) {
-    rte_free(filter_buffer2);
+
+  return iRet;
+}
+
+/**
+ * Add the key values of a flow to the keyset of a flow template.
+ * The flow shares the keyset and the assign command of the template.
+ */
+int CreateTemplateKeyList(struct rte_pmd_ntacc_flow_template *tmpl,
+                          struct pmd_internals *internals,
+                          struct rte_flow *flow,
+                          struct color_s *pColor,
+                          struct rte_flow_error *error)
+{
+  struct filter_keyset_s *key_set = tmpl->keyset;
+  struct filter_values_s *pFilter_values;
+  int iRet = 0;
+  int i = 0;
+
+  NTACC_LOCK(&internals->lock);
+  LIST_FOREACH(pFilter_values, &internals->filter_values, next) {
+    if (i == tmpl->nb_values || tmpl->values[i] != FILTER_VALUE_ID(pFilter_values)) {
+      break;
+    }
+    i++;
   }
-  if (filter_buffer3) {
-    rte_free(filter_buffer3);
+  if (pFilter_values != NULL || i != tmpl->nb_values) {
+    rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_ITEM, NULL, "Pattern values do not match the flow template");
+    NTACC_UNLOCK(&internals->lock);
+    return -1;
+  }
+  if (key_set->colorInfo != (pColor->type == ONE_COLOR)) {
+    rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_ACTION, NULL, "Flow color does not match the flow template");
+    NTACC_UNLOCK(&internals->lock);
+    return -1;
   }
 
+  for (i = 0; i < key_set->nb_queues; i++) {
+    flow->list_queues[i] = key_set->list_queues[i];
+  }
+  flow->nb_queues = key_set->nb_queues;
+  flow->port = internals->port;
+  flow->key = key_set->key;
+  flow->typeMask = key_set->typeMask;
+
+  if (CreateKeyList(tmpl->ntpl_buf, internals, flow, key_set->key, pColor, error) != 0) {
+    iRet = -1;
+  }
+  else {
+    key_set->refcnt++;
+    flow->keyset = key_set;
+    flow->assign_ntpl_id = key_set->assign_ntpl_id;
+  }
+  NTACC_UNLOCK(&internals->lock);
   return iRet;
 }
 
+/**
+ * Record the shape of the filter values of a flow template.
+ */
+void SetTemplateValues(struct rte_pmd_ntacc_flow_template *tmpl, struct pmd_internals *internals)
+{
+  struct filter_values_s *pFilter_values;
+
+  NTACC_LOCK(&internals->lock);
+  tmpl->nb_values = 0;
+  LIST_FOREACH(pFilter_values, &internals->filter_values, next) {
+    tmpl->values[tmpl->nb_values++] = FILTER_VALUE_ID(pFilter_values);
+  }
+  NTACC_UNLOCK(&internals->lock);
+}
+
 /**
  * Setup an ethernet filter.
  */
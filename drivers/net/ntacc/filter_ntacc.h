@@ -59,6 +59,29 @@ struct color_s {
   } type;
 };
 
+#define NTACC_MAX_TEMPLATE_ITEMS 16
+
+/**
+ * Flow template. The shape of a pattern and the actions are compiled once
+ * into a keyset and an assign command. A flow inserted through the template
+ * only adds its key values to the keyset.
+ */
+struct rte_pmd_ntacc_flow_template {
+  LIST_ENTRY(rte_pmd_ntacc_flow_template) next;
+  struct filter_keyset_s *keyset;   // Keyset and assign command shared by the flows
+  uint64_t actionMask;              // typeMask bits set by the actions
+  uint64_t typeMask;                // typeMask of the template pattern and actions
+  struct color_s color;             // Color of the actions. COUNT sets it per flow
+  struct rte_flow_action_count countConf;
+  uint8_t count;                    // The actions have a COUNT action
+  uint8_t nb_items;
+  uint8_t nb_values;
+  enum rte_flow_item_type items[NTACC_MAX_TEMPLATE_ITEMS];  // Item types of the pattern. VOID is left out
+  uint32_t values[NTACC_MAX_FILTER_VALUES];                 // Fields of the key in key order
+  char ntpl_buf[NTPL_BSIZE + 1];    // Scratch buffers used when inserting a flow
+  char filter_buf[NTPL_BSIZE + 1];
+};
+
 enum {
   RX_FILTER            = (1ULL << 0),
   DROP_FILTER          = (1ULL << 1),
@@ -210,13 +233,22 @@ int CreateOptimizedFilter(char *ntpl_buf,
                           uint8_t *plist_queues,
                           uint8_t nb_queues,
                           int key,
+                          const struct capture_s *pCapture,
+                          struct color_s *pColor,
+                          bool keyList,
+                          struct rte_flow_error *error);
+int CreateTemplateKeyList(struct rte_pmd_ntacc_flow_template *tmpl,
+                          struct pmd_internals *internals,
+                          struct rte_flow *flow,
                           struct color_s *pColor,
                           struct rte_flow_error *error);
+void SetTemplateValues(struct rte_pmd_ntacc_flow_template *tmpl, struct pmd_internals *internals);
+void FlushFilterValues(struct pmd_internals *internals);
 
-void DeleteKeyset(int key, struct pmd_internals *internals, struct rte_flow_error *error);
+void DeleteKeyset(struct filter_keyset_s *key_set, struct pmd_internals *internals, struct rte_flow_error *error);
 //void DeleteHash(uint64_t rss_hf, uint8_t port, int priority, struct pmd_internals *internals);
 void FlushHash(struct pmd_internals *internals);
-bool IsFilterReuse(struct pmd_internals *internals, uint64_t typeMask, uint8_t *plist_queues, uint8_t nb_queues, int *key);
+bool IsFilterReuse(struct pmd_internals *internals, uint64_t typeMask, uint8_t *plist_queues, uint8_t nb_queues, const struct capture_s *pCapture, const struct color_s *pColor, int *key);
 int GetKeysetValue(struct pmd_internals *internals);
 
 #endif
@@ -32,6 +32,7 @@
  *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include <time.h>
+#include <stdlib.h>
 #include <linux/limits.h>
 #include <sys/param.h>
 #include <sys/stat.h>
@@ -48,15 +49,20 @@
 #include <rte_string_fns.h>
 #include <rte_cycles.h>
 #include <rte_kvargs.h>
+#include <rte_hash.h>
 #include <rte_ether.h>
 #include <rte_flow.h>
 #include <rte_flow_driver.h>
 #include <rte_version.h>
 #include <rte_pci.h>
 #include <rte_bus_pci.h>
+#include <rte_vect.h>
+#include <rte_cpuflags.h>
+#include <rte_power_intrinsics.h>
 #include <net/if.h>
 #include <nt.h>
 
+#include "rte_pmd_ntacc.h"
 #include "rte_eth_ntacc.h"
 #include "filter_ntacc.h"
 
@@ -72,15 +78,28 @@ int ntacc_logtype;
 
 #define ETH_NTACC_MASK_ARG "mask"
 #define ETH_NTACC_NTPL_ARG "ntpl"
+#define ETH_NTACC_COPYBREAK_ARG "copybreak"
+#define ETH_NTACC_TXMODE_ARG "txmode"
+#define ETH_NTACC_RXMODE_ARG "rxmode"
+#define ETH_NTACC_NUMAPOOL_ARG "numapool"
+#define ETH_NTACC_RXWB_ARG "rxwb"
+
+#define NTACC_NTAPI_LIB_ENV "NTACC_NTAPI_LIB"
 
 #define HW_MAX_PKT_LEN  10000
 #define HW_MTU    (HW_MAX_PKT_LEN - RTE_ETHER_HDR_LEN - RTE_ETHER_CRC_LEN) /**< MTU */
 
 #define MAX_NTACC_PORTS 32
+#define MAX_NTACC_ADAPTERS 8
+#define NTACC_NB_COLORS RTE_DIM(((NtStatistics_t *)0)->u.query_v2.data.adapter.aAdapters[0].color.aColor)
 #define STREAMIDS_PER_PORT  (256 / internals->nbPortsInSystem)
 
 #define MAX_NTPL_NAME 512
 
+// Assign options of the SAMPLE and SLICE flow actions
+#define NTPL_SAMPLE_OPTION ";SampleRate=%u"
+#define NTPL_SLICE_OPTION  ";Slice=StartOfFrame[%u]"
+
 struct supportedDriver_s supportedDriver = {3, 11, 0};
 
 #define PCI_VENDOR_ID_NAPATECH 0x18F4
@@ -129,6 +148,14 @@ static int _dev_flow_flush(struct rte_eth_dev *dev, struct rte_flow_error *error
 static int eth_rx_queue_start(struct rte_eth_dev *dev, uint16_t rx_queue_id);
 static int eth_rx_queue_stop(struct rte_eth_dev *dev, uint16_t rx_queue_id);
 static int _dev_flow_isolate(struct rte_eth_dev *dev, int set, struct rte_flow_error *error);
+#ifndef USE_SW_STAT
+static int _stat_snapshot_start(struct pmd_internals *internals);
+static void _stat_snapshot_stop(struct pmd_internals *internals);
+#endif
+static void _flow_queue_free(struct pmd_internals *internals);
+static void _flow_template_free(struct pmd_internals *internals);
+static void _shunt_free(struct pmd_internals *internals);
+static int eth_stats_reset(struct rte_eth_dev *dev);
 
 static char errorBuffer[1024];
 
@@ -136,10 +163,16 @@ static int first = 0;
 static int deviceCount = 0;
 
 static volatile uint16_t port_locks[MAX_NTACC_PORTS];
+static uint8_t port_set_clock[MAX_NTACC_PORTS];
 
 static const char *valid_arguments[] = {
   ETH_NTACC_MASK_ARG,
   ETH_NTACC_NTPL_ARG,
+  ETH_NTACC_COPYBREAK_ARG,
+  ETH_NTACC_TXMODE_ARG,
+  ETH_NTACC_RXMODE_ARG,
+  ETH_NTACC_NUMAPOOL_ARG,
+  ETH_NTACC_RXWB_ARG,
   NULL
 };
 
@@ -286,65 +319,138 @@ int DoNtpl(const char *ntplStr, uint32_t *pNtplID, struct pmd_internals *interna
 }
 
 #ifdef USE_EXTERNAL_BUFFER
+/**
+ * Mark packets as released and move the HW read pointer past the oldest
+ * packets as long as they are released.
+ *
+ * @param[in] rx_q
+ *   RX queue.
+ * @param[in] cnt
+ *   Sequence number of the first packet released.
+ * @param[in] bits
+ *   Packets released, bit 0 is cnt. All bits must be within the bitmap word of cnt.
+ */
+static void eth_ntacc_rx_release(struct ntacc_rx_queue *rx_q, uint64_t cnt, uint64_t bits)
+{
+  struct ntacc_rx_release_s *release = &rx_q->release;
+  uint64_t offR = 0;
+  bool advance = false;
+  uint64_t idx = cnt & release->mask;
+
+  NTACC_LOCK(&release->lock);
+  release->done[idx >> 6] |= bits << (idx & 63);
+
+  for (;;) {
+    idx = rx_q->oCnt & release->mask;
+    const uint64_t bits = release->done[idx >> 6] >> (idx & 63);
+    if ((bits & 1) == 0) {
+      break;
+    }
+    // Number of released packets in a row. Never crosses a bitmap word.
+    const uint32_t num = ~bits == 0 ? 64 : rte_bsf64(~bits);
+    release->done[idx >> 6] &= ~(RTE_LEN2MASK(num, uint64_t) << (idx & 63));
+    rx_q->oCnt += num;
+    offR = release->offR[(rx_q->oCnt - 1) & release->mask];
+    advance = true;
+  }
+  if (advance) {
+    *(rx_q->ringControl.pRead) = offR;
+  }
+  NTACC_UNLOCK(&release->lock);
+}
+
 static void eth_ntacc_rx_ext_buffer_release(void *addr __rte_unused, void *opaque)
 {
   struct externalBufferInfo_s *pInfo = (struct externalBufferInfo_s *)opaque;
 
-  if (pInfo->rx_q->oCnt++ != pInfo->cnt) {
-    PMD_NTACC_LOG(ERR, "Out of order release detected while running ext buffer mode.\n");
-    abort();
+  eth_ntacc_rx_release(pInfo->rx_q, pInfo->cnt, 1);
+}
+
+static int eth_ntacc_rx_release_setup(struct ntacc_rx_queue *rx_q, unsigned int socket_id)
+{
+  struct ntacc_rx_release_s *release = &rx_q->release;
+  // Sized from the pool. RX stops when all entries are outstanding
+  const uint64_t entries = rte_align64pow2(RTE_MAX(rx_q->mb_pool->size, 64U));
+
+  rte_free(release->done);
+  release->done = rte_zmalloc_socket("ntacc_rx_release",
+                                     (entries / 64 + entries) * sizeof(uint64_t),
+                                     RTE_CACHE_LINE_SIZE, socket_id);
+  if (release->done == NULL) {
+    _log_out_of_memory_errors(__func__);
+    return -ENOMEM;
   }
-  *(pInfo->rx_q->ringControl.pRead) = pInfo->offR;
+  release->offR = release->done + entries / 64;
+  release->mask = entries - 1;
+  rte_spinlock_init(&release->lock);
+  rx_q->iCnt = 0;
+  rx_q->oCnt = 0;
+  return 0;
 }
-#else
-static int eth_ntacc_rx_jumbo(struct rte_mempool *mb_pool,
-                              struct rte_mbuf *mbuf,
-                              const u_char *data,
-                              uint16_t data_len)
+#endif
+
+/**
+ * Copy a packet larger than the first mbuf into a chain of mbufs. The extra
+ * segments are taken from a per-queue stash that is refilled in bulk. If no
+ * mbufs are available, the packet is truncated to the first segment.
+ */
+uint16_t eth_ntacc_rx_jumbo(struct ntacc_rx_queue *rx_q,
+                            struct rte_mbuf *mbuf,
+                            const u_char *data,
+                            uint16_t data_len)
 {
   struct rte_mbuf *m = mbuf;
-  uint16_t filled_so_far;
+  const uint16_t total_len = data_len;
+  uint16_t nb_segs;
 
   /* Copy the first segment. */
-  uint16_t len = RTE_MIN(rte_pktmbuf_tailroom(mbuf), data_len);
-  uint16_t total_len = data_len;
-
+  uint16_t len = RTE_MIN(rx_q->buf_size, data_len);
   rte_memcpy((u_char *)mbuf->buf_addr + mbuf->data_off, data, len);
+  mbuf->data_len = len;
   data_len -= len;
   data += len;
-  mbuf->pkt_len = total_len;
-  mbuf->data_len = len;
-  filled_so_far = len;
 
-  while (data_len > 0) {
-    /* Allocate next mbuf and point to that. */
-    m->next = rte_pktmbuf_alloc(mb_pool);
-    if (unlikely(!m->next)) {
-      struct rte_mbuf *b = mbuf;
-      while (b != NULL) {
-        b->pkt_len = filled_so_far;
-        b = b->next;
+  nb_segs = (data_len + rx_q->seg_size - 1) / rx_q->seg_size;
+  if (unlikely(rx_q->segStashCnt < nb_segs)) {
+    /* Fill up the stash. If that fails, get what this packet needs */
+    uint16_t n = NTACC_RX_SEG_STASH - rx_q->segStashCnt;
+    if (rte_mempool_get_bulk(rx_q->seg_pool, (void **)&rx_q->segStash[rx_q->segStashCnt], n) != 0) {
+      n = nb_segs - rx_q->segStashCnt;
+      if (rte_mempool_get_bulk(rx_q->seg_pool, (void **)&rx_q->segStash[rx_q->segStashCnt], n) != 0) {
+        mbuf->pkt_len = len;
+        return len;
       }
-      m->data_len = len;
-      return filled_so_far;
     }
+    rx_q->segStashCnt += n;
+  }
+
+  mbuf->pkt_len = total_len;
+  mbuf->nb_segs += nb_segs;
+  while (data_len > 0) {
+    m->next = rx_q->segStash[--rx_q->segStashCnt];
     m = m->next;
+    rte_pktmbuf_reset(m);
 
     /* Copy next segment. */
-    len = RTE_MIN(rte_pktmbuf_tailroom(m), data_len);
+    len = RTE_MIN(rx_q->seg_size, data_len);
     rte_memcpy((u_char *)m->buf_addr + m->data_off, data, len);
-
-    m->pkt_len = total_len;
     m->data_len = len;
-    filled_so_far += len;
-
-    mbuf->nb_segs++;
     data_len -= len;
     data += len;
   }
   return total_len;
 }
-#endif
+
+/**
+ * Return the mbufs in the segment stash of an RX queue to the pool.
+ */
+static void eth_ntacc_rx_stash_free(struct ntacc_rx_queue *rx_q)
+{
+  if (rx_q->segStashCnt) {
+    rte_mempool_put_bulk(rx_q->seg_pool, (void * const *)rx_q->segStash, rx_q->segStashCnt);
+    rx_q->segStashCnt = 0;
+  }
+}
 
 static __rte_always_inline uint16_t eth_ntacc_convert_pkt_to_mbuf(NtDyn3Descr_t *dyn3,
                                                                   struct rte_mbuf *mbuf,
@@ -386,11 +492,21 @@ static __rte_always_inline uint16_t eth_ntacc_convert_pkt_to_mbuf(NtDyn3Descr_t
 
 #ifdef USE_EXTERNAL_BUFFER
   uint8_t *pData = (uint8_t *)dyn3 + dyn3->descrLength;
+  if (data_len < rx_q->copyBreak) {
+    /* Small packet. Copying is cheaper than holding the Napatech buffer */
+    mbuf->pkt_len = mbuf->data_len = data_len;
+    rte_memcpy((u_char *)mbuf->buf_addr + mbuf->data_off, pData, data_len);
+#ifdef COPY_OFFSET0
+    mbuf->data_off += dyn3->offset0;
+#endif
+    return data_len;
+  }
+
   struct externalBufferInfo_s *pInfo = mbuf->buf_addr;
   pInfo->shinfo.free_cb = eth_ntacc_rx_ext_buffer_release;
   pInfo->shinfo.fcb_opaque = pInfo;
   pInfo->rx_q = rx_q;
-  pInfo->cnt = rx_q->iCnt++;
+  pInfo->cnt = rx_q->iCnt;
 
   rte_mbuf_ext_refcnt_set(&pInfo->shinfo, 1);
   rte_pktmbuf_attach_extbuf(mbuf, pData, 0, data_len, &pInfo->shinfo);
@@ -409,14 +525,14 @@ static __rte_always_inline uint16_t eth_ntacc_convert_pkt_to_mbuf(NtDyn3Descr_t
 #endif
   } else {
     /* Try read jumbo frame into multi mbufs. */
-    return eth_ntacc_rx_jumbo(rx_q->mb_pool, mbuf, (uint8_t*)dyn3 + dyn3->descrLength, data_len);
+    return eth_ntacc_rx_jumbo(rx_q, mbuf, (uint8_t*)dyn3 + dyn3->descrLength, data_len);
   }
 #endif
   return data_len;
 }
 
 
-static __rte_always_inline void eth_ntacc_rx_get_ring(struct ntacc_rx_queue *rx_q)
+void eth_ntacc_rx_get_ring(struct ntacc_rx_queue *rx_q)
 {
   int status;
   NtNetRx_t cmd;
@@ -427,9 +543,14 @@ static __rte_always_inline void eth_ntacc_rx_get_ring(struct ntacc_rx_queue *rx_
     }
     return;
   }
-  rte_memcpy(&rx_q->ringControl, &cmd.u.ringControl, sizeof(rx_q->ringControl));
+  rx_q->ringControl = cmd.u.ringControl;
   rx_q->offR = *rx_q->ringControl.pRead;
   rx_q->offW = *rx_q->ringControl.pWrite & rx_q->ringControl.mask;
+  rx_q->wbPending = 0;
+  // The adapter must always have room to write while the read offset is held back
+  if (rx_q->wbThreshold > rx_q->ringControl.size / 2) {
+    rx_q->wbThreshold = (uint32_t)(rx_q->ringControl.size / 2);
+  }
 }
 
 static uint16_t eth_ntacc_rx_mode1(void *queue,
@@ -470,34 +591,69 @@ static uint16_t eth_ntacc_rx_mode1(void *queue,
   else {
     ring = rx_q->ringControl.ring + offR;
   }
+#ifdef USE_EXTERNAL_BUFFER
+  struct ntacc_rx_release_s *release = &rx_q->release;
+  uint64_t copiedCnt = rx_q->iCnt;  // Copied packets are released in one go per bitmap word
+  uint64_t copied = 0;
+#endif
 
   while((offR != offW) && (num_rx < nb_pkts)) {
     struct rte_mbuf *mbuf = bufs[num_rx];
+#ifdef USE_EXTERNAL_BUFFER
+    if (unlikely(rx_q->iCnt - *(volatile uint64_t *)&rx_q->oCnt > release->mask)) {
+      // The release tracker is full. Wait for the oldest packet to be released
+      break;
+    }
+#endif
 
     NtDyn3Descr_t *dyn3 = (NtDyn3Descr_t*)(ring);
-    bytes += eth_ntacc_convert_pkt_to_mbuf(dyn3, mbuf, rx_q);
-    num_rx++;
-
     offR += dyn3->capLength;
     ring += dyn3->capLength;
     if (offR >= (2*rx_q->ringControl.size)) {
       offR -= (2*rx_q->ringControl.size);
     }
+    if (offR != offW) {
+      // Start fetching the next descriptor while this packet is converted
+      rte_prefetch0(ring);
+    }
+
+    bytes += eth_ntacc_convert_pkt_to_mbuf(dyn3, mbuf, rx_q);
+    num_rx++;
 #ifdef USE_EXTERNAL_BUFFER
-    struct externalBufferInfo_s *pInfo = mbuf->shinfo->fcb_opaque;
-    pInfo->offR = offR;
+    const uint64_t cnt = rx_q->iCnt++;
+    release->offR[cnt & release->mask] = offR;
+    if (!RTE_MBUF_HAS_EXTBUF(mbuf)) {
+      if ((cnt >> 6) != (copiedCnt >> 6)) {
+        // New bitmap word
+        if (copied) {
+          eth_ntacc_rx_release(rx_q, copiedCnt, copied);
+        }
+        copiedCnt = cnt;
+        copied = 0;
+      }
+      copied |= 1ULL << (cnt - copiedCnt);
+    }
 #endif
+    if (unlikely(offR == offW) && num_rx < nb_pkts && offW == rx_q->offW) {
+      // The window is used up. Read the write offset once more, so a busy
+      // ring is not left for the next burst
+      offW = *rx_q->ringControl.pWrite & rx_q->ringControl.mask;
+    }
   }
-#ifndef USE_EXTERNAL_BUFFER
+#ifdef USE_EXTERNAL_BUFFER
+  if (copied) {
+    eth_ntacc_rx_release(rx_q, copiedCnt, copied);
+  }
+#else
   /* Refresh the HW pointer */
-  *rx_q->ringControl.pRead = offR;
+  ntacc_rx_writeback(rx_q, offR, offW);
 #endif
 
   rx_q->offR = offR;
+  rx_q->offW = offW;
 
 #ifdef USE_SW_STAT
-  rx_q->rx_pkts+=num_rx;
-  rx_q->rx_bytes+=bytes;
+  ntacc_stats_add(rx_q->stats, num_rx, bytes, 0);
 #endif
 
   if (unlikely(num_rx < nb_pkts)) {
@@ -506,15 +662,141 @@ static uint16_t eth_ntacc_rx_mode1(void *queue,
   return num_rx;
 }
 
+/**
+ * Get the address to monitor when the RX queue is idle. The write offset of
+ * the ring is updated when new packets are written, so a core sleeping in
+ * rte_power_monitor() wakes up as soon as traffic resumes.
+ */
+static int eth_ntacc_get_monitor_addr(void *queue, struct rte_power_monitor_cond *pmc)
+{
+  struct ntacc_rx_queue *rx_q = queue;
+
+  if (rx_q->mode2Rx) {
+    // Segments are fetched with NT_NetRxGet. There is nothing to monitor
+    return -ENOTSUP;
+  }
+
+  pmc->size = sizeof(uint64_t);
+  if (likely(rx_q->ringControl.ring != NULL)) {
+    rx_q->offW = *rx_q->ringControl.pWrite & rx_q->ringControl.mask;
+    if (rx_q->offR == rx_q->offW) {
+      // Wake up on any write to the write offset. A write between the check
+      // above and UMONITOR is caught by the next packet or by the OS limit
+      // on the UMWAIT time.
+      pmc->addr = rx_q->ringControl.pWrite;
+      pmc->val = 0;
+      pmc->mask = 0;
+      return 0;
+    }
+  }
+
+  // Packets are waiting or the ring is not mapped yet. The condition below
+  // is already true, so the core does not sleep.
+  pmc->addr = &rx_q->offR;
+  pmc->val = rx_q->offR;
+  pmc->mask = UINT64_MAX;
+  return 0;
+}
+
+#ifndef USE_EXTERNAL_BUFFER
+/**
+ * Select the mode1 RX function. The widest vector version supported by
+ * both the build and the CPU is used, limited by the max SIMD bitwidth
+ * allowed by EAL (--force-max-simd-bitwidth).
+ */
+static eth_rx_burst_t eth_ntacc_rx_mode1_select(void)
+{
+#ifdef RTE_ARCH_X86
+  const uint16_t simd = rte_vect_get_max_simd_bitwidth();
+
+#ifdef CC_AVX512_SUPPORT
+  if (simd >= RTE_VECT_SIMD_512 &&
+      rte_cpu_get_flag_enabled(RTE_CPUFLAG_AVX512F) == 1 &&
+      rte_cpu_get_flag_enabled(RTE_CPUFLAG_AVX512BW) == 1) {
+    PMD_NTACC_LOG(DEBUG, "Using AVX512 vector RX\n");
+    return eth_ntacc_rx_mode1_avx512;
+  }
+#endif
+#ifdef CC_AVX2_SUPPORT
+  if (simd >= RTE_VECT_SIMD_256 &&
+      rte_cpu_get_flag_enabled(RTE_CPUFLAG_AVX2) == 1) {
+    PMD_NTACC_LOG(DEBUG, "Using AVX2 vector RX\n");
+    return eth_ntacc_rx_mode1_avx2;
+  }
+#endif
+  if (simd >= RTE_VECT_SIMD_128) {
+    PMD_NTACC_LOG(DEBUG, "Using SSE vector RX\n");
+    return eth_ntacc_rx_mode1_sse;
+  }
+#endif
+  return eth_ntacc_rx_mode1;
+}
+#endif
+
+/**
+ * Fill an mbuf from a packet of a segment. Returns the byte count of the
+ * packet.
+ */
+static __rte_always_inline uint32_t eth_ntacc_rx_seg_pkt(struct ntacc_rx_queue *rx_q,
+                                                         struct rte_mbuf *mbuf,
+                                                         NtDyn3Descr_t *dyn3)
+{
+  uint16_t data_len;
+
+  rte_mbuf_refcnt_set(mbuf, 1);
+  rte_pktmbuf_reset(mbuf);
+
+  switch (dyn3->descrLength)
+  {
+  case 20:
+    // We do have a hash value defined
+    mbuf->hash.rss = dyn3->color_hi;
+    mbuf->ol_flags |= PKT_RX_RSS_HASH;
+    break;
+  case 22:
+    // We do have a color value defined
+    mbuf->hash.fdir.hi = ((dyn3->color_hi << 14) & 0xFFFFC000) | dyn3->color_lo;
+    mbuf->ol_flags |= PKT_RX_FDIR_ID | PKT_RX_FDIR;
+    break;
+  case 24:
+    // We do have a colormask set for protocol lookup
+    mbuf->packet_type = ((dyn3->color_hi << 14) & 0xFFFFC000) | dyn3->color_lo;
+    if (mbuf->packet_type != 0) {
+      mbuf->hash.fdir.lo = dyn3->offset0;
+      mbuf->hash.fdir.hi = dyn3->offset1;
+      mbuf->ol_flags |= PKT_RX_FDIR_FLX | PKT_RX_FDIR;
+    }
+    break;
+  }
+
+  if (enable_ts[rx_q->in_port]) {
+    *RTE_MBUF_DYNFIELD(mbuf, timestamp_dynfield_offset, rte_mbuf_timestamp_t *) =
+      dyn3->timestamp * rx_q->tsMultiplier;
+    mbuf->ol_flags |= timestamp_rx_dynflag;
+  }
+  mbuf->port = rx_q->in_port + (dyn3->rxPort - rx_q->local_port);
+
+  data_len = (uint16_t)(dyn3->capLength - dyn3->descrLength);
+  if (data_len <= rx_q->buf_size) {
+    /* Packet will fit in the mbuf, go ahead and copy */
+    mbuf->pkt_len = mbuf->data_len = data_len;
+    rte_memcpy((u_char *)mbuf->buf_addr + mbuf->data_off, (uint8_t *)dyn3 + dyn3->descrLength, mbuf->data_len);
+#ifdef COPY_OFFSET0
+    mbuf->data_off += dyn3->offset0;
+#endif
+  } else {
+    /* Try read jumbo frame into multi mbufs. */
+    eth_ntacc_rx_jumbo(rx_q, mbuf, (uint8_t *)dyn3 + dyn3->descrLength, data_len);
+  }
+  return data_len + 4;
+}
+
 static uint16_t eth_ntacc_rx_mode2(void *queue,
                                    struct rte_mbuf **bufs,
                                    uint16_t nb_pkts)
 {
-  struct rte_mbuf *mbuf;
   struct ntacc_rx_queue *rx_q = queue;
-#ifdef USE_SW_STAT
   uint32_t bytes = 0;
-#endif
   uint16_t num_rx = 0;
 
   if (unlikely(rx_q->pNetRx == NULL || nb_pkts == 0))
@@ -541,121 +823,226 @@ static uint16_t eth_ntacc_rx_mode2(void *queue,
     }
   }
 
-  NtDyn3Descr_t *dyn3;
   uint16_t i;
-  uint16_t mbuf_len;
-  uint16_t data_len;
 
   if (rte_mempool_get_bulk(rx_q->mb_pool, (void **)bufs, nb_pkts) != 0)
     return 0;
 
   for (i = 0; i < nb_pkts; i++) {
-    mbuf = bufs[i];
-    rte_mbuf_refcnt_set(mbuf, 1);
-    rte_pktmbuf_reset(mbuf);
-
-    dyn3 = _NT_NET_GET_PKT_DESCR_PTR_DYN3(&rx_q->pkt);
+    bytes += eth_ntacc_rx_seg_pkt(rx_q, bufs[i], _NT_NET_GET_PKT_DESCR_PTR_DYN3(&rx_q->pkt));
+    num_rx++;
 
-    switch (dyn3->descrLength)
-    {
-    case 20:
-      // We do have a hash value defined
-      mbuf->hash.rss = dyn3->color_hi;
-      mbuf->ol_flags |= PKT_RX_RSS_HASH;
-      break;
-    case 22:
-      // We do have a color value defined
-      mbuf->hash.fdir.hi = ((dyn3->color_hi << 14) & 0xFFFFC000) | dyn3->color_lo;
-      mbuf->ol_flags |= PKT_RX_FDIR_ID | PKT_RX_FDIR;
-      break;
-    case 24:
-      // We do have a colormask set for protocol lookup
-      mbuf->packet_type = ((dyn3->color_hi << 14) & 0xFFFFC000) | dyn3->color_lo;
-      if (mbuf->packet_type != 0) {
-        mbuf->hash.fdir.lo = dyn3->offset0;
-        mbuf->hash.fdir.hi = dyn3->offset1;
-        mbuf->ol_flags |= PKT_RX_FDIR_FLX | PKT_RX_FDIR;
-      }
+    /* Get the next packet if any */
+    if (_nt_net_get_next_packet(rx_q->pSeg, NT_NET_GET_SEGMENT_LENGTH(rx_q->pSeg), &rx_q->pkt) == 0 ) {
+      (*_NT_NetRxRelease)(rx_q->pNetRx, rx_q->pSeg);
+      rx_q->pSeg = NULL;
       break;
     }
+  }
+#ifdef USE_SW_STAT
+  ntacc_stats_add(rx_q->stats, num_rx, bytes, 0);
+#else
+  RTE_SET_USED(bytes);
+#endif
+  if (num_rx < nb_pkts) {
+    rte_mempool_put_bulk(rx_q->mb_pool, (void * const *)(bufs + num_rx), nb_pkts-num_rx);
+  }
+  return num_rx;
+}
+
+static const char *rxModeNames[] = {
+  [NTACC_RX_MODE_AUTO] = "auto",
+  [NTACC_RX_MODE_SEGMENT] = "segment",
+  [NTACC_RX_MODE_SCALAR] = "scalar",
+  [NTACC_RX_MODE_SSE] = "sse",
+  [NTACC_RX_MODE_AVX2] = "avx2",
+  [NTACC_RX_MODE_AVX512] = "avx512",
+};
 
-    if (enable_ts[rx_q->in_port]) {
-      *RTE_MBUF_DYNFIELD(mbuf, timestamp_dynfield_offset, rte_mbuf_timestamp_t *) =
-        dyn3->timestamp * rx_q->tsMultiplier;
-      mbuf->ol_flags |= timestamp_rx_dynflag;
+/**
+ * Select the RX function from the adapter capability and the rxmode
+ * devarg. A mode that the adapter, the build or the CPU cannot use
+ * falls back to the automatic selection.
+ */
+static eth_rx_burst_t eth_ntacc_rx_select(struct pmd_internals *internals)
+{
+  if (internals->rxMode == NTACC_RX_MODE_SEGMENT) {
+    internals->mode2Rx = 1;
+  }
+  if (internals->mode2Rx) {
+    if (internals->rxMode != NTACC_RX_MODE_AUTO && internals->rxMode != NTACC_RX_MODE_SEGMENT) {
+      PMD_NTACC_LOG(WARNING, "%s=%s is not supported by the adapter. Ignored\n", ETH_NTACC_RXMODE_ARG, rxModeNames[internals->rxMode]);
     }
-    mbuf->port = rx_q->in_port + (dyn3->rxPort - rx_q->local_port);
+    return eth_ntacc_rx_mode2;
+  }
 
-    data_len = (uint16_t)(dyn3->capLength - dyn3->descrLength);
-    mbuf_len = rte_pktmbuf_tailroom(mbuf);
-#ifdef USE_SW_STAT
-    bytes += data_len+4;
+#ifdef USE_EXTERNAL_BUFFER
+  if (internals->rxMode != NTACC_RX_MODE_AUTO && internals->rxMode != NTACC_RX_MODE_SCALAR) {
+    PMD_NTACC_LOG(WARNING, "%s=%s is not supported with external buffers. Ignored\n", ETH_NTACC_RXMODE_ARG, rxModeNames[internals->rxMode]);
+  }
+  return eth_ntacc_rx_mode1;
+#else
+  switch (internals->rxMode) {
+  case NTACC_RX_MODE_AUTO:
+    return eth_ntacc_rx_mode1_select();
+  case NTACC_RX_MODE_SCALAR:
+    return eth_ntacc_rx_mode1;
+#ifdef RTE_ARCH_X86
+  case NTACC_RX_MODE_SSE:
+    return eth_ntacc_rx_mode1_sse;
+#ifdef CC_AVX2_SUPPORT
+  case NTACC_RX_MODE_AVX2:
+    if (rte_cpu_get_flag_enabled(RTE_CPUFLAG_AVX2) == 1) {
+      return eth_ntacc_rx_mode1_avx2;
+    }
+    break;
 #endif
-    if (data_len <= mbuf_len) {
-      /* Packet will fit in the mbuf, go ahead and copy */
-      mbuf->pkt_len = mbuf->data_len = data_len;
-      rte_memcpy((u_char *)mbuf->buf_addr + mbuf->data_off, (uint8_t *)dyn3 + dyn3->descrLength, mbuf->data_len);
-#ifdef COPY_OFFSET0
-      mbuf->data_off += dyn3->offset0;
+#ifdef CC_AVX512_SUPPORT
+  case NTACC_RX_MODE_AVX512:
+    if (rte_cpu_get_flag_enabled(RTE_CPUFLAG_AVX512F) == 1 &&
+        rte_cpu_get_flag_enabled(RTE_CPUFLAG_AVX512BW) == 1) {
+      return eth_ntacc_rx_mode1_avx512;
+    }
+    break;
 #endif
-  } else {
-      /* Try read jumbo frame into multi mbufs. */
-      struct rte_mbuf *m;
-      const u_char *data;
-      uint16_t total_len = data_len;
-      uint16_t filled_so_far;
-
-      mbuf->pkt_len = total_len;
-      mbuf->data_len = mbuf_len;
-      filled_so_far = mbuf_len;
-
-      data = (u_char *)dyn3 + dyn3->descrLength;
-      rte_memcpy((u_char *)mbuf->buf_addr + mbuf->data_off, data, mbuf_len);
-      data_len -= mbuf_len;
-      data += mbuf_len;
-
-      m = mbuf;
-      while (data_len > 0) {
-        /* Allocate next mbuf and point to that. */
-        m->next = rte_pktmbuf_alloc(rx_q->mb_pool);
-        if (unlikely(!m->next)) {
-          struct rte_mbuf *b = mbuf;
-          while (b != NULL) {
-            b->pkt_len = filled_so_far;
-            b = b->next;
-          }
-          m->data_len = mbuf_len;
-          num_rx++;
-          goto OutOfMbufs;
-        }
+#endif
+  default:
+    break;
+  }
+  PMD_NTACC_LOG(WARNING, "%s=%s is not supported by the build or the CPU. Ignored\n", ETH_NTACC_RXMODE_ARG, rxModeNames[internals->rxMode]);
+  return eth_ntacc_rx_mode1_select();
+#endif
+}
+
+/**
+ * Make sure a merged stream has a current packet. Returns 0 if the stream
+ * has no data.
+ */
+static __rte_always_inline int eth_ntacc_rx_merge_head(struct ntacc_rx_merge_stream_s *stream)
+{
+  if (stream->pSeg != NULL)
+    return 1;
+
+  if ((*_NT_NetRxGet)(stream->pNetRx, &stream->pSeg, 0) != NT_SUCCESS) {
+    if (stream->pSeg != NULL) {
+      (*_NT_NetRxRelease)(stream->pNetRx, stream->pSeg);
+      stream->pSeg = NULL;
+    }
+    return 0;
+  }
+  if (unlikely(NT_NET_GET_SEGMENT_LENGTH(stream->pSeg) == 0)) {
+    (*_NT_NetRxRelease)(stream->pNetRx, stream->pSeg);
+    stream->pSeg = NULL;
+    return 0;
+  }
+  _nt_net_build_pkt_netbuf(stream->pSeg, &stream->pkt);
+  return 1;
+}
+
+/*
+ * Return the oldest timestamp a stream with no data can still deliver.
+ * That is the timestamp of its last packet, as the packets of a stream are
+ * in time order. A stream that has had no data for NTACC_RX_MERGE_IDLE_US
+ * no longer holds back the other streams, so an idle port cannot stall
+ * the queue.
+ */
+static __rte_always_inline uint64_t eth_ntacc_rx_merge_watermark(struct ntacc_rx_merge_s *merge,
+                                                                 struct ntacc_rx_merge_stream_s *stream,
+                                                                 uint64_t *now)
+{
+  if (*now == 0)
+    *now = rte_get_timer_cycles();
+  if (stream->idle == 0)
+    stream->idle = *now;
+  else if (*now - stream->idle >= merge->idleTimeout)
+    return UINT64_MAX;
+  return stream->lastTs;
+}
+
+/*
+ * Callback for RX queues with merged streams. Each round takes the packet
+ * with the lowest timestamp of the stream heads. The streams are few, so
+ * the heads are just scanned.
+ * A stream with no data can still deliver packets as old as its last one.
+ * Packets newer than that watermark are held back until the stream has
+ * data again or has been idle for NTACC_RX_MERGE_IDLE_US.
+ */
+static uint16_t eth_ntacc_rx_merge(void *queue,
+                                   struct rte_mbuf **bufs,
+                                   uint16_t nb_pkts)
+{
+  struct ntacc_rx_queue *rx_q = queue;
+  struct ntacc_rx_merge_s *merge = rx_q->merge;
+  struct ntacc_rx_merge_stream_s *stream;
+  uint64_t watermark = UINT64_MAX;
+  uint64_t now = 0;
+  uint64_t ts;
+  uint32_t active = 0;
+  uint32_t bytes = 0;
+  uint16_t num_rx = 0;
+  uint16_t i;
+
+  if (merge == NULL) {
+    return rx_q->rxBurst(queue, bufs, nb_pkts);
+  }
+
+  if (unlikely(rx_q->pNetRx == NULL || nb_pkts == 0))
+    return 0;
+
+  for (i = 0; i < merge->nb_streams; i++) {
+    stream = &merge->stream[i];
+    if (eth_ntacc_rx_merge_head(stream)) {
+      stream->idle = 0;
+      active |= 1 << i;
+    }
+    else {
+      watermark = RTE_MIN(watermark, eth_ntacc_rx_merge_watermark(merge, stream, &now));
+    }
+  }
+  if (active == 0)
+    return 0;
 
-        m = m->next;
-        /* Copy next segment. */
-        mbuf_len = RTE_MIN(rte_pktmbuf_tailroom(m), data_len);
-        rte_memcpy((u_char *)m->buf_addr + m->data_off, data, mbuf_len);
+  if (rte_mempool_get_bulk(rx_q->mb_pool, (void **)bufs, nb_pkts) != 0)
+    return 0;
 
-        m->pkt_len = total_len;
-        m->data_len = mbuf_len;
-        filled_so_far += mbuf_len;
+  while (num_rx < nb_pkts && active) {
+    NtDyn3Descr_t *dyn3 = NULL;
 
-        mbuf->nb_segs++;
-        data_len -= mbuf_len;
-        data += mbuf_len;
+    stream = NULL;
+    for (i = 0; i < merge->nb_streams; i++) {
+      if (active & (1 << i)) {
+        NtDyn3Descr_t *head = _NT_NET_GET_PKT_DESCR_PTR_DYN3(&merge->stream[i].pkt);
+        if (dyn3 == NULL || head->timestamp < dyn3->timestamp) {
+          dyn3 = head;
+          stream = &merge->stream[i];
+        }
       }
     }
-    num_rx++;
 
-    /* Get the next packet if any */
-    if (_nt_net_get_next_packet(rx_q->pSeg, NT_NET_GET_SEGMENT_LENGTH(rx_q->pSeg), &rx_q->pkt) == 0 ) {
-      (*_NT_NetRxRelease)(rx_q->pNetRx, rx_q->pSeg);
-      rx_q->pSeg = NULL;
+    ts = dyn3->timestamp;
+    if (ts > watermark)
       break;
+
+    bytes += eth_ntacc_rx_seg_pkt(rx_q, bufs[num_rx], dyn3);
+    stream->lastTs = ts;
+    num_rx++;
+
+    /* Get the next packet of the stream */
+    if (_nt_net_get_next_packet(stream->pSeg, NT_NET_GET_SEGMENT_LENGTH(stream->pSeg), &stream->pkt) == 0) {
+      (*_NT_NetRxRelease)(stream->pNetRx, stream->pSeg);
+      stream->pSeg = NULL;
+      if (!eth_ntacc_rx_merge_head(stream)) {
+        // The next packets of the stream may be older than the waiting
+        // packets of the other streams
+        active &= ~(1 << (stream - merge->stream));
+        watermark = RTE_MIN(watermark, eth_ntacc_rx_merge_watermark(merge, stream, &now));
+      }
     }
   }
-OutOfMbufs:
 #ifdef USE_SW_STAT
-  rx_q->rx_pkts+=num_rx;
-  rx_q->rx_bytes+=bytes;
+  ntacc_stats_add(rx_q->stats, num_rx, bytes, 0);
+#else
+  RTE_SET_USED(bytes);
 #endif
   if (num_rx < nb_pkts) {
     rte_mempool_put_bulk(rx_q->mb_pool, (void * const *)(bufs + num_rx), nb_pkts-num_rx);
@@ -667,13 +1054,15 @@ static uint16_t eth_ntacc_rx_mode2(void *queue,
 /*
  * Callback to handle sending packets through a real NIC.
  */
-static uint16_t eth_ntacc_tx_mode1(void *queue,
-                             struct rte_mbuf **bufs,
-                             uint16_t nb_pkts)
+static __rte_always_inline uint16_t eth_ntacc_tx_mode1_common(void *queue,
+                                                              struct rte_mbuf **bufs,
+                                                              uint16_t nb_pkts,
+                                                              const bool timed)
 {
   unsigned i;
   struct ntacc_tx_queue *tx_q = queue;
   uint32_t bytes=0;
+  uint32_t errors=0;
   if (unlikely(tx_q == NULL || tx_q->pNetTx == NULL || nb_pkts == 0)) {
     return 0;
   }
@@ -698,17 +1087,15 @@ static uint16_t eth_ntacc_tx_mode1(void *queue,
     /* Detect packet size */
     uint16_t sLen;
     uint16_t wLen = mbuf->pkt_len + 4; // Make room for FCS
+    uint16_t pad = 0;
     /* Check if packet needs padding or is too big to transmit */
     if (unlikely(wLen < tx_q->minTxPktSize)) {
+      pad = tx_q->minTxPktSize - wLen;
       wLen = tx_q->minTxPktSize; // Add padding
-      //TODO: There is a data leak issue here. If wLen is just extended
-      //the memory in the ring is not zero'ed and padding will contain
-      //data from previous packets. For performance reasons this has not been
-      //addressed, but the fix is to memset() the padding area.
     }
     if (unlikely(wLen > tx_q->maxTxPktSize)) {
       /* Packet is too big. Drop it as an error and continue */
-      tx_q->err_pkts++;
+      errors++;
       rte_pktmbuf_free(bufs[i]);
       continue;
     }
@@ -717,8 +1104,24 @@ static uint16_t eth_ntacc_tx_mode1(void *queue,
     // Do we have space for this packet
     if (likely(spaceLeft >= sLen)) {
       // Add packet descriptor
-      *((uint64_t*)dst)=0;
-      *((uint64_t*)dst+1)=(0x0100000040100000LL | (uint64_t)wLen<<32 | sLen);
+      if (timed && (mbuf->ol_flags & tx_q->tsFlag)) {
+        /*
+         * With txNow cleared the adapter holds the packet until the TX
+         * clock of the port reaches the timestamp. txSetClock sets the
+         * TX clock to the timestamp of the packet.
+         */
+        NtStd0Descr_t *std0 = (NtStd0Descr_t *)dst;
+        *((uint64_t*)dst) = *RTE_MBUF_DYNFIELD(mbuf, timestamp_dynfield_offset, rte_mbuf_timestamp_t *) / tx_q->tsDivider;
+        *((uint64_t*)dst+1) = (0x0100000040100000LL | (uint64_t)wLen<<32 | sLen);
+        std0->txNow = 0;
+        if (unlikely(*tx_q->pSetClock) && __atomic_exchange_n(tx_q->pSetClock, 0, __ATOMIC_RELAXED)) {
+          std0->txSetClock = 1;
+        }
+      }
+      else {
+        *((uint64_t*)dst)=0;
+        *((uint64_t*)dst+1)=(0x0100000040100000LL | (uint64_t)wLen<<32 | sLen);
+      }
       // Copy the packet to the destination
       rte_memcpy(dst + 16, rte_pktmbuf_mtod(mbuf, u_char *), mbuf->data_len);
       dst += (16 + mbuf->data_len);
@@ -729,6 +1132,10 @@ static uint16_t eth_ntacc_tx_mode1(void *queue,
           dst += mbuf->data_len;
         }
       }
+      if (unlikely(pad)) {
+        // Do not send old ring data as padding
+        memset(dst, 0, pad);
+      }
       off += sLen;
       bytes += wLen;
       spaceLeft -= sLen;
@@ -746,21 +1153,196 @@ static uint16_t eth_ntacc_tx_mode1(void *queue,
   *tx_q->ringControl.pWrite = offW;
 
 #ifdef USE_SW_STAT
-  tx_q->tx_pkts += i;
-  tx_q->tx_bytes += bytes;
+  ntacc_stats_add(tx_q->stats, i, bytes, errors);
+#else
+  if (unlikely(errors)) {
+    ntacc_stats_add(tx_q->stats, 0, 0, errors);
+  }
 #endif
   return i;
 }
 
-static uint16_t eth_ntacc_tx_mode2(void *queue,
+static uint16_t eth_ntacc_tx_mode1(void *queue,
                                    struct rte_mbuf **bufs,
                                    uint16_t nb_pkts)
 {
-  unsigned i;
+  return eth_ntacc_tx_mode1_common(queue, bufs, nb_pkts, false);
+}
+
+/**
+ * Send packets with the TX timestamp flag set at the time in their
+ * timestamp field. Other packets are sent at once.
+ */
+static uint16_t eth_ntacc_tx_mode1_timed(void *queue,
+                                         struct rte_mbuf **bufs,
+                                         uint16_t nb_pkts)
+{
+  return eth_ntacc_tx_mode1_common(queue, bufs, nb_pkts, true);
+}
+
+/**
+ * Copy to the TX ring using non-temporal stores, so packet data being sent
+ * does not evict the working set from the cache.
+ */
+static __rte_always_inline void eth_ntacc_tx_copy_stream(uint8_t *dst, const uint8_t *src, uint32_t len)
+{
+#ifdef RTE_ARCH_X86
+  uint32_t head = (uint32_t)(-(uintptr_t)dst & 15);
+
+  // Align the destination for the streaming stores
+  if (head) {
+    head = RTE_MIN(head, len);
+    rte_memcpy(dst, src, head);
+    dst += head;
+    src += head;
+    len -= head;
+  }
+  while (len >= 16) {
+    _mm_stream_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)src));
+    dst += 16;
+    src += 16;
+    len -= 16;
+  }
+  if (len) {
+    rte_memcpy(dst, src, len);
+  }
+#else
+  rte_memcpy(dst, src, len);
+#endif
+}
+
+#define NTACC_TX_BATCH 32
+
+/**
+ * TX mode1 using streaming stores. The packets of a batch are sized first,
+ * then descriptors and data are written without reading the ring and the
+ * mbufs are freed in bulk.
+ */
+static uint16_t eth_ntacc_tx_mode1_stream(void *queue,
+                                          struct rte_mbuf **bufs,
+                                          uint16_t nb_pkts)
+{
+  struct ntacc_tx_queue *tx_q = queue;
+  uint16_t wLen[NTACC_TX_BATCH];
+  uint16_t sLen[NTACC_TX_BATCH];
+  uint32_t bytes = 0;
+  uint32_t errors = 0;
+  uint16_t num_tx = 0;
+
+  if (unlikely(tx_q == NULL || tx_q->pNetTx == NULL || nb_pkts == 0)) {
+    return 0;
+  }
+  uint64_t spaceLeft;
+  uint64_t offR, offW, off = 0;
+  uint8_t *ring;
+  offR = *tx_q->ringControl.pRead;
+  offW = *tx_q->ringControl.pWrite;
+  ring =  tx_q->ringControl.ring + offW;
+  if (offW >= offR) {
+    spaceLeft = tx_q->ringControl.size - (offW - offR);
+  } else {
+    spaceLeft = tx_q->ringControl.size - ((offW+(2*tx_q->ringControl.size)) - offR);
+  }
+  if (offW >= tx_q->ringControl.size) {
+    ring -= tx_q->ringControl.size; // Rebase the dst pointer
+  }
+
+  while (num_tx < nb_pkts) {
+    const uint16_t num = RTE_MIN(nb_pkts - num_tx, NTACC_TX_BATCH);
+    struct rte_mbuf **pkts = bufs + num_tx;
+    uint16_t i, n;
+
+    /* Size the packets and find how many will fit */
+    for (n = 0; n < num; n++) {
+      uint16_t len = pkts[n]->pkt_len + 4; // Make room for FCS
+      if (unlikely(len < tx_q->minTxPktSize)) {
+        len = tx_q->minTxPktSize; // Add padding
+      }
+      if (unlikely(len > tx_q->maxTxPktSize)) {
+        /* Packet is too big. Dropped as an error below */
+        sLen[n] = 0;
+        wLen[n] = 0;
+        continue;
+      }
+      // 8B align wireLength and add 16B descriptor
+      const uint16_t size = ((len + 7) & ~7) + 16;
+      if (spaceLeft < size) {
+        break;
+      }
+      spaceLeft -= size;
+      wLen[n] = len;
+      sLen[n] = size;
+    }
+
+    /* Write descriptors and packets */
+    for (i = 0; i < n; i++) {
+      struct rte_mbuf *mbuf = pkts[i];
+      uint8_t *dst = ring + off;
+
+      if (unlikely(sLen[i] == 0)) {
+        errors++;
+        continue;
+      }
+#ifdef RTE_ARCH_X86_64
+      _mm_stream_si64((long long *)dst, 0);
+      _mm_stream_si64((long long *)dst + 1, (long long)(0x0100000040100000LL | (uint64_t)wLen[i]<<32 | sLen[i]));
+#else
+      *((uint64_t*)dst)=0;
+      *((uint64_t*)dst+1)=(0x0100000040100000LL | (uint64_t)wLen[i]<<32 | sLen[i]);
+#endif
+      dst += 16;
+      do {
+        eth_ntacc_tx_copy_stream(dst, rte_pktmbuf_mtod(mbuf, const uint8_t *), mbuf->data_len);
+        dst += mbuf->data_len;
+        mbuf = mbuf->next;
+      } while (mbuf);
+      if (unlikely(wLen[i] > pkts[i]->pkt_len + 4)) {
+        // Do not send old ring data as padding
+        memset(dst, 0, wLen[i] - pkts[i]->pkt_len - 4);
+      }
+      off += sLen[i];
+      bytes += wLen[i];
+    }
+    rte_pktmbuf_free_bulk(pkts, n);
+    num_tx += n;
+
+    if (n < num) {
+      // We cannot place more packets
+      break;
+    }
+  }
+
+#ifdef RTE_ARCH_X86
+  /* The streaming stores must be visible before the write offset */
+  _mm_sfence();
+#endif
+  // Update the write offset
+  offW += off;
+  if (offW >= (2*tx_q->ringControl.size)) {
+    offW -= (2*tx_q->ringControl.size);
+  }
+  *tx_q->ringControl.pWrite = offW;
+
+#ifdef USE_SW_STAT
+  ntacc_stats_add(tx_q->stats, num_tx, bytes, errors);
+#else
+  if (unlikely(errors)) {
+    ntacc_stats_add(tx_q->stats, 0, 0, errors);
+  }
+#endif
+  return num_tx;
+}
+
+static uint16_t eth_ntacc_tx_mode2(void *queue,
+                                   struct rte_mbuf **bufs,
+                                   uint16_t nb_pkts)
+{
+  unsigned i;
   int ret;
   struct ntacc_tx_queue *tx_q = queue;
 #ifdef USE_SW_STAT
   uint32_t bytes=0;
+  uint32_t errors=0;
 #endif
 
   if (unlikely(tx_q == NULL || tx_q->pNetTx == NULL || nb_pkts == 0)) {
@@ -791,7 +1373,7 @@ static uint16_t eth_ntacc_tx_mode2(void *queue,
     if (unlikely(wLen > tx_q->maxTxPktSize)) {
       /* Packet is too big. Drop it as an error and continue */
 #ifdef USE_SW_STAT
-      tx_q->err_pkts++;
+      errors++;
 #endif
       rte_pktmbuf_free(bufs[i]);
       continue;
@@ -800,7 +1382,7 @@ static uint16_t eth_ntacc_tx_mode2(void *queue,
     if (unlikely(ret != NT_SUCCESS)) {
       /* unsent packets is not expected to be freed */
 #ifdef USE_SW_STAT
-      tx_q->err_pkts++;
+      errors++;
 #endif
       break;
     }
@@ -810,13 +1392,29 @@ static uint16_t eth_ntacc_tx_mode2(void *queue,
     rte_pktmbuf_free(bufs[i]);
   }
 #ifdef USE_SW_STAT
-  tx_q->tx_pkts += i;
-  tx_q->tx_bytes += bytes;
+  ntacc_stats_add(tx_q->stats, i, bytes, errors);
 #endif
 
   return i;
 }
 
+/**
+ * Select the TX function from the adapter capability, the TX offloads and
+ * the txmode devarg.
+ */
+static eth_tx_burst_t eth_ntacc_tx_select(struct rte_eth_dev *dev)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+
+  if (internals->mode2Tx)
+    return eth_ntacc_tx_mode2;
+  if (dev->data->dev_conf.txmode.offloads & DEV_TX_OFFLOAD_SEND_ON_TIMESTAMP)
+    return eth_ntacc_tx_mode1_timed;
+  if (internals->txMode == NTACC_TX_MODE_STREAM)
+    return eth_ntacc_tx_mode1_stream;
+  return eth_ntacc_tx_mode1;
+}
+
 
 static int _create_drop_errored_packets_filter(struct pmd_internals *internals) {
   /* Create a default filter to drop all error packets */
@@ -855,6 +1453,88 @@ static int _destroy_drop_errored_packets_filter(struct pmd_internals *internals)
   return 0;
 }
 
+/**
+ * Read the NUMA node of the host buffers of a stream. Returns -1 if it is
+ * not known.
+ */
+static int _readStreamNuma(uint32_t streamId)
+{
+  NtInfo_t *pInfo = NULL;
+  NtInfoStream_t hInfo = NULL;
+  int status;
+  int numaNode = -1;
+
+  pInfo = (NtInfo_t *)rte_malloc("ntacc", sizeof(NtInfo_t), 0);
+  if (!pInfo) {
+    _log_out_of_memory_errors(__func__);
+    return -1;
+  }
+
+  if ((status = (*_NT_InfoOpen)(&hInfo, "DPDKReadStreamNuma")) != NT_SUCCESS) {
+    _log_nt_errors(status, "NT_InfoOpen failed", __func__);
+    rte_free(pInfo);
+    return -1;
+  }
+
+  pInfo->cmd = NT_INFO_CMD_READ_STREAMID;
+  pInfo->u.streamID.streamId = streamId;
+  if ((status = (*_NT_InfoRead)(hInfo, pInfo)) != NT_SUCCESS) {
+    _log_nt_errors(status, "NT_InfoRead failed", __func__);
+  }
+  else if (pInfo->u.streamID.data.numHostBuffers > 0) {
+    numaNode = (int)pInfo->u.streamID.data.numaNode;
+  }
+  (void)(*_NT_InfoClose)(hInfo);
+  rte_free(pInfo);
+  return numaNode;
+}
+
+/*
+ * Open the streams merged into an RX queue. Stream 0 is the queue's own
+ * stream, which is already open.
+ */
+static int _rx_merge_open(struct ntacc_rx_queue *rx_q)
+{
+  struct ntacc_rx_merge_s *merge = rx_q->merge;
+  uint16_t i;
+  int status;
+
+  merge->stream[0].pNetRx = rx_q->pNetRx;
+  merge->stream[0].stream_id = rx_q->stream_id;
+  merge->idleTimeout = rte_get_timer_hz() * NTACC_RX_MERGE_IDLE_US / 1000000;
+  for (i = 0; i < merge->nb_streams; i++) {
+    merge->stream[i].pSeg = NULL;
+    merge->stream[i].lastTs = 0;
+    merge->stream[i].idle = 0;
+    if (i > 0) {
+      if ((status = (*_NT_NetRxOpen)(&merge->stream[i].pNetRx, "DPDK", NT_NET_INTERFACE_SEGMENT, merge->stream[i].stream_id, -1)) != NT_SUCCESS) {
+        _log_nt_errors(status, "NT_NetRxOpen() failed on a merged stream", __func__);
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+static void _rx_merge_close(struct ntacc_rx_queue *rx_q)
+{
+  struct ntacc_rx_merge_s *merge = rx_q->merge;
+  uint16_t i;
+
+  for (i = 0; i < merge->nb_streams; i++) {
+    if (merge->stream[i].pNetRx == NULL)
+      continue;
+    if (merge->stream[i].pSeg) {
+      (*_NT_NetRxRelease)(merge->stream[i].pNetRx, merge->stream[i].pSeg);
+      merge->stream[i].pSeg = NULL;
+    }
+    if (i > 0) {
+      (void)(*_NT_NetRxClose)(merge->stream[i].pNetRx);
+    }
+    merge->stream[i].pNetRx = NULL;
+  }
+}
+
 static int eth_dev_start(struct rte_eth_dev *dev)
 {
   struct pmd_internals *internals = dev->data->dev_private;
@@ -940,12 +1620,28 @@ static int eth_dev_start(struct rte_eth_dev *dev)
 
   _create_drop_errored_packets_filter(internals);
 
+  dev->rx_pkt_burst = internals->rxBurst;
   for (queue = 0; queue < dev->data->nb_rx_queues; queue++) {
     if (rx_q[queue].enabled) {
       if ((status = (*_NT_NetRxOpen)(&rx_q[queue].pNetRx, "DPDK", NT_NET_INTERFACE_SEGMENT, rx_q[queue].stream_id, -1)) != NT_SUCCESS) {
         _log_nt_errors(status, "NT_NetRxOpen() failed", __func__);
         goto StartError;
       }
+      rx_q[queue].hbNumaNode = _readStreamNuma(rx_q[queue].stream_id);
+      PMD_NTACC_LOG(INFO, "Port %u RX queue %u: Stream %u host buffers on NUMA node %d, mempool on node %d, adapter on node %d\n",
+                    dev->data->port_id, queue, rx_q[queue].stream_id, rx_q[queue].hbNumaNode,
+                    rx_q[queue].mb_pool->socket_id, internals->numaNode);
+      if (rx_q[queue].hbNumaNode >= 0 && rx_q[queue].mb_pool->socket_id != SOCKET_ID_ANY &&
+          rx_q[queue].hbNumaNode != rx_q[queue].mb_pool->socket_id) {
+        PMD_NTACC_LOG(WARNING, "Port %u RX queue %u: The host buffers and the mempool are on different NUMA nodes\n",
+                      dev->data->port_id, queue);
+      }
+      if (rx_q[queue].merge) {
+        if (_rx_merge_open(&rx_q[queue]) != 0) {
+          goto StartError;
+        }
+        dev->rx_pkt_burst = eth_ntacc_rx_merge;
+      }
       memset(&rx_q[queue].ringControl, 0, sizeof(rx_q[queue].ringControl));
       eth_rx_queue_start(dev, queue);
     }
@@ -973,7 +1669,11 @@ static int eth_dev_start(struct rte_eth_dev *dev)
       }
     }
     tx_q[queue].plock = &port_locks[tx_q[queue].port];
+    tx_q[queue].pSetClock = &port_set_clock[tx_q[queue].port];
   }
+  // The TX clock is shared by all TX queues of the port. Only the first
+  // timestamped packet sent on any of them sets it.
+  __atomic_store_n(&port_set_clock[internals->port], 1, __ATOMIC_RELAXED);
 
 #ifndef USE_SW_STAT
   /* Open the stat stream */
@@ -984,6 +1684,11 @@ static int eth_dev_start(struct rte_eth_dev *dev)
     goto StartError;
   }
   NTACC_UNLOCK(&internals->statlock);
+
+  /* Start caching statistics snapshots */
+  if (_stat_snapshot_start(internals) != 0) {
+    goto StartError;
+  }
 #endif
 
   dev->data->dev_link.link_status = 1;
@@ -1022,6 +1727,9 @@ static int eth_dev_stop(struct rte_eth_dev *dev)
       if (rx_q[queue].pSeg) {
         (*_NT_NetRxRelease)(rx_q[queue].pNetRx, rx_q[queue].pSeg);
         rx_q[queue].pSeg = NULL;
+      }
+      if (rx_q[queue].merge) {
+        _rx_merge_close(&rx_q[queue]);
       }
 		}
   }
@@ -1062,6 +1770,7 @@ static int eth_dev_stop(struct rte_eth_dev *dev)
   }
 
 #ifndef USE_SW_STAT
+  _stat_snapshot_stop(internals);
   NTACC_LOCK(&internals->statlock);
   if (internals->hStat) {
     (void)(*_NT_StatClose)(internals->hStat);
@@ -1084,11 +1793,85 @@ static int eth_dev_stop(struct rte_eth_dev *dev)
   return 0;
 }
 
+/**
+ * Mempools created on the adapter NUMA node that still had mbufs held by the
+ * application when their port was closed. They are freed once all their mbufs
+ * are returned, checked each time a port is closed or a pool is created.
+ */
+static struct {
+  rte_spinlock_t lock;
+  uint32_t seq;             // Makes the name of every created pool unique
+  uint16_t nbPending;
+  struct rte_mempool *pending[NTACC_MAX_PENDING_NUMA_POOLS];
+} _numaPools = { .lock = RTE_SPINLOCK_INITIALIZER };
+
+/**
+ * Free the pending mempools that got all their mbufs back.
+ * Must be called with _numaPools.lock held.
+ */
+static void eth_ntacc_rx_numa_pools_reap(void)
+{
+  uint16_t i = 0;
+  while (i < _numaPools.nbPending) {
+    struct rte_mempool *pool = _numaPools.pending[i];
+    if (rte_mempool_full(pool)) {
+      PMD_NTACC_LOG(DEBUG, "Mempool %s has all its mbufs back. Freeing it\n", pool->name);
+      rte_mempool_free(pool);
+      _numaPools.pending[i] = _numaPools.pending[--_numaPools.nbPending];
+    }
+    else {
+      i++;
+    }
+  }
+}
+
+/**
+ * Free the mempools created on the adapter NUMA node. A pool with mbufs still
+ * held by the application is freed later, when they are returned.
+ */
+static void eth_ntacc_rx_numa_pools_free(struct pmd_internals *internals)
+{
+  uint16_t i;
+  rte_spinlock_lock(&_numaPools.lock);
+  eth_ntacc_rx_numa_pools_reap();
+  for (i = 0; i < internals->nbNumaPools; i++) {
+    struct rte_mempool *pool = internals->numaPools[i].pool;
+    if (rte_mempool_full(pool)) {
+      rte_mempool_free(pool);
+    }
+    else if (_numaPools.nbPending < NTACC_MAX_PENDING_NUMA_POOLS) {
+      PMD_NTACC_LOG(WARNING, "Mempool %s still has mbufs in use. It is freed when they are returned\n", pool->name);
+      _numaPools.pending[_numaPools.nbPending++] = pool;
+    }
+    else {
+      PMD_NTACC_LOG(WARNING, "Mempool %s still has mbufs in use. It is not freed\n", pool->name);
+    }
+  }
+  rte_spinlock_unlock(&_numaPools.lock);
+  internals->nbNumaPools = 0;
+}
+
+static void eth_rx_queues_free(struct pmd_internals *internals)
+{
+  uint16_t i;
+  for (i = 0; i < internals->nbRxQueues; i++) {
+    eth_ntacc_rx_stash_free(&internals->rxq[i]);
+    rte_free(internals->rxq[i].merge);
+#ifdef USE_EXTERNAL_BUFFER
+    rte_free(internals->rxq[i].release.done);
+#endif
+  }
+  rte_free(internals->rxq);
+  internals->rxq = NULL;
+  internals->nbRxQueues = 0;
+}
+
 static int eth_dev_configure(struct rte_eth_dev *dev)
 {
   struct pmd_internals *internals = dev->data->dev_private;
   struct rte_eth_conf *eth_conf = &dev->data->dev_conf;
   uint64_t rx_offloads = eth_conf->rxmode.offloads;
+  uint64_t tx_offloads = eth_conf->txmode.offloads;
 
   uint i;
 
@@ -1106,7 +1889,7 @@ static int eth_dev_configure(struct rte_eth_dev *dev)
 
   if (internals->rxq) {
     // This must be second time configure is called. Free the queue memory
-    rte_free(internals->rxq);
+    eth_rx_queues_free(internals);
   }
 
   if (internals->txq) {
@@ -1117,22 +1900,25 @@ static int eth_dev_configure(struct rte_eth_dev *dev)
   internals->rxq = (struct ntacc_rx_queue *)rte_zmalloc_socket(internals->name,
                                                                sizeof(struct ntacc_rx_queue) * dev->data->nb_rx_queues,
                                                                RTE_CACHE_LINE_SIZE,
-                                                               dev->device->numa_node);
+                                                               dev->data->numa_node);
   if (internals->rxq == NULL) {
     PMD_NTACC_LOG(ERR, "Failed to allocate memory for RX queues");
     return -ENOMEM;
   }
+  internals->nbRxQueues = dev->data->nb_rx_queues;
 
   for (i=0; i < dev->data->nb_rx_queues; i++) {
     internals->rxq[i].stream_id = STREAMIDS_PER_PORT * internals->port + i;
     internals->rxq[i].pSeg = NULL;
     internals->rxq[i].enabled = 0;
+    internals->rxq[i].stats = &internals->stats->rxq[i];
+    internals->rxq[i].hbNumaNode = -1;
   }
 
   internals->txq = (struct ntacc_tx_queue *)rte_zmalloc_socket(internals->name,
                                                                sizeof(struct ntacc_tx_queue) * dev->data->nb_tx_queues,
                                                                RTE_CACHE_LINE_SIZE,
-                                                               dev->device->numa_node);
+                                                               dev->data->numa_node);
   if (internals->txq == NULL) {
     PMD_NTACC_LOG(ERR, "Failed to allocate memory for TX queues");
     return -ENOMEM;
@@ -1144,7 +1930,35 @@ static int eth_dev_configure(struct rte_eth_dev *dev)
     internals->txq[i].enabled = 0;
     internals->txq[i].minTxPktSize = internals->minTxPktSize;
     internals->txq[i].maxTxPktSize = internals->maxTxPktSize;
+    internals->txq[i].stats = &internals->stats->txq[i];
+  }
+  internals->stats->nb_rx_queues = dev->data->nb_rx_queues;
+  internals->stats->nb_tx_queues = dev->data->nb_tx_queues;
+#ifdef USE_SW_STAT
+  // Count from the current values of the shared counters
+  eth_stats_reset(dev);
+#endif
+
+  if (tx_offloads & DEV_TX_OFFLOAD_SEND_ON_TIMESTAMP) {
+    uint64_t timestamp_tx_dynflag;
+
+    if (internals->tsMultiplier == 0 || internals->mode2Tx) {
+      PMD_NTACC_LOG(ERR, "Send on timestamp is not supported by the adapter\n");
+      return -ENOTSUP;
+    }
+    if (rte_mbuf_dyn_tx_timestamp_register(&timestamp_dynfield_offset, &timestamp_tx_dynflag) != 0) {
+      PMD_NTACC_LOG(ERR, "Error to register timestamp field/flag\n");
+      return -rte_errno;
+    }
+    for (i = 0; i < dev->data->nb_tx_queues; i++) {
+      internals->txq[i].tsFlag = timestamp_tx_dynflag;
+      internals->txq[i].tsDivider = internals->tsMultiplier;
+    }
   }
+  if (!internals->mode2Tx && internals->txMode != NTACC_TX_MODE_DEFAULT && (tx_offloads & DEV_TX_OFFLOAD_SEND_ON_TIMESTAMP)) {
+    PMD_NTACC_LOG(WARNING, "%s is ignored when sending on timestamp\n", ETH_NTACC_TXMODE_ARG);
+  }
+  dev->tx_pkt_burst = eth_ntacc_tx_select(dev);
 
   if (rx_offloads & DEV_RX_OFFLOAD_TIMESTAMP)
   {
@@ -1154,7 +1968,8 @@ static int eth_dev_configure(struct rte_eth_dev *dev)
       return -EPERM;
     }
     else {
-      if (timestamp_dynfield_offset == -1) {
+      // The field may already be registered for TX, the RX flag is separate
+      if (timestamp_rx_dynflag == 0) {
         if (rte_mbuf_dyn_rx_timestamp_register(&timestamp_dynfield_offset, &timestamp_rx_dynflag) != 0) {
           PMD_NTACC_LOG(ERR, "Error to register timestamp field/flag");
           return -rte_errno;
@@ -1196,6 +2011,13 @@ static int eth_dev_info(struct rte_eth_dev *dev, struct rte_eth_dev_info *dev_in
                               DEV_RX_OFFLOAD_TIMESTAMP   |
                               DEV_RX_OFFLOAD_KEEP_CRC    |
                               DEV_RX_OFFLOAD_SCATTER;
+#ifndef USE_EXTERNAL_BUFFER
+  // A jumbo frame can be split between a pool for the start of the
+  // packet and a pool for the rest
+  dev_info->rx_offload_capa |= RTE_ETH_RX_OFFLOAD_BUFFER_SPLIT;
+  dev_info->rx_seg_capa.max_nseg = 2;
+  dev_info->rx_seg_capa.multi_pools = 1;
+#endif
 
   dev_info->rx_queue_offload_capa = dev_info->rx_offload_capa;
 
@@ -1217,6 +2039,9 @@ static int eth_dev_info(struct rte_eth_dev *dev, struct rte_eth_dev_info *dev_in
   dev_info->hash_key_size = 0;
 
   dev_info->tx_offload_capa = DEV_TX_OFFLOAD_MULTI_SEGS;
+  if (!internals->mode2Tx && internals->tsMultiplier != 0) {
+    dev_info->tx_offload_capa |= DEV_TX_OFFLOAD_SEND_ON_TIMESTAMP;
+  }
   dev_info->tx_queue_offload_capa = DEV_TX_OFFLOAD_MULTI_SEGS;
 
   pInfo = (NtInfo_t *)rte_malloc(internals->name, sizeof(NtInfo_t), 0);
@@ -1277,11 +2102,14 @@ static int eth_stats_get(struct rte_eth_dev *dev,
   uint64_t tx_total_bytes = 0;
   const struct pmd_internals *internal = dev->data->dev_private;
 
+  struct rte_pmd_ntacc_queue_stats snapshot;
+
   memset(igb_stats, 0, sizeof(*igb_stats));
   for (i = 0; i < dev->data->nb_rx_queues; i++) {
     if (internal->rxq[i].enabled) {
-      uint64_t pkts = internal->rxq[i].rx_pkts;
-      uint64_t bytes = internal->rxq[i].rx_bytes;
+      rte_pmd_ntacc_queue_stats_read(internal->rxq[i].stats, &snapshot);
+      uint64_t pkts = snapshot.pkts - internal->rxq[i].basePkts;
+      uint64_t bytes = snapshot.bytes - internal->rxq[i].baseBytes;
       if (i < RTE_ETHDEV_QUEUE_STAT_CNTRS) {
         igb_stats->q_ipackets[i] = pkts;
         igb_stats->q_ibytes[i] = bytes;
@@ -1293,9 +2121,10 @@ static int eth_stats_get(struct rte_eth_dev *dev,
 
   for (i = 0; i < dev->data->nb_tx_queues; i++) {
     if (internal->txq[i].enabled) {
-      uint64_t pkts = internal->txq[i].tx_pkts;
-      uint64_t bytes = internal->txq[i].tx_bytes;
-      uint64_t err_pkts = internal->txq[i].err_pkts;
+      rte_pmd_ntacc_queue_stats_read(internal->txq[i].stats, &snapshot);
+      uint64_t pkts = snapshot.pkts - internal->txq[i].basePkts;
+      uint64_t bytes = snapshot.bytes - internal->txq[i].baseBytes;
+      uint64_t err_pkts = snapshot.errors - internal->txq[i].baseErrors;
       if (i < RTE_ETHDEV_QUEUE_STAT_CNTRS) {
         igb_stats->q_opackets[i] = pkts;
         igb_stats->q_obytes[i] = bytes;
@@ -1315,37 +2144,125 @@ static int eth_stats_get(struct rte_eth_dev *dev,
   return 0;
 }
 #else
-static int eth_stats_get(struct rte_eth_dev *dev,
-                         struct rte_eth_stats *igb_stats)
+/**
+ * Read the statistics into the back buffer of the snapshot and publish it.
+ * Must be called with statlock held.
+ */
+static int _stat_snapshot_update(struct pmd_internals *internals, int clear)
 {
-  struct pmd_internals *internals = dev->data->dev_private;
-  uint queue;
   int status;
-  NtStatistics_t *pStatData;
-  uint8_t port;
+  uint16_t queue;
+  const uint32_t gen = internals->statGen + 1;
+  NtStatistics_t *pStatData = &internals->statSnapshot[gen & 1];
 
-  pStatData = (NtStatistics_t *)rte_malloc(internals->name, sizeof(NtStatistics_t), 0);
-  if (!pStatData) {
-    return _log_out_of_memory_errors(__func__);
+  if (internals->hStat == NULL) {
+    return -EIO;
   }
-
-  memset(igb_stats, 0, sizeof(*igb_stats));
-
-  /* port used */
-  port = (uint8_t)internals->txq[0].port;
-
-  /* Get stat data */
   pStatData->cmd = NT_STATISTICS_READ_CMD_QUERY_V2;
   pStatData->u.query_v2.poll=0;
-  pStatData->u.query_v2.clear=0;
-  NTACC_LOCK(&internals->statlock);
+  pStatData->u.query_v2.clear=clear;
   if ((status = (*_NT_StatRead)(internals->hStat, pStatData)) != 0) {
-    NTACC_UNLOCK(&internals->statlock);
     _log_nt_errors(status, "NT_StatRead failed", __func__);
-    rte_free(pStatData);
     return -EIO;
   }
+  __atomic_store_n(&internals->statGen, gen, __ATOMIC_RELEASE);
+
+  // Publish the RX queue counters to the statistics memzone
+  for (queue = 0; queue < internals->stats->nb_rx_queues; queue++) {
+    const uint32_t streamId = STREAMIDS_PER_PORT * internals->port + queue;
+    ntacc_stats_set(&internals->stats->rxq[queue],
+                    pStatData->u.query_v2.data.stream.streamid[streamId].forward.pkts,
+                    pStatData->u.query_v2.data.stream.streamid[streamId].forward.octets,
+                    pStatData->u.query_v2.data.stream.streamid[streamId].drop.pkts);
+  }
+  return 0;
+}
+
+/**
+ * Call reader with the latest statistics snapshot. The snapshot is double
+ * buffered and published with a generation count, so the reader never takes
+ * statlock. If a new snapshot is published while reading, the read is retried.
+ */
+static int _stat_snapshot_read(struct rte_eth_dev *dev,
+                               void (*reader)(struct rte_eth_dev *dev, const NtStatistics_t *pStatData, void *arg),
+                               void *arg)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  uint32_t gen;
+
+  if (internals->statSnapshot == NULL || internals->statGen == 0) {
+    return -EIO;
+  }
+  do {
+    gen = __atomic_load_n(&internals->statGen, __ATOMIC_ACQUIRE);
+    reader(dev, &internals->statSnapshot[gen & 1], arg);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while (gen != __atomic_load_n(&internals->statGen, __ATOMIC_RELAXED));
+  return 0;
+}
+
+#define NTACC_STAT_INTERVAL_MS 100
+
+static void *_stat_snapshot_thread(void *arg)
+{
+  struct pmd_internals *internals = arg;
+
+  while (__atomic_load_n(&internals->statThreadRun, __ATOMIC_RELAXED)) {
+    rte_delay_us_sleep(NTACC_STAT_INTERVAL_MS * 1000);
+    NTACC_LOCK(&internals->statlock);
+    _stat_snapshot_update(internals, 0);
+    NTACC_UNLOCK(&internals->statlock);
+  }
+  return NULL;
+}
+
+static int _stat_snapshot_start(struct pmd_internals *internals)
+{
+  char name[RTE_MAX_THREAD_NAME_LEN];
+  int ret;
+
+  if (internals->statSnapshot == NULL) {
+    internals->statSnapshot = rte_zmalloc(internals->name, 2 * sizeof(NtStatistics_t), RTE_CACHE_LINE_SIZE);
+    if (internals->statSnapshot == NULL) {
+      return -_log_out_of_memory_errors(__func__);
+    }
+  }
+
+  // Have a snapshot ready before the port is started
+  NTACC_LOCK(&internals->statlock);
+  ret = _stat_snapshot_update(internals, 0);
   NTACC_UNLOCK(&internals->statlock);
+  if (ret != 0) {
+    return ret;
+  }
+
+  snprintf(name, sizeof(name), "ntacc-stat-%u", internals->port);
+  internals->statThreadRun = 1;
+  if ((ret = rte_ctrl_thread_create(&internals->statThread, name, NULL, _stat_snapshot_thread, internals)) != 0) {
+    internals->statThreadRun = 0;
+    PMD_NTACC_LOG(ERR, "Failed to create statistics thread: %s\n", strerror(ret));
+    return -ret;
+  }
+  return 0;
+}
+
+static void _stat_snapshot_stop(struct pmd_internals *internals)
+{
+  if (internals->statThreadRun) {
+    __atomic_store_n(&internals->statThreadRun, 0, __ATOMIC_RELAXED);
+    pthread_join(internals->statThread, NULL);
+  }
+}
+
+static void _stats_reader(struct rte_eth_dev *dev, const NtStatistics_t *pStatData, void *arg)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  struct rte_eth_stats *igb_stats = arg;
+  uint queue;
+
+  /* port used */
+  const uint8_t port = (uint8_t)internals->txq[0].port;
+
   igb_stats->ipackets = pStatData->u.query_v2.data.port.aPorts[port].rx.RMON1.pkts;
   igb_stats->ibytes = pStatData->u.query_v2.data.port.aPorts[port].rx.RMON1.octets;
   igb_stats->opackets = pStatData->u.query_v2.data.port.aPorts[port].tx.RMON1.pkts;
@@ -1359,8 +2276,13 @@ static int eth_stats_get(struct rte_eth_dev *dev,
     igb_stats->q_ibytes[queue] =  pStatData->u.query_v2.data.stream.streamid[internals->rxq[queue].stream_id].forward.octets;
     igb_stats->q_errors[queue] = pStatData->u.query_v2.data.stream.streamid[internals->rxq[queue].stream_id].drop.pkts;
   }
-  rte_free(pStatData);
-  return 0;
+}
+
+static int eth_stats_get(struct rte_eth_dev *dev,
+                         struct rte_eth_stats *igb_stats)
+{
+  memset(igb_stats, 0, sizeof(*igb_stats));
+  return _stat_snapshot_read(dev, _stats_reader, igb_stats);
 }
 #endif
 
@@ -1369,15 +2291,19 @@ static int eth_stats_reset(struct rte_eth_dev *dev)
 {
   unsigned i;
   struct pmd_internals *internal = dev->data->dev_private;
+  struct rte_pmd_ntacc_queue_stats snapshot;
 
+  // The shared counters are only written by the queues. Keep the reset values here
   for (i = 0; i < dev->data->nb_rx_queues; i++) {
-    internal->rxq[i].rx_pkts = 0;
-    internal->rxq[i].rx_bytes = 0;
+    rte_pmd_ntacc_queue_stats_read(internal->rxq[i].stats, &snapshot);
+    internal->rxq[i].basePkts = snapshot.pkts;
+    internal->rxq[i].baseBytes = snapshot.bytes;
   }
   for (i = 0; i < dev->data->nb_tx_queues; i++) {
-    internal->txq[i].tx_pkts = 0;
-    internal->txq[i].tx_bytes = 0;
-    internal->txq[i].err_pkts = 0;
+    rte_pmd_ntacc_queue_stats_read(internal->txq[i].stats, &snapshot);
+    internal->txq[i].basePkts = snapshot.pkts;
+    internal->txq[i].baseBytes = snapshot.bytes;
+    internal->txq[i].baseErrors = snapshot.errors;
   }
   return 0;
 }
@@ -1385,26 +2311,241 @@ static int eth_stats_reset(struct rte_eth_dev *dev)
 static int eth_stats_reset(struct rte_eth_dev *dev)
 {
   struct pmd_internals *internals = dev->data->dev_private;
-  int status;
-  NtStatistics_t *pStatData;
+  struct rte_flow *flow;
+  int ret;
 
-  pStatData = (NtStatistics_t *)rte_malloc(internals->name, sizeof(NtStatistics_t), 0);
-  if (!pStatData) {
-    return _log_out_of_memory_errors(__func__);
+  if (internals->statSnapshot == NULL) {
+    return -EIO;
   }
-
-  pStatData->cmd = NT_STATISTICS_READ_CMD_QUERY_V2;
-  pStatData->u.query_v2.poll=0;
-  pStatData->u.query_v2.clear=1;
   NTACC_LOCK(&internals->statlock);
-  if ((status = (*_NT_StatRead)(internals->hStat, pStatData)) != 0) {
-    NTACC_UNLOCK(&internals->statlock);
-    rte_free(pStatData);
-    return _log_nt_errors(status, "NT_StatRead failed", __func__);
+  // Clear the counters and publish the cleared values at once
+  if ((ret = _stat_snapshot_update(internals, 1)) == 0) {
+    ret = _stat_snapshot_update(internals, 0);
+
+    // The flow counters are cleared as well
+    NTACC_LOCK(&internals->lock);
+    LIST_FOREACH(flow, &internals->flows, next) {
+      flow->hitsBase = 0;
+      flow->bytesBase = 0;
+    }
+    NTACC_UNLOCK(&internals->lock);
   }
   NTACC_UNLOCK(&internals->statlock);
-  rte_free(pStatData);
-  return 0;
+  return ret;
+}
+
+/* Offset of a counter in the port statistics of a NtStatistics_t */
+#define NTACC_PORT_STAT(field) \
+  offsetof(__typeof__(((NtStatistics_t *)0)->u.query_v2.data.port.aPorts[0]), field)
+
+static const struct {
+  char name[RTE_ETH_XSTATS_NAME_SIZE];
+  size_t offset;
+} ntacc_port_xstats[] = {
+  {"rx_rmon_drop_events", NTACC_PORT_STAT(rx.RMON1.dropEvents)},
+  {"rx_rmon_octets", NTACC_PORT_STAT(rx.RMON1.octets)},
+  {"rx_rmon_packets", NTACC_PORT_STAT(rx.RMON1.pkts)},
+  {"rx_rmon_broadcast_packets", NTACC_PORT_STAT(rx.RMON1.broadcastPkts)},
+  {"rx_rmon_multicast_packets", NTACC_PORT_STAT(rx.RMON1.multicastPkts)},
+  {"rx_rmon_crc_align_errors", NTACC_PORT_STAT(rx.RMON1.crcAlignErrors)},
+  {"rx_rmon_undersize_packets", NTACC_PORT_STAT(rx.RMON1.undersizePkts)},
+  {"rx_rmon_oversize_packets", NTACC_PORT_STAT(rx.RMON1.oversizePkts)},
+  {"rx_rmon_fragments", NTACC_PORT_STAT(rx.RMON1.fragments)},
+  {"rx_rmon_jabbers", NTACC_PORT_STAT(rx.RMON1.jabbers)},
+  {"rx_rmon_collisions", NTACC_PORT_STAT(rx.RMON1.collisions)},
+  {"rx_rmon_size_64_packets", NTACC_PORT_STAT(rx.RMON1.pkts64Octets)},
+  {"rx_rmon_size_65_to_127_packets", NTACC_PORT_STAT(rx.RMON1.pkts65to127Octets)},
+  {"rx_rmon_size_128_to_255_packets", NTACC_PORT_STAT(rx.RMON1.pkts128to255Octets)},
+  {"rx_rmon_size_256_to_511_packets", NTACC_PORT_STAT(rx.RMON1.pkts256to511Octets)},
+  {"rx_rmon_size_512_to_1023_packets", NTACC_PORT_STAT(rx.RMON1.pkts512to1023Octets)},
+  {"rx_rmon_size_1024_to_1518_packets", NTACC_PORT_STAT(rx.RMON1.pkts1024to1518Octets)},
+  {"rx_drop_mac_bandwidth_packets", NTACC_PORT_STAT(rx.extDrop.pktsMacBandwidth)},
+  {"rx_drop_overflow_packets", NTACC_PORT_STAT(rx.extDrop.pktsOverflow)},
+  {"rx_drop_overflow_octets", NTACC_PORT_STAT(rx.extDrop.octetsOverflow)},
+  {"rx_drop_dedup_packets", NTACC_PORT_STAT(rx.extDrop.pktsDedup)},
+  {"rx_drop_dedup_octets", NTACC_PORT_STAT(rx.extDrop.octetsDedup)},
+  {"rx_drop_no_filter_packets", NTACC_PORT_STAT(rx.extDrop.pktsNoFilter)},
+  {"rx_drop_no_filter_octets", NTACC_PORT_STAT(rx.extDrop.octetsNoFilter)},
+  {"rx_drop_filter_packets", NTACC_PORT_STAT(rx.extDrop.pktsFilterDrop)},
+  {"rx_drop_filter_octets", NTACC_PORT_STAT(rx.extDrop.octetsFilterDrop)},
+  {"tx_rmon_drop_events", NTACC_PORT_STAT(tx.RMON1.dropEvents)},
+  {"tx_rmon_octets", NTACC_PORT_STAT(tx.RMON1.octets)},
+  {"tx_rmon_packets", NTACC_PORT_STAT(tx.RMON1.pkts)},
+  {"tx_rmon_broadcast_packets", NTACC_PORT_STAT(tx.RMON1.broadcastPkts)},
+  {"tx_rmon_multicast_packets", NTACC_PORT_STAT(tx.RMON1.multicastPkts)},
+  {"tx_rmon_crc_align_errors", NTACC_PORT_STAT(tx.RMON1.crcAlignErrors)},
+  {"tx_rmon_undersize_packets", NTACC_PORT_STAT(tx.RMON1.undersizePkts)},
+  {"tx_rmon_oversize_packets", NTACC_PORT_STAT(tx.RMON1.oversizePkts)},
+  {"tx_rmon_fragments", NTACC_PORT_STAT(tx.RMON1.fragments)},
+  {"tx_rmon_jabbers", NTACC_PORT_STAT(tx.RMON1.jabbers)},
+  {"tx_rmon_collisions", NTACC_PORT_STAT(tx.RMON1.collisions)},
+  {"tx_rmon_size_64_packets", NTACC_PORT_STAT(tx.RMON1.pkts64Octets)},
+  {"tx_rmon_size_65_to_127_packets", NTACC_PORT_STAT(tx.RMON1.pkts65to127Octets)},
+  {"tx_rmon_size_128_to_255_packets", NTACC_PORT_STAT(tx.RMON1.pkts128to255Octets)},
+  {"tx_rmon_size_256_to_511_packets", NTACC_PORT_STAT(tx.RMON1.pkts256to511Octets)},
+  {"tx_rmon_size_512_to_1023_packets", NTACC_PORT_STAT(tx.RMON1.pkts512to1023Octets)},
+  {"tx_rmon_size_1024_to_1518_packets", NTACC_PORT_STAT(tx.RMON1.pkts1024to1518Octets)},
+};
+
+#define NTACC_NB_PORT_XSTATS RTE_DIM(ntacc_port_xstats)
+/* forward, drop and flush packets and octets for each stream */
+#define NTACC_NB_STREAM_XSTATS 6
+/* packets and octets for each color */
+#define NTACC_NB_COLOR_XSTATS (2 * NTACC_NB_COLORS)
+
+static unsigned int _xstats_count(struct rte_eth_dev *dev)
+{
+  return NTACC_NB_PORT_XSTATS + NTACC_NB_STREAM_XSTATS * dev->data->nb_rx_queues + NTACC_NB_COLOR_XSTATS;
+}
+
+/**
+ * Get the value of xstat id from a statistics snapshot. The ids are the port
+ * counters, then the stream counters of each RX queue, then the color counters.
+ */
+static uint64_t _xstats_value(struct rte_eth_dev *dev, const NtStatistics_t *pStatData, unsigned int id)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+
+  if (id < NTACC_NB_PORT_XSTATS) {
+    const uint8_t port = (uint8_t)internals->txq[0].port;
+    return *(const uint64_t *)((const uint8_t *)&pStatData->u.query_v2.data.port.aPorts[port] +
+                               ntacc_port_xstats[id].offset);
+  }
+  id -= NTACC_NB_PORT_XSTATS;
+  if (id < NTACC_NB_STREAM_XSTATS * dev->data->nb_rx_queues) {
+    const uint32_t stream_id = internals->rxq[id / NTACC_NB_STREAM_XSTATS].stream_id;
+    switch (id % NTACC_NB_STREAM_XSTATS) {
+    case 0: return pStatData->u.query_v2.data.stream.streamid[stream_id].forward.pkts;
+    case 1: return pStatData->u.query_v2.data.stream.streamid[stream_id].forward.octets;
+    case 2: return pStatData->u.query_v2.data.stream.streamid[stream_id].drop.pkts;
+    case 3: return pStatData->u.query_v2.data.stream.streamid[stream_id].drop.octets;
+    case 4: return pStatData->u.query_v2.data.stream.streamid[stream_id].flush.pkts;
+    default: return pStatData->u.query_v2.data.stream.streamid[stream_id].flush.octets;
+    }
+  }
+  id -= NTACC_NB_STREAM_XSTATS * dev->data->nb_rx_queues;
+  if (id & 1) {
+    return pStatData->u.query_v2.data.adapter.aAdapters[internals->adapterNo].color.aColor[id / 2].octets;
+  }
+  return pStatData->u.query_v2.data.adapter.aAdapters[internals->adapterNo].color.aColor[id / 2].pkts;
+}
+
+static void _xstats_name(struct rte_eth_dev *dev, unsigned int id, struct rte_eth_xstat_name *xstat_name)
+{
+  static const char *stream_names[NTACC_NB_STREAM_XSTATS] = {
+    "forward_packets", "forward_octets", "drop_packets", "drop_octets", "flush_packets", "flush_octets"
+  };
+
+  if (id < NTACC_NB_PORT_XSTATS) {
+    strlcpy(xstat_name->name, ntacc_port_xstats[id].name, sizeof(xstat_name->name));
+    return;
+  }
+  id -= NTACC_NB_PORT_XSTATS;
+  if (id < NTACC_NB_STREAM_XSTATS * dev->data->nb_rx_queues) {
+    snprintf(xstat_name->name, sizeof(xstat_name->name), "rx_q%u_stream_%s",
+             id / NTACC_NB_STREAM_XSTATS, stream_names[id % NTACC_NB_STREAM_XSTATS]);
+    return;
+  }
+  id -= NTACC_NB_STREAM_XSTATS * dev->data->nb_rx_queues;
+  snprintf(xstat_name->name, sizeof(xstat_name->name), "color_%u_%s", id / 2, (id & 1) ? "octets" : "packets");
+}
+
+struct xstats_read_s {
+  const uint64_t *ids;
+  uint64_t *values;
+  struct rte_eth_xstat *xstats;
+  unsigned int n;
+};
+
+static void _xstats_reader(struct rte_eth_dev *dev, const NtStatistics_t *pStatData, void *arg)
+{
+  struct xstats_read_s *pRead = arg;
+  unsigned int i;
+
+  for (i = 0; i < pRead->n; i++) {
+    if (pRead->xstats) {
+      pRead->xstats[i].id = i;
+      pRead->xstats[i].value = _xstats_value(dev, pStatData, i);
+    }
+    else {
+      pRead->values[i] = _xstats_value(dev, pStatData, pRead->ids ? (unsigned int)pRead->ids[i] : i);
+    }
+  }
+}
+
+static int eth_xstats_get(struct rte_eth_dev *dev, struct rte_eth_xstat *xstats, unsigned int n)
+{
+  const unsigned int count = _xstats_count(dev);
+  struct xstats_read_s read = { .xstats = xstats, .n = count };
+  int ret;
+
+  if (xstats == NULL || n < count) {
+    return count;
+  }
+  if ((ret = _stat_snapshot_read(dev, _xstats_reader, &read)) != 0) {
+    return ret;
+  }
+  return count;
+}
+
+static int eth_xstats_get_by_id(struct rte_eth_dev *dev, const uint64_t *ids, uint64_t *values, unsigned int n)
+{
+  const unsigned int count = _xstats_count(dev);
+  struct xstats_read_s read = { .ids = ids, .values = values, .n = n };
+  unsigned int i;
+  int ret;
+
+  if (ids == NULL) {
+    if (values == NULL || n < count) {
+      return count;
+    }
+    read.n = count;
+  }
+  else {
+    for (i = 0; i < n; i++) {
+      if (ids[i] >= count) {
+        PMD_NTACC_LOG(ERR, "Invalid xstat id %"PRIu64"\n", ids[i]);
+        return -EINVAL;
+      }
+    }
+  }
+  if ((ret = _stat_snapshot_read(dev, _xstats_reader, &read)) != 0) {
+    return ret;
+  }
+  return read.n;
+}
+
+static int eth_xstats_get_names(struct rte_eth_dev *dev, struct rte_eth_xstat_name *xstats_names, unsigned int size)
+{
+  const unsigned int count = _xstats_count(dev);
+  unsigned int i;
+
+  if (xstats_names == NULL || size < count) {
+    return count;
+  }
+  for (i = 0; i < count; i++) {
+    _xstats_name(dev, i, &xstats_names[i]);
+  }
+  return count;
+}
+
+static int eth_xstats_get_names_by_id(struct rte_eth_dev *dev, struct rte_eth_xstat_name *xstats_names,
+                                      const uint64_t *ids, unsigned int size)
+{
+  const unsigned int count = _xstats_count(dev);
+  unsigned int i;
+
+  if (ids == NULL) {
+    return eth_xstats_get_names(dev, xstats_names, size);
+  }
+  for (i = 0; i < size; i++) {
+    if (ids[i] >= count) {
+      PMD_NTACC_LOG(ERR, "Invalid xstat id %"PRIu64"\n", ids[i]);
+      return -EINVAL;
+    }
+    _xstats_name(dev, ids[i], &xstats_names[i]);
+  }
+  return size;
 }
 #endif
 
@@ -1412,24 +2553,42 @@ static int eth_dev_close(struct rte_eth_dev *dev)
 {
   struct pmd_internals *internals = dev->data->dev_private;
   PMD_NTACC_LOG(DEBUG, "Closing port %u (%u) on adapter %u\n", internals->port, deviceCount, internals->adapterNo);
+  _flow_queue_free(internals);
+  _shunt_free(internals);
+  _flow_template_free(internals);
+
   if (internals->ntpl_file) {
     rte_free(internals->ntpl_file);
   }
 
   if (internals->rxq) {
-    rte_free(internals->rxq);
-    internals->rxq = NULL;
+    eth_rx_queues_free(internals);
   }
+  eth_ntacc_rx_numa_pools_free(internals);
 
   if (internals->txq) {
     rte_free(internals->txq);
     internals->txq = NULL;
   }
 
+#ifndef USE_SW_STAT
+  _stat_snapshot_stop(internals);
+  if (internals->statSnapshot) {
+    rte_free(internals->statSnapshot);
+    internals->statSnapshot = NULL;
+  }
+#endif
+
   if (dev->data->port_id < RTE_MAX_ETHPORTS) {
     _PmdInternals[dev->data->port_id].pInternals = NULL;
   }
 
+  if (internals->statsMz) {
+    rte_memzone_free(internals->statsMz);
+    internals->statsMz = NULL;
+    internals->stats = NULL;
+  }
+
   rte_free(dev->data->dev_private);
   dev->data->dev_private = NULL;
   dev->data->mac_addrs = NULL;
@@ -1448,6 +2607,102 @@ static void eth_queue_release(void *q __rte_unused)
 {
 }
 
+static void eth_rx_queue_info(struct rte_eth_dev *dev,
+                              uint16_t rx_queue_id,
+                              struct rte_eth_rxq_info *qinfo)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  struct ntacc_rx_queue *rx_q = &internals->rxq[rx_queue_id];
+
+  // The pool may be a copy on the adapter NUMA node. See numapool
+  qinfo->mp = rx_q->mb_pool;
+  qinfo->scattered_rx = 1;
+  qinfo->rx_buf_size = rx_q->buf_size;
+  qinfo->conf.offloads = dev->data->dev_conf.rxmode.offloads;
+}
+
+/**
+ * Add the compile-time options of the datapath to a burst mode description.
+ */
+static void eth_burst_mode_options(struct rte_eth_burst_mode *mode)
+{
+  size_t len = strlen(mode->info);
+
+  RTE_SET_USED(len);
+#ifdef USE_EXTERNAL_BUFFER
+  len += snprintf(&mode->info[len], sizeof(mode->info) - len, ", external buffers");
+#endif
+#ifdef USE_SW_STAT
+  len += snprintf(&mode->info[len], sizeof(mode->info) - len, ", SW statistics");
+#endif
+#ifdef COPY_OFFSET0
+  len += snprintf(&mode->info[len], sizeof(mode->info) - len, ", Offset0=%s", STRINGIZE_VALUE_OF(COPY_OFFSET0));
+#endif
+}
+
+static int eth_rx_burst_mode_get(struct rte_eth_dev *dev,
+                                 uint16_t rx_queue_id,
+                                 struct rte_eth_burst_mode *mode)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  struct ntacc_rx_queue *rx_q = &internals->rxq[rx_queue_id];
+  const eth_rx_burst_t burst = internals->rxBurst;
+  const char *name;
+
+  if (burst == eth_ntacc_rx_mode2)
+    name = "Segment";
+  else if (burst == eth_ntacc_rx_mode1)
+    name = "Ring scalar";
+#if !defined(USE_EXTERNAL_BUFFER) && defined(RTE_ARCH_X86)
+  else if (burst == eth_ntacc_rx_mode1_sse)
+    name = "Ring SSE";
+#ifdef CC_AVX2_SUPPORT
+  else if (burst == eth_ntacc_rx_mode1_avx2)
+    name = "Ring AVX2";
+#endif
+#ifdef CC_AVX512_SUPPORT
+  else if (burst == eth_ntacc_rx_mode1_avx512)
+    name = "Ring AVX512";
+#endif
+#endif
+  else
+    return -EINVAL;
+
+  if (rx_q->merge != NULL) {
+    // The merged queues are read segment by segment in timestamp order
+    mode->flags = RTE_ETH_BURST_FLAG_PER_QUEUE;
+    snprintf(mode->info, sizeof(mode->info), "Merge of %u streams", rx_q->merge->nb_streams);
+  }
+  else {
+    snprintf(mode->info, sizeof(mode->info), "%s", name);
+  }
+  eth_burst_mode_options(mode);
+  return 0;
+}
+
+static int eth_tx_burst_mode_get(struct rte_eth_dev *dev,
+                                 uint16_t tx_queue_id __rte_unused,
+                                 struct rte_eth_burst_mode *mode)
+{
+  const eth_tx_burst_t burst = dev->tx_pkt_burst;
+  const char *name;
+
+  if (burst == eth_ntacc_tx_mode2)
+    name = "Segment";
+  else if (burst == eth_ntacc_tx_mode1)
+    name = "Ring";
+  else if (burst == eth_ntacc_tx_mode1_timed)
+    name = "Ring send on timestamp";
+  else if (burst == eth_ntacc_tx_mode1_stream)
+    name = "Ring non-temporal";
+  else
+    return -EINVAL;
+
+  snprintf(mode->info, sizeof(mode->info), "%s", name);
+  eth_burst_mode_options(mode);
+  return 0;
+}
+
 static int eth_link_update(struct rte_eth_dev *dev,
                            int wait_to_complete  __rte_unused)
 {
@@ -1510,25 +2765,145 @@ static int eth_link_update(struct rte_eth_dev *dev,
   return 0;
 }
 
+/**
+ * Check that the mempool of an RX queue is on the NUMA node of the adapter.
+ * With the numapool argument, a copy of the pool is created on the adapter
+ * node. Queues given the same pool share the copy, and the copies are kept
+ * until the port is closed, or longer if the application still holds their
+ * mbufs then.
+ * Otherwise a warning is logged. Returns the pool to use.
+ */
+static struct rte_mempool *eth_ntacc_rx_numa_pool(struct rte_eth_dev *dev,
+                                                  uint16_t rx_queue_id,
+                                                  struct rte_mempool *mp)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  char name[RTE_MEMPOOL_NAMESIZE];
+  struct rte_mempool *pool;
+  uint16_t i;
+
+  if (internals->numaNode < 0 || mp->socket_id == SOCKET_ID_ANY || mp->socket_id == internals->numaNode) {
+    return mp;
+  }
+  if (!internals->numaPool) {
+    PMD_NTACC_LOG(WARNING, "Port %u RX queue %u: Mempool %s is on NUMA node %d, but the adapter is on node %d\n",
+                  dev->data->port_id, rx_queue_id, mp->name, mp->socket_id, internals->numaNode);
+    return mp;
+  }
+
+  for (i = 0; i < internals->nbNumaPools; i++) {
+    pool = internals->numaPools[i].pool;
+    if (internals->numaPools[i].src == mp &&
+        rte_pktmbuf_data_room_size(pool) == rte_pktmbuf_data_room_size(mp) &&
+        rte_pktmbuf_priv_size(pool) == rte_pktmbuf_priv_size(mp)) {
+      PMD_NTACC_LOG(INFO, "Port %u RX queue %u: Using mempool %s on NUMA node %d instead of %s\n",
+                    dev->data->port_id, rx_queue_id, pool->name, internals->numaNode, mp->name);
+      return pool;
+    }
+  }
+  if (internals->nbNumaPools == NTACC_MAX_NUMA_POOLS) {
+    PMD_NTACC_LOG(WARNING, "Port %u RX queue %u: Too many mempools created on NUMA node %d. Using %s\n",
+                  dev->data->port_id, rx_queue_id, internals->numaNode, mp->name);
+    return mp;
+  }
+
+  // Pools of a closed port may still be in use, so names are never reused
+  rte_spinlock_lock(&_numaPools.lock);
+  eth_ntacc_rx_numa_pools_reap();
+  snprintf(name, sizeof(name), "ntacc_rx_%u_%u", dev->data->port_id, _numaPools.seq++);
+  rte_spinlock_unlock(&_numaPools.lock);
+  pool = rte_pktmbuf_pool_create(name, mp->size, mp->cache_size, rte_pktmbuf_priv_size(mp),
+                                 rte_pktmbuf_data_room_size(mp), internals->numaNode);
+  if (pool == NULL) {
+    PMD_NTACC_LOG(WARNING, "Port %u RX queue %u: Failed to create mempool %s on NUMA node %d (%s). Using %s\n",
+                  dev->data->port_id, rx_queue_id, name, internals->numaNode, rte_strerror(rte_errno), mp->name);
+    return mp;
+  }
+  internals->numaPools[internals->nbNumaPools].src = mp;
+  internals->numaPools[internals->nbNumaPools].pool = pool;
+  internals->nbNumaPools++;
+  PMD_NTACC_LOG(INFO, "Port %u RX queue %u: Using mempool %s on NUMA node %d instead of %s\n",
+                dev->data->port_id, rx_queue_id, name, internals->numaNode, mp->name);
+  return pool;
+}
+
 static int eth_rx_queue_setup(struct rte_eth_dev *dev,
                               uint16_t rx_queue_id,
                               uint16_t nb_rx_desc __rte_unused,
-                              unsigned int socket_id __rte_unused,
-                              const struct rte_eth_rxconf *rx_conf __rte_unused,
+                              unsigned int socket_id,
+                              const struct rte_eth_rxconf *rx_conf,
                               struct rte_mempool *mb_pool)
 {
-  struct rte_pktmbuf_pool_private *mbp_priv;
   struct pmd_internals *internals = dev->data->dev_private;
   struct ntacc_rx_queue *rx_q = &internals->rxq[rx_queue_id];
+  struct rte_mempool *pool;
+  uint16_t head_len = 0;
+  uint16_t seg_len = 0;
+
+  // Mbufs kept from an earlier setup may belong to another pool
+  eth_ntacc_rx_stash_free(rx_q);
+  rte_free(rx_q->merge);
+  rx_q->merge = NULL;
+  rx_q->rxBurst = internals->rxBurst;
 
   rx_q->mb_pool = mb_pool;
+  rx_q->seg_pool = mb_pool;
+  if ((rx_conf->offloads | dev->data->dev_conf.rxmode.offloads) & RTE_ETH_RX_OFFLOAD_BUFFER_SPLIT) {
+    // The start of the packet goes to the first pool and the rest to the last pool.
+    // The pools and lengths are already validated by ethdev.
+    const struct rte_eth_rxseg_split *first = &rx_conf->rx_seg[0].split;
+    const struct rte_eth_rxseg_split *last = &rx_conf->rx_seg[rx_conf->rx_nseg - 1].split;
+    rx_q->mb_pool = first->mp;
+    rx_q->seg_pool = last->mp;
+    head_len = first->length;
+    seg_len = rx_conf->rx_nseg > 1 ? last->length : 0;
+  }
+  pool = eth_ntacc_rx_numa_pool(dev, rx_queue_id, rx_q->mb_pool);
+  if (pool != rx_q->mb_pool) {
+    if (rx_q->seg_pool == rx_q->mb_pool)
+      rx_q->seg_pool = pool;
+    rx_q->mb_pool = pool;
+  }
   dev->data->rx_queues[rx_queue_id] = rx_q;
   rx_q->in_port = dev->data->port_id;
   rx_q->local_port = internals->local_port;
   rx_q->tsMultiplier = internals->tsMultiplier;
-
-  mbp_priv =  rte_mempool_get_priv(rx_q->mb_pool);
-  rx_q->buf_size = (uint16_t) (mbp_priv->mbuf_data_room_size - RTE_PKTMBUF_HEADROOM);
+  rx_q->mode2Rx = internals->mode2Rx;
+
+  /* Rearm template for the vector RX paths */
+  struct rte_mbuf mb_def = { .buf_addr = 0 };
+  mb_def.nb_segs = 1;
+  mb_def.data_off = RTE_PKTMBUF_HEADROOM;
+  mb_def.port = rx_q->in_port;
+  rte_mbuf_refcnt_set(&mb_def, 1);
+  rte_compiler_barrier();
+  rx_q->mbuf_initializer = *(uint64_t *)&mb_def.rearm_data;
+  rx_q->wbThreshold = internals->rxWriteback;
+
+  rx_q->buf_size = (uint16_t) (rte_pktmbuf_data_room_size(rx_q->mb_pool) - RTE_PKTMBUF_HEADROOM);
+  if (head_len != 0 && head_len < rx_q->buf_size) {
+    rx_q->buf_size = head_len;
+  }
+  rx_q->seg_size = (uint16_t) (rte_pktmbuf_data_room_size(rx_q->seg_pool) - RTE_PKTMBUF_HEADROOM);
+  if (seg_len != 0 && seg_len < rx_q->seg_size) {
+    rx_q->seg_size = seg_len;
+  }
+  // All segments of the largest packet must fit in the segment stash
+  if (rx_q->buf_size < HW_MAX_PKT_LEN &&
+      (HW_MAX_PKT_LEN - rx_q->buf_size + rx_q->seg_size - 1) / rx_q->seg_size > NTACC_RX_SEG_STASH) {
+    PMD_NTACC_LOG(ERR, "Port %u RX queue %u: Segment size %u is too small. At most %u segments are supported\n",
+                  dev->data->port_id, rx_queue_id, rx_q->seg_size, NTACC_RX_SEG_STASH + 1);
+    rx_q->enabled = 0;
+    return -EINVAL;
+  }
+#ifdef USE_EXTERNAL_BUFFER
+  rx_q->copyBreak = RTE_MIN(internals->copyBreak, rx_q->buf_size);
+  if (eth_ntacc_rx_release_setup(rx_q, socket_id) != 0) {
+    return -ENOMEM;
+  }
+#else
+  RTE_SET_USED(socket_id);
+#endif
   rx_q->enabled = 1;
   return 0;
 }
@@ -1538,9 +2913,16 @@ static int eth_rx_queue_start(struct rte_eth_dev *dev, uint16_t rx_queue_id)
   struct pmd_internals *internals = dev->data->dev_private;
   char ntpl_buf[50];
 
+  struct ntacc_rx_merge_s *merge = internals->rxq[rx_queue_id].merge;
+  uint16_t i;
+
   snprintf(ntpl_buf, sizeof(ntpl_buf), "Setup[State=Active] = StreamId == %d", internals->rxq[rx_queue_id].stream_id);
   NTACC_LOCK(&internals->configlock);
   DoNtpl(ntpl_buf, NULL, internals, NULL);
+  for (i = 1; merge && i < merge->nb_streams; i++) {
+    snprintf(ntpl_buf, sizeof(ntpl_buf), "Setup[State=Active] = StreamId == %u", merge->stream[i].stream_id);
+    DoNtpl(ntpl_buf, NULL, internals, NULL);
+  }
   NTACC_UNLOCK(&internals->configlock);
   dev->data->rx_queue_state[rx_queue_id] = RTE_ETH_QUEUE_STATE_STARTED;
   return 0;
@@ -1551,9 +2933,16 @@ static int eth_rx_queue_stop(struct rte_eth_dev *dev, uint16_t rx_queue_id)
   struct pmd_internals *internals = dev->data->dev_private;
   char ntpl_buf[50];
 
+  struct ntacc_rx_merge_s *merge = internals->rxq[rx_queue_id].merge;
+  uint16_t i;
+
   snprintf(ntpl_buf, sizeof(ntpl_buf), "Setup[State=InActive] = StreamId == %d", internals->rxq[rx_queue_id].stream_id);
   NTACC_LOCK(&internals->configlock);
   DoNtpl(ntpl_buf, NULL, internals, NULL);
+  for (i = 1; merge && i < merge->nb_streams; i++) {
+    snprintf(ntpl_buf, sizeof(ntpl_buf), "Setup[State=InActive] = StreamId == %u", merge->stream[i].stream_id);
+    DoNtpl(ntpl_buf, NULL, internals, NULL);
+  }
   NTACC_UNLOCK(&internals->configlock);
   dev->data->rx_queue_state[rx_queue_id] = RTE_ETH_QUEUE_STATE_STOPPED;
   return 0;
@@ -1590,6 +2979,222 @@ static int _dev_set_flow_ctrl(struct rte_eth_dev *dev __rte_unused, struct rte_e
   return 0;
 }
 
+#ifndef USE_SW_STAT
+/**
+ * Color counters used by the COUNT action. The color counters are shared by
+ * all ports on an adapter, so the use of them is counted per adapter.
+ */
+static struct {
+  rte_spinlock_t lock;
+  uint16_t refcnt[MAX_NTACC_ADAPTERS][NTACC_NB_COLORS];   // Flows counted by the color
+  uint16_t marks[MAX_NTACC_ADAPTERS][NTACC_NB_COLORS];    // Flows without COUNT marked with the color
+  uint8_t  autoUsed[MAX_NTACC_ADAPTERS][NTACC_NB_COLORS]; // The color was picked for a counter by the PMD
+} _colorCounters = { .lock = RTE_SPINLOCK_INITIALIZER };
+
+static void _flow_count_base_reader(struct rte_eth_dev *dev, const NtStatistics_t *pStatData, void *arg)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  struct rte_flow *flow = arg;
+  const struct NtColorStatistics_s *pCounter =
+    &pStatData->u.query_v2.data.adapter.aAdapters[internals->adapterNo].color.aColor[flow->counter];
+
+  flow->hitsBase = pCounter->pkts;
+  flow->bytesBase = pCounter->octets;
+}
+
+/**
+ * Select the color counter of a flow with a COUNT action. The flow is counted
+ * by its MARK id, by the id of a shared counter or else by a free color.
+ * A free color is neither counted nor used as MARK id by other flows, and it
+ * cannot be used as MARK id or shared counter id while the flow exists.
+ * The color is returned in pColor. Must be called with configlock held.
+ */
+static int _flow_counter_alloc(struct rte_eth_dev *dev,
+                               struct rte_flow *flow,
+                               const struct rte_flow_action_count *conf,
+                               struct color_s *pColor,
+                               struct rte_flow_error *error)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  uint16_t *refcnt;
+  uint16_t *marks;
+  uint8_t *autoUsed;
+  uint32_t counter = UINT32_MAX;
+  int i;
+
+  if (internals->adapterNo >= MAX_NTACC_ADAPTERS) {
+    rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ACTION, NULL, "COUNT is not supported on this adapter");
+    return 1;
+  }
+  if (pColor->type == COLOR_MASK) {
+    rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ACTION, NULL, "COUNT cannot be defined when FLAG has been defined");
+    return 1;
+  }
+  if (conf && conf->shared) {
+    counter = conf->id;
+  }
+  if (pColor->type == ONE_COLOR) {
+    if (counter != UINT32_MAX && counter != pColor->color) {
+      rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ACTION, NULL, "A shared COUNT id must be equal to the MARK id");
+      return 1;
+    }
+    counter = pColor->color;
+  }
+  if (counter != UINT32_MAX && counter >= NTACC_NB_COLORS) {
+    rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ACTION, NULL, "COUNT id or MARK id out of range of the flow counters");
+    return 1;
+  }
+
+  refcnt = _colorCounters.refcnt[internals->adapterNo];
+  marks = _colorCounters.marks[internals->adapterNo];
+  autoUsed = _colorCounters.autoUsed[internals->adapterNo];
+  rte_spinlock_lock(&_colorCounters.lock);
+  if (counter == UINT32_MAX) {
+    // Use the highest free color. The low colors are more likely to be used as MARK ids
+    for (i = NTACC_NB_COLORS - 1; i >= 0; i--) {
+      if (refcnt[i] == 0 && marks[i] == 0) {
+        counter = i;
+        break;
+      }
+    }
+    if (counter == UINT32_MAX) {
+      rte_spinlock_unlock(&_colorCounters.lock);
+      rte_flow_error_set(error, ENOSPC, RTE_FLOW_ERROR_TYPE_ACTION, NULL, "No free flow counters");
+      return 1;
+    }
+    autoUsed[counter] = 1;
+  }
+  else if (autoUsed[counter]) {
+    rte_spinlock_unlock(&_colorCounters.lock);
+    rte_flow_error_set(error, EBUSY, RTE_FLOW_ERROR_TYPE_ACTION, NULL, "COUNT id or MARK id is used by another flow counter");
+    return 1;
+  }
+  refcnt[counter]++;
+  rte_spinlock_unlock(&_colorCounters.lock);
+
+  flow->count = 1;
+  flow->counter = (uint8_t)counter;
+  pColor->color = counter;
+  pColor->type = ONE_COLOR;
+
+  // Count from the value of the counter in the latest statistics snapshot.
+  // Without a snapshot, the base is taken when the flow is first queried.
+  if (_stat_snapshot_read(dev, _flow_count_base_reader, flow) != 0) {
+    flow->countPending = 1;
+  }
+  return 0;
+}
+
+/**
+ * Hold the color of the MARK id of a flow without COUNT, so the color is not
+ * picked for a flow counter. Must be called with configlock held.
+ */
+static int _flow_mark_get(struct pmd_internals *internals,
+                          struct rte_flow *flow,
+                          const struct color_s *pColor,
+                          struct rte_flow_error *error)
+{
+  if (pColor->type != ONE_COLOR || pColor->color >= NTACC_NB_COLORS ||
+      internals->adapterNo >= MAX_NTACC_ADAPTERS) {
+    return 0;
+  }
+  rte_spinlock_lock(&_colorCounters.lock);
+  if (_colorCounters.autoUsed[internals->adapterNo][pColor->color]) {
+    rte_spinlock_unlock(&_colorCounters.lock);
+    rte_flow_error_set(error, EBUSY, RTE_FLOW_ERROR_TYPE_ACTION, NULL, "MARK id is used by a flow counter");
+    return 1;
+  }
+  _colorCounters.marks[internals->adapterNo][pColor->color]++;
+  rte_spinlock_unlock(&_colorCounters.lock);
+  flow->mark = 1;
+  flow->counter = (uint8_t)pColor->color;
+  return 0;
+}
+
+static void _flow_counter_free(struct pmd_internals *internals, struct rte_flow *flow)
+{
+  if (flow->count || flow->mark) {
+    rte_spinlock_lock(&_colorCounters.lock);
+    if (flow->count && --_colorCounters.refcnt[internals->adapterNo][flow->counter] == 0) {
+      _colorCounters.autoUsed[internals->adapterNo][flow->counter] = 0;
+    }
+    if (flow->mark) {
+      _colorCounters.marks[internals->adapterNo][flow->counter]--;
+    }
+    rte_spinlock_unlock(&_colorCounters.lock);
+    flow->count = 0;
+    flow->mark = 0;
+  }
+}
+
+struct flow_count_read_s {
+  struct rte_flow **flows;
+  struct rte_flow_query_count *counts;
+  uint32_t nb_flows;
+};
+
+static void _flow_count_reader(struct rte_eth_dev *dev, const NtStatistics_t *pStatData, void *arg)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  struct flow_count_read_s *pRead = arg;
+  uint32_t i;
+
+  for (i = 0; i < pRead->nb_flows; i++) {
+    const struct NtColorStatistics_s *pCounter =
+      &pStatData->u.query_v2.data.adapter.aAdapters[internals->adapterNo].color.aColor[pRead->flows[i]->counter];
+    pRead->counts[i].hits = pCounter->pkts;
+    pRead->counts[i].bytes = pCounter->octets;
+  }
+}
+
+/**
+ * Read the counters of a number of flows from the same statistics snapshot.
+ * No statistics are read from the adapter, so reading the counters of many
+ * flows costs the same as reading the port statistics.
+ */
+static int _flow_count_query(struct rte_eth_dev *dev,
+                             struct rte_flow **flows,
+                             struct rte_flow_query_count *counts,
+                             uint32_t nb_flows,
+                             struct rte_flow_error *error)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  struct flow_count_read_s read = { .flows = flows, .counts = counts, .nb_flows = nb_flows };
+  uint32_t i;
+
+  for (i = 0; i < nb_flows; i++) {
+    if (!flows[i]->count) {
+      return rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_HANDLE, flows[i], "Flow has no COUNT action");
+    }
+  }
+  if (_stat_snapshot_read(dev, _flow_count_reader, &read) != 0) {
+    return rte_flow_error_set(error, EIO, RTE_FLOW_ERROR_TYPE_UNSPECIFIED, NULL, "Statistics are not available");
+  }
+
+  NTACC_LOCK(&internals->lock);
+  for (i = 0; i < nb_flows; i++) {
+    const uint64_t hits = counts[i].hits;
+    const uint64_t bytes = counts[i].bytes;
+    if (flows[i]->countPending) {
+      // No snapshot when the flow was created. Count from now
+      flows[i]->hitsBase = hits;
+      flows[i]->bytesBase = bytes;
+      flows[i]->countPending = 0;
+    }
+    counts[i].hits = hits - flows[i]->hitsBase;
+    counts[i].bytes = bytes - flows[i]->bytesBase;
+    counts[i].hits_set = 1;
+    counts[i].bytes_set = 1;
+    if (counts[i].reset) {
+      flows[i]->hitsBase = hits;
+      flows[i]->bytesBase = bytes;
+    }
+  }
+  NTACC_UNLOCK(&internals->lock);
+  return 0;
+}
+#endif
+
 static const char *ActionErrorString(enum rte_flow_action_type type)
 {
   switch (type) {
@@ -1597,7 +3202,6 @@ static const char *ActionErrorString(enum rte_flow_action_type type)
   case RTE_FLOW_ACTION_TYPE_MARK:     return "Action MARK is not supported";
   case RTE_FLOW_ACTION_TYPE_FLAG:     return "Action FLAG is not supported";
   case RTE_FLOW_ACTION_TYPE_DROP:     return "Action DROP is not supported";
-  case RTE_FLOW_ACTION_TYPE_COUNT:    return "Action COUNT is not supported";
   case RTE_FLOW_ACTION_TYPE_PF:       return "Action PF is not supported";
   case RTE_FLOW_ACTION_TYPE_VF:       return "Action VF is not supported";
   default:                            return "Action is UNKNOWN";
@@ -1605,72 +3209,79 @@ static const char *ActionErrorString(enum rte_flow_action_type type)
 }
 
 /******************************************************
- Do only release the keyset if it is not in used anymore.
- This means that is it not referenced in any other flow.
- No lock in this code
+ Delete an assign command.
+ Must be called with configlock and lock held
  *******************************************************/
-static void _cleanUpKeySet(int key, struct pmd_internals *internals, struct rte_flow_error *error)
+static void _cleanUpAssignNtplId(uint32_t assignNtplID, struct pmd_internals *internals, struct rte_flow_error *error)
 {
-  struct rte_flow *pTmp;
-  LIST_FOREACH(pTmp, &internals->flows, next) {
-    if (pTmp->key == key) {
-      // Key set is still in use
-      return;
-    }
+  char ntpl_buf[21];
+  if (assignNtplID == 0) {
+    return;
   }
-  // Key set is not in use anymore. delete it.
-  PMD_NTACC_LOG(DEBUG, "Returning keyset %u: %d\n", internals->adapterNo, key);
-  DeleteKeyset(key, internals, error);
-  ReturnKeysetValue(internals, key);
+  PMD_NTACC_LOG(DEBUG, "Deleting assign filter: %u\n", assignNtplID);
+  snprintf(ntpl_buf, 20, "delete=%d", assignNtplID);
+  DoNtpl(ntpl_buf, NULL, internals, error);
 }
 
 /******************************************************
- Do only delete the assign command if it is not in used anymore.
- This means that is it not referenced in any other flow.
- No lock in this code
+ Release a reference to a keyset. The keyset and the
+ assign command shared by the flows using it are only
+ deleted when the last flow or template using them
+ is gone.
+ Must be called with configlock and lock held
  *******************************************************/
-static void _cleanUpAssignNtplId(uint32_t assignNtplID, struct pmd_internals *internals, struct rte_flow_error *error)
+static void _cleanUpKeySet(struct filter_keyset_s *key_set, struct pmd_internals *internals, struct rte_flow_error *error)
 {
-  char ntpl_buf[21];
-  struct rte_flow *pFlow;
-  LIST_FOREACH(pFlow, &internals->flows, next) {
-    if (pFlow->assign_ntpl_id == assignNtplID) {
-      // NTPL ID still in use
-      return;
-    }
+  int key;
+
+  if (--key_set->refcnt > 0) {
+    // Key set is still in use
+    return;
   }
-  // NTPL ID not in use
-  PMD_NTACC_LOG(DEBUG, "Deleting assign filter: %u\n", assignNtplID);
-  snprintf(ntpl_buf, 20, "delete=%d", assignNtplID);
-  NTACC_LOCK(&internals->configlock);
-  DoNtpl(ntpl_buf, NULL, internals, error);
-  NTACC_UNLOCK(&internals->configlock);
+  // Key set is not in use anymore. delete it.
+  _cleanUpAssignNtplId(key_set->assign_ntpl_id, internals, error);
+  key = key_set->key;
+  PMD_NTACC_LOG(DEBUG, "Returning keyset %u: %d\n", internals->adapterNo, key);
+  DeleteKeyset(key_set, internals, error);
+  ReturnKeysetValue(internals, key);
 }
 
 /******************************************************
  Delete a flow by deleting the NTPL command assigned
  with the flow. Check if some of the shared components
  like keyset and assign filter is still in use.
- No lock in this code
+ Must be called with configlock and lock held
  *******************************************************/
 static void _cleanUpFlow(struct rte_flow *flow, struct pmd_internals *internals, struct rte_flow_error *error)
 {
   char ntpl_buf[21];
   PMD_NTACC_LOG(DEBUG, "Remove flow %p\n", flow);
   LIST_REMOVE(flow, next);
+  if (flow->shunt) {
+    // Remove the flow from its shunt table
+    struct ntacc_shunt_entry_s *entry = &flow->shunt->entries[flow->shuntPos];
+    rte_hash_del_key(flow->shunt->hash, &entry->key);
+    entry->flow = NULL;
+  }
   while (!LIST_EMPTY(&flow->ntpl_id)) {
     struct filter_flow *id;
     id = LIST_FIRST(&flow->ntpl_id);
     snprintf(ntpl_buf, 20, "delete=%d", id->ntpl_id);
-    NTACC_LOCK(&internals->configlock);
     DoNtpl(ntpl_buf, NULL, internals, NULL);
-    NTACC_UNLOCK(&internals->configlock);
     PMD_NTACC_LOG(DEBUG, "Deleting Item filter: %s\n", ntpl_buf);
     LIST_REMOVE(id, next);
     rte_free(id);
   }
-  _cleanUpAssignNtplId(flow->assign_ntpl_id, internals, error);
-  _cleanUpKeySet(flow->key, internals, error);
+  if (flow->keyset) {
+    _cleanUpKeySet(flow->keyset, internals, error);
+    flow->keyset = NULL;
+  }
+  else {
+    _cleanUpAssignNtplId(flow->assign_ntpl_id, internals, error);
+  }
+#ifndef USE_SW_STAT
+  _flow_counter_free(internals, flow);
+#endif
   rte_free(flow);
 }
 
@@ -1712,6 +3323,8 @@ static inline int _handle_actions(struct rte_eth_dev *dev,
                                   uint64_t *pTypeMask,
                                   struct color_s *pColor,
                                   uint8_t *pAction,
+                                  const struct rte_flow_action_count **pCount,
+                                  struct capture_s *pCapture,
                                   uint8_t *pNb_queues,
                                   uint8_t *pList_queues,
                                   struct pmd_internals *internals,
@@ -1820,6 +3433,57 @@ static inline int _handle_actions(struct rte_eth_dev *dev,
       }
       *pTypeMask |= RETRANSMIT_FILTER;
       break;
+    case RTE_FLOW_ACTION_TYPE_COUNT:
+#ifdef USE_SW_STAT
+      RTE_SET_USED(pCount);
+      rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ACTION, NULL, "COUNT requires hardware-based statistics");
+      return 1;
+#else
+      // Count the packets by a color counter
+      if (*pAction & ACTION_COUNT) {
+        rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ACTION, NULL, "COUNT already defined");
+        return 1;
+      }
+      *pAction |= ACTION_COUNT;
+      *pCount = (const struct rte_flow_action_count *)actions->conf;
+      break;
+#endif
+    case RTE_FLOW_ACTION_TYPE_SAMPLE:
+    {
+      // Sampling is done by the assign command, so only the sampled packets are delivered.
+      // The fate of the sampled packets is given by the actions of the sample action.
+      const struct rte_flow_action_sample *sample = (const struct rte_flow_action_sample *)actions->conf;
+      if (pCapture->sample != 0) {
+        rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ACTION, NULL, "SAMPLE already defined");
+        return 1;
+      }
+      if (*pAction & (ACTION_RSS | ACTION_QUEUE | ACTION_DROP | ACTION_FORWARD)) {
+        rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ACTION, NULL, "Queue, RSS, drop or forward must be defined in the SAMPLE actions");
+        return 1;
+      }
+      if (sample == NULL || sample->ratio == 0 || sample->actions == NULL) {
+        rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_ACTION_CONF, actions, "SAMPLE needs a ratio of at least 1 and a list of actions");
+        return 1;
+      }
+      pCapture->sample = sample->ratio;
+      if (_handle_actions(dev, sample->actions, pRss, pForwardPort, pTypeMask, pColor, pAction, pCount,
+                          pCapture, pNb_queues, pList_queues, internals, error) != 0) {
+        return 1;
+      }
+      break;
+    }
+    case RTE_FLOW_ACTION_TYPE_SLICE:
+      // Deliver only the first bytes of the packets
+      if (pCapture->slice != 0) {
+        rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ACTION, NULL, "SLICE already defined");
+        return 1;
+      }
+      if (actions->conf == NULL || ((const struct rte_flow_action_slice *)actions->conf)->length == 0) {
+        rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_ACTION_CONF, actions, "SLICE length must not be 0");
+        return 1;
+      }
+      pCapture->slice = ((const struct rte_flow_action_slice *)actions->conf)->length;
+      break;
     }
   }
   return 0;
@@ -2085,11 +3749,61 @@ static inline int _handle_items(const struct rte_flow_item items[],
   return 0;
 }
 
-static struct rte_flow *_dev_flow_create(struct rte_eth_dev *dev,
-                                         const struct rte_flow_attr *attr,
-                                         const struct rte_flow_item items[],
-                                         const struct rte_flow_action actions[],
-                                         struct rte_flow_error *error)
+/**
+ * Record the shape of the pattern of a flow template. The flows inserted
+ * through the template must have the same item types and key fields.
+ */
+static int _flow_template_set_pattern(struct rte_pmd_ntacc_flow_template *tmpl,
+                                      const struct rte_flow_item items[],
+                                      uint64_t typeMask,
+                                      struct pmd_internals *internals,
+                                      struct rte_flow_error *error)
+{
+  if (internals->nbFilterValues == 0) {
+    rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_ITEM, NULL, "The pattern of a flow template must have values to match");
+    return 1;
+  }
+
+  tmpl->nb_items = 0;
+  for (; items->type != RTE_FLOW_ITEM_TYPE_END; ++items) {
+    if (items->type == RTE_FLOW_ITEM_TYPE_VOID) {
+      continue;
+    }
+    if (tmpl->nb_items == NTACC_MAX_TEMPLATE_ITEMS) {
+      rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ITEM, NULL, "Too many items in the pattern of a flow template");
+      return 1;
+    }
+    tmpl->items[tmpl->nb_items++] = items->type;
+  }
+  tmpl->typeMask = typeMask;
+  SetTemplateValues(tmpl, internals);
+  return 0;
+}
+
+/**
+ * Create the NTPL filters of a flow and add the flow to the flow list.
+ *
+ * @param[in] flow
+ *   Zeroed flow to set up.
+ * @param[in] tmpl
+ *   If not NULL, compile the rule into this flow template. The keyset and
+ *   the assign command are made, but no key values are added and the flow
+ *   is not added to the flow list.
+ * @param[in] ntpl_buf, filter_buf1
+ *   Scratch buffers of NTPL_BSIZE + 1 bytes.
+ *
+ * @return
+ *   0 if the flow is created, else 1 and error is set.
+ */
+static int _flow_create(struct rte_eth_dev *dev,
+                        struct rte_flow *flow,
+                        const struct rte_flow_attr *attr,
+                        const struct rte_flow_item items[],
+                        const struct rte_flow_action actions[],
+                        struct rte_pmd_ntacc_flow_template *tmpl,
+                        char *ntpl_buf,
+                        char *filter_buf1,
+                        struct rte_flow_error *error)
 {
   struct pmd_internals *internals = dev->data->dev_private;
   uint32_t ntplID;
@@ -2097,7 +3811,10 @@ static struct rte_flow *_dev_flow_create(struct rte_eth_dev *dev,
   uint8_t list_queues[256];
   bool filterContinue = false;
   const struct rte_flow_action_rss *rss = NULL;
+  const struct rte_flow_action_count *count = NULL;
   struct color_s color = {0, 0, false};
+  struct capture_s capture = {0, 0};
+  int descrColor;
   uint8_t nb_ports = 0;
   uint8_t list_ports[MAX_NTACC_PORTS];
   uint8_t action = 0;
@@ -2109,27 +3826,8 @@ static struct rte_flow *_dev_flow_create(struct rte_eth_dev *dev,
   int key;
   int i;
 
-  char *ntpl_buf = NULL;
-  char *filter_buf1 = NULL;
-  struct rte_flow *flow = NULL;
   const char *ntpl_str = NULL;
 
-  // Init error struct
-  rte_flow_error_set(error, 0, RTE_FLOW_ERROR_TYPE_NONE, NULL, "No errors");
-
-  filter_buf1 = rte_malloc(internals->name, NTPL_BSIZE + 1, 0);
-  if (!filter_buf1) {
-    rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Out of memory");
-    goto FlowError;
-  }
-
-  flow = rte_malloc(internals->name, sizeof(struct rte_flow), 0);
-  if (!flow) {
-    rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Out of memory");
-    goto FlowError;
-  }
-  memset(flow, 0, sizeof(struct rte_flow));
-
   NTACC_LOCK(&internals->configlock);
 
   if (_handle_actions(dev,
@@ -2139,6 +3837,8 @@ static struct rte_flow *_dev_flow_create(struct rte_eth_dev *dev,
                       &typeMask,
                       &color,
                       &action,
+                      &count,
+                      &capture,
                       &nb_queues,
                       list_queues,
                       internals,
@@ -2147,6 +3847,39 @@ static struct rte_flow *_dev_flow_create(struct rte_eth_dev *dev,
     goto FlowError;
   }
 
+  // Drop and forward filters deliver no packets, so a color is only set for a flow counter
+  if ((action & (ACTION_DROP | ACTION_FORWARD)) && !(action & ACTION_COUNT)) {
+    color.type = NO_COLOR;
+  }
+
+  if (tmpl) {
+    tmpl->actionMask = typeMask;
+    tmpl->color = color;
+  }
+
+  // The color of a flow counter is only delivered in the packet descriptor if MARK is used
+  descrColor = color.type;
+#ifndef USE_SW_STAT
+  if (action & ACTION_COUNT) {
+    if (_flow_counter_alloc(dev, flow, count, &color, error) != 0) {
+      NTACC_UNLOCK(&internals->configlock);
+      goto FlowError;
+    }
+    if (tmpl) {
+      // The flows of the template get their own counter when inserted
+      _flow_counter_free(internals, flow);
+      tmpl->count = 1;
+      if (count) {
+        tmpl->countConf = *count;
+      }
+    }
+  }
+  else if (!tmpl && _flow_mark_get(internals, flow, &color, error) != 0) {
+    NTACC_UNLOCK(&internals->configlock);
+    goto FlowError;
+  }
+#endif
+
   if (_handle_items(items,
                     &typeMask,
                     &tunnel,
@@ -2162,16 +3895,14 @@ static struct rte_flow *_dev_flow_create(struct rte_eth_dev *dev,
     goto FlowError;
   }
 
-  reuse = IsFilterReuse(internals, typeMask, list_queues, nb_queues, &key);
+  if (tmpl && _flow_template_set_pattern(tmpl, items, typeMask, internals, error) != 0) {
+    NTACC_UNLOCK(&internals->configlock);
+    goto FlowError;
+  }
+
+  reuse = IsFilterReuse(internals, typeMask, list_queues, nb_queues, &capture, &color, &key);
 
   if (!reuse) {
-    ntpl_buf = rte_malloc(internals->name, NTPL_BSIZE + 1, 0);
-    if (!ntpl_buf) {
-      rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Out of memory");
-      NTACC_UNLOCK(&internals->configlock);
-      goto FlowError;
-    }
-
     if (attr->group) {
       rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ATTR_GROUP, NULL, "Attribute groups are not supported");
       NTACC_UNLOCK(&internals->configlock);
@@ -2205,7 +3936,7 @@ static struct rte_flow *_dev_flow_create(struct rte_eth_dev *dev,
         }
       }
 
-      switch (color.type)
+      switch (descrColor)
       {
       case NO_COLOR:
     #ifdef COPY_OFFSET0
@@ -2235,11 +3966,9 @@ static struct rte_flow *_dev_flow_create(struct rte_eth_dev *dev,
     }
     else if (action & ACTION_DROP) {
       snprintf(ntpl_buf, NTPL_BSIZE, "assign[streamid=drop;priority=%u;", attr->priority);
-      color.type = NO_COLOR;
     }
     else if (action & ACTION_FORWARD) {
       snprintf(ntpl_buf, NTPL_BSIZE, "assign[streamid=drop;priority=%u;DestinationPort=%u", attr->priority, forwardPort);
-      color.type = NO_COLOR;
     }
     else {
       rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ACTION, NULL, "Queue, RSS, drop or forward information must be set");
@@ -2248,7 +3977,7 @@ static struct rte_flow *_dev_flow_create(struct rte_eth_dev *dev,
     }
 
     // Create HASH
-    if (action == ACTION_RSS) {
+    if ((action & ~ACTION_COUNT) == ACTION_RSS) {
       // If RSS is used, then set the Hash mode
       CreateHash(&ntpl_buf[strlen(ntpl_buf)], rss, internals);
     }
@@ -2270,7 +3999,17 @@ static struct rte_flow *_dev_flow_create(struct rte_eth_dev *dev,
       break;
     }
 
-    if ((dev->data->dev_conf.rxmode.offloads & DEV_RX_OFFLOAD_KEEP_CRC) == 0) {
+    if (capture.sample > 1) {
+      // Deliver 1 of capture.sample packets
+      snprintf(&ntpl_buf[strlen(ntpl_buf)], NTPL_BSIZE - strlen(ntpl_buf) - 1, NTPL_SAMPLE_OPTION, capture.sample);
+    }
+
+    if (capture.slice != 0) {
+      // Slice to the snap length. Only one slice option is allowed, so packets
+      // shorter than the snap length keep their FCS.
+      snprintf(&ntpl_buf[strlen(ntpl_buf)], NTPL_BSIZE - strlen(ntpl_buf) - 1, NTPL_SLICE_OPTION, capture.slice);
+    }
+    else if ((dev->data->dev_conf.rxmode.offloads & DEV_RX_OFFLOAD_KEEP_CRC) == 0) {
       // Remove FCS
       snprintf(&ntpl_buf[strlen(ntpl_buf)], NTPL_BSIZE - strlen(ntpl_buf) - 1, ";Slice=EndOfFrame[-4]");
     }
@@ -2298,84 +4037,939 @@ static struct rte_flow *_dev_flow_create(struct rte_eth_dev *dev,
       snprintf(&ntpl_buf[strlen(ntpl_buf)], NTPL_BSIZE - strlen(ntpl_buf) - 1, " port==%u", internals->port);
       filterContinue = true;
     }
-    else {
-      int ports;
-      snprintf(&ntpl_buf[strlen(ntpl_buf)], NTPL_BSIZE - strlen(ntpl_buf) - 1, " port==");
-      for (ports = 0; ports < nb_ports;ports++) {
-        snprintf(&ntpl_buf[strlen(ntpl_buf)], NTPL_BSIZE - strlen(ntpl_buf) - 1, "%u", list_ports[ports]);
-        if (ports < (nb_ports - 1)) {
-          snprintf(&ntpl_buf[strlen(ntpl_buf)], NTPL_BSIZE - strlen(ntpl_buf) - 1, ",");
-        }
+    else {
+      int ports;
+      snprintf(&ntpl_buf[strlen(ntpl_buf)], NTPL_BSIZE - strlen(ntpl_buf) - 1, " port==");
+      for (ports = 0; ports < nb_ports;ports++) {
+        snprintf(&ntpl_buf[strlen(ntpl_buf)], NTPL_BSIZE - strlen(ntpl_buf) - 1, "%u", list_ports[ports]);
+        if (ports < (nb_ports - 1)) {
+          snprintf(&ntpl_buf[strlen(ntpl_buf)], NTPL_BSIZE - strlen(ntpl_buf) - 1, ",");
+        }
+      }
+      filterContinue = true;
+    }
+  }
+
+  if (CreateOptimizedFilter(ntpl_buf, internals, flow, &filterContinue, typeMask, list_queues, nb_queues, key, &capture, &color, tmpl == NULL, error) != 0) {
+    NTACC_UNLOCK(&internals->configlock);
+    goto FlowError;
+  }
+
+  if (!reuse) {
+    if (DoNtpl(ntpl_buf, &ntplID, internals, NULL) != 0) {
+			NTACC_UNLOCK(&internals->configlock);
+      goto FlowError;
+    }
+    NTACC_LOCK(&internals->lock);
+    flow->assign_ntpl_id = ntplID;
+    if (flow->keyset) {
+      flow->keyset->assign_ntpl_id = ntplID;
+    }
+    NTACC_UNLOCK(&internals->lock);
+  }
+  NTACC_UNLOCK(&internals->configlock);
+
+  if (tmpl) {
+    // The template keeps the reference to the keyset
+    FlushFilterValues(internals);
+    tmpl->keyset = flow->keyset;
+    flow->keyset = NULL;
+    return 0;
+  }
+
+  NTACC_LOCK(&internals->lock);
+  LIST_INSERT_HEAD(&internals->flows, flow, next);
+  NTACC_UNLOCK(&internals->lock);
+  return 0;
+
+FlowError:
+  if (flow->keyset) {
+    NTACC_LOCK(&internals->configlock);
+    NTACC_LOCK(&internals->lock);
+    _cleanUpKeySet(flow->keyset, internals, NULL);
+    flow->keyset = NULL;
+    NTACC_UNLOCK(&internals->lock);
+    NTACC_UNLOCK(&internals->configlock);
+  }
+  FlushFilterValues(internals);
+#ifndef USE_SW_STAT
+  _flow_counter_free(internals, flow);
+#endif
+  return 1;
+}
+
+static struct rte_flow *_dev_flow_create(struct rte_eth_dev *dev,
+                                         const struct rte_flow_attr *attr,
+                                         const struct rte_flow_item items[],
+                                         const struct rte_flow_action actions[],
+                                         struct rte_flow_error *error)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  char *ntpl_buf = NULL;
+  char *filter_buf1 = NULL;
+  struct rte_flow *flow = NULL;
+
+  // Init error struct
+  rte_flow_error_set(error, 0, RTE_FLOW_ERROR_TYPE_NONE, NULL, "No errors");
+
+  filter_buf1 = rte_malloc(internals->name, NTPL_BSIZE + 1, 0);
+  ntpl_buf = rte_malloc(internals->name, NTPL_BSIZE + 1, 0);
+  flow = rte_zmalloc(internals->name, sizeof(struct rte_flow), 0);
+  if (!filter_buf1 || !ntpl_buf || !flow) {
+    rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Out of memory");
+    goto FlowError;
+  }
+
+  if (_flow_create(dev, flow, attr, items, actions, NULL, ntpl_buf, filter_buf1, error) != 0) {
+    goto FlowError;
+  }
+
+  rte_free(ntpl_buf);
+  rte_free(filter_buf1);
+  return flow;
+
+FlowError:
+    if (flow) {
+      rte_free(flow);
+    }
+    if (ntpl_buf) {
+      rte_free(ntpl_buf);
+    }
+    if (filter_buf1) {
+      rte_free(filter_buf1);
+    }
+    return NULL;
+}
+
+static int _dev_flow_destroy(struct rte_eth_dev *dev,
+                             struct rte_flow *flow,
+                             struct rte_flow_error *error)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  NTACC_LOCK(&internals->configlock);
+  NTACC_LOCK(&internals->lock);
+  _cleanUpFlow(flow, internals, error);
+  NTACC_UNLOCK(&internals->lock);
+  NTACC_UNLOCK(&internals->configlock);
+  return 0;
+}
+
+static int _dev_flow_flush(struct rte_eth_dev *dev,
+                           struct rte_flow_error *error)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+
+  NTACC_LOCK(&internals->configlock);
+  NTACC_LOCK(&internals->lock);
+  while (!LIST_EMPTY(&internals->flows)) {
+    struct rte_flow *flow;
+    flow = LIST_FIRST(&internals->flows);
+    _cleanUpFlow(flow, internals, error);
+  }
+  NTACC_UNLOCK(&internals->lock);
+  NTACC_UNLOCK(&internals->configlock);
+  return 0;
+}
+
+/**
+ * Run a batch of asynchronous flow operations. A flow that is created and
+ * destroyed in the same batch never reaches the adapter.
+ * Each operation is run with the rte_flow mutex of the port held, so it is
+ * serialized with the synchronous flow API exactly as rte_flow_create() is.
+ */
+static void _flow_queue_run(struct rte_eth_dev *dev, struct ntacc_flow_queue_s *q, struct ntacc_flow_op_list_s *batch)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  struct ntacc_flow_op_s *op;
+
+  TAILQ_FOREACH(op, batch, next) {
+    if (op->destroy && op->flow->createOp) {
+      op->flow->createOp->cancelled = 1;
+      op->cancelled = 1;
+    }
+  }
+
+  TAILQ_FOREACH(op, batch, next) {
+    pthread_mutex_lock(&dev->data->flow_ops_mutex);
+    if (op->destroy) {
+      if (op->cancelled) {
+        rte_free(op->flow);
+      }
+      else {
+        NTACC_LOCK(&internals->configlock);
+        NTACC_LOCK(&internals->lock);
+        _cleanUpFlow(op->flow, internals, &op->error);
+        NTACC_UNLOCK(&internals->lock);
+        NTACC_UNLOCK(&internals->configlock);
+      }
+      op->status = 0;
+    }
+    else if (op->cancelled) {
+      op->status = rte_flow_error_set(&op->error, ECANCELED, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Flow destroyed before it was created");
+      op->flow = NULL;
+    }
+    else {
+      op->flow->createOp = NULL;
+      rte_errno = 0;
+      if (_flow_create(dev, op->flow, op->rule->attr_ro, op->rule->pattern_ro, op->rule->actions_ro, NULL,
+                       q->ntpl_buf, q->filter_buf1, &op->error) != 0) {
+        op->status = rte_errno ? -rte_errno : -EIO;
+        rte_free(op->flow);
+        op->flow = NULL;
+      }
+      else {
+        op->status = 0;
+      }
+    }
+    pthread_mutex_unlock(&dev->data->flow_ops_mutex);
+  }
+}
+
+static void *_flow_queue_thread(void *arg)
+{
+  struct rte_eth_dev *dev = arg;
+  struct pmd_internals *internals = dev->data->dev_private;
+  struct ntacc_flow_queue_s *q = internals->flowq;
+  struct ntacc_flow_op_list_s batch;
+
+  pthread_mutex_lock(&q->mutex);
+  while (q->run) {
+    if (TAILQ_EMPTY(&q->pushed)) {
+      pthread_cond_wait(&q->cond, &q->mutex);
+      continue;
+    }
+    TAILQ_INIT(&batch);
+    TAILQ_CONCAT(&batch, &q->pushed, next);
+    pthread_mutex_unlock(&q->mutex);
+
+    _flow_queue_run(dev, q, &batch);
+
+    pthread_mutex_lock(&q->mutex);
+    TAILQ_CONCAT(&q->done, &batch, next);
+  }
+  pthread_mutex_unlock(&q->mutex);
+  return NULL;
+}
+
+/**
+ * Get the asynchronous flow queue of a port. The queue and the flow thread
+ * are created at first use.
+ */
+static struct ntacc_flow_queue_s *_flow_queue_get(struct rte_eth_dev *dev, struct rte_flow_error *error)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  struct ntacc_flow_queue_s *q;
+  char name[RTE_MAX_THREAD_NAME_LEN];
+  int ret;
+
+  if (internals->flowq) {
+    return internals->flowq;
+  }
+
+  q = rte_zmalloc(internals->name, sizeof(struct ntacc_flow_queue_s), 0);
+  if (!q) {
+    rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Out of memory");
+    return NULL;
+  }
+  q->ntpl_buf = rte_malloc(internals->name, NTPL_BSIZE + 1, 0);
+  q->filter_buf1 = rte_malloc(internals->name, NTPL_BSIZE + 1, 0);
+  if (!q->ntpl_buf || !q->filter_buf1) {
+    rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Out of memory");
+    goto QueueError;
+  }
+  pthread_mutex_init(&q->mutex, NULL);
+  pthread_cond_init(&q->cond, NULL);
+  TAILQ_INIT(&q->enqueued);
+  TAILQ_INIT(&q->pushed);
+  TAILQ_INIT(&q->done);
+  q->run = 1;
+  internals->flowq = q;
+
+  snprintf(name, sizeof(name), "ntacc-flow-%u", internals->port);
+  if ((ret = rte_ctrl_thread_create(&q->thread, name, NULL, _flow_queue_thread, dev)) != 0) {
+    internals->flowq = NULL;
+    pthread_cond_destroy(&q->cond);
+    pthread_mutex_destroy(&q->mutex);
+    rte_flow_error_set(error, ret, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Failed to create flow thread");
+    goto QueueError;
+  }
+  return q;
+
+QueueError:
+  if (q->ntpl_buf) {
+    rte_free(q->ntpl_buf);
+  }
+  if (q->filter_buf1) {
+    rte_free(q->filter_buf1);
+  }
+  rte_free(q);
+  return NULL;
+}
+
+static void _flow_queue_free_ops(struct ntacc_flow_op_list_s *list)
+{
+  struct ntacc_flow_op_s *op;
+
+  while (!TAILQ_EMPTY(list)) {
+    op = TAILQ_FIRST(list);
+    TAILQ_REMOVE(list, op, next);
+    if (!op->destroy && op->flow && op->flow->createOp) {
+      // The flow was never created
+      rte_free(op->flow);
+    }
+    rte_free(op);
+  }
+}
+
+/**
+ * Stop the flow thread and drop all operations not done yet.
+ */
+static void _flow_queue_free(struct pmd_internals *internals)
+{
+  struct ntacc_flow_queue_s *q = internals->flowq;
+
+  if (!q) {
+    return;
+  }
+  pthread_mutex_lock(&q->mutex);
+  q->run = 0;
+  pthread_cond_signal(&q->cond);
+  pthread_mutex_unlock(&q->mutex);
+  pthread_join(q->thread, NULL);
+
+  _flow_queue_free_ops(&q->enqueued);
+  _flow_queue_free_ops(&q->pushed);
+  _flow_queue_free_ops(&q->done);
+  pthread_cond_destroy(&q->cond);
+  pthread_mutex_destroy(&q->mutex);
+  rte_free(q->ntpl_buf);
+  rte_free(q->filter_buf1);
+  rte_free(q);
+  internals->flowq = NULL;
+}
+
+/**
+ * Enqueue the creation of a flow. The rule is copied, so the application can
+ * reuse it at once. NTPL strings in RTE_FLOW_ITEM_TYPE_NTPL items are copied too.
+ */
+static struct rte_flow *_flow_create_async(struct rte_eth_dev *dev,
+                                           const struct rte_flow_attr *attr,
+                                           const struct rte_flow_item items[],
+                                           const struct rte_flow_action actions[],
+                                           void *user_data,
+                                           struct rte_flow_error *error)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  const struct rte_flow_conv_rule src = { .attr_ro = attr, .pattern_ro = items, .actions_ro = actions };
+  const struct rte_flow_item *item;
+  struct rte_flow_item *dst;
+  struct ntacc_flow_queue_s *q;
+  struct ntacc_flow_op_s *op;
+  size_t strSize = 0;
+  char *str;
+  int size;
+
+  if ((q = _flow_queue_get(dev, error)) == NULL) {
+    return NULL;
+  }
+
+  size = rte_flow_conv(RTE_FLOW_CONV_OP_RULE, NULL, 0, &src, error);
+  if (size < 0) {
+    return NULL;
+  }
+  for (item = items; item->type != RTE_FLOW_ITEM_TYPE_END; item++) {
+    if (item->type == RTE_FLOW_ITEM_TYPE_NTPL && item->spec) {
+      strSize += strlen(((const struct rte_flow_item_ntpl *)item->spec)->ntpl_str) + 1;
+    }
+  }
+
+  op = rte_zmalloc(internals->name, sizeof(struct ntacc_flow_op_s) + size + strSize, sizeof(double));
+  if (!op) {
+    rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Out of memory");
+    return NULL;
+  }
+  op->flow = rte_zmalloc(internals->name, sizeof(struct rte_flow), 0);
+  if (!op->flow) {
+    rte_free(op);
+    rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Out of memory");
+    return NULL;
+  }
+  op->rule = (struct rte_flow_conv_rule *)(op + 1);
+  rte_flow_conv(RTE_FLOW_CONV_OP_RULE, op->rule, size, &src, NULL);
+
+  // Point the NTPL items to a copy of the NTPL strings
+  str = (char *)op->rule + size;
+  for (dst = op->rule->pattern; dst->type != RTE_FLOW_ITEM_TYPE_END; dst++) {
+    if (dst->type == RTE_FLOW_ITEM_TYPE_NTPL && dst->spec) {
+      struct rte_flow_item_ntpl *ntpl = (struct rte_flow_item_ntpl *)(uintptr_t)dst->spec;
+      strcpy(str, ntpl->ntpl_str);
+      ntpl->ntpl_str = str;
+      str += strlen(str) + 1;
+    }
+  }
+
+  op->user_data = user_data;
+  op->flow->createOp = op;
+
+  pthread_mutex_lock(&q->mutex);
+  TAILQ_INSERT_TAIL(&q->enqueued, op, next);
+  pthread_mutex_unlock(&q->mutex);
+  return op->flow;
+}
+
+static int _flow_destroy_async(struct rte_eth_dev *dev,
+                               struct rte_flow *flow,
+                               void *user_data,
+                               struct rte_flow_error *error)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  struct ntacc_flow_queue_s *q;
+  struct ntacc_flow_op_s *op;
+
+  if ((q = _flow_queue_get(dev, error)) == NULL) {
+    return -rte_errno;
+  }
+
+  op = rte_zmalloc(internals->name, sizeof(struct ntacc_flow_op_s), 0);
+  if (!op) {
+    return rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Out of memory");
+  }
+  op->flow = flow;
+  op->user_data = user_data;
+  op->destroy = 1;
+
+  pthread_mutex_lock(&q->mutex);
+  TAILQ_INSERT_TAIL(&q->enqueued, op, next);
+  pthread_mutex_unlock(&q->mutex);
+  return 0;
+}
+
+/**
+ * Hand all enqueued operations to the flow thread as one batch.
+ */
+static int _flow_push(struct rte_eth_dev *dev, struct rte_flow_error *error)
+{
+  struct ntacc_flow_queue_s *q;
+
+  if ((q = _flow_queue_get(dev, error)) == NULL) {
+    return -rte_errno;
+  }
+
+  pthread_mutex_lock(&q->mutex);
+  if (!TAILQ_EMPTY(&q->enqueued)) {
+    TAILQ_CONCAT(&q->pushed, &q->enqueued, next);
+    pthread_cond_signal(&q->cond);
+  }
+  pthread_mutex_unlock(&q->mutex);
+  return 0;
+}
+
+static int _flow_pull(struct rte_eth_dev *dev,
+                      struct rte_pmd_ntacc_flow_result res[],
+                      uint16_t nb_res,
+                      struct rte_flow_error *error)
+{
+  struct ntacc_flow_queue_s *q;
+  struct ntacc_flow_op_s *op;
+  uint16_t n = 0;
+
+  if ((q = _flow_queue_get(dev, error)) == NULL) {
+    return -rte_errno;
+  }
+
+  pthread_mutex_lock(&q->mutex);
+  while (n < nb_res && !TAILQ_EMPTY(&q->done)) {
+    op = TAILQ_FIRST(&q->done);
+    TAILQ_REMOVE(&q->done, op, next);
+    res[n].flow = op->flow;
+    res[n].user_data = op->user_data;
+    res[n].status = op->status;
+    res[n].error = op->error;
+    rte_free(op);
+    n++;
+  }
+  pthread_mutex_unlock(&q->mutex);
+  return n;
+}
+
+static struct rte_pmd_ntacc_flow_template *_flow_template_create(struct rte_eth_dev *dev,
+                                                                 const struct rte_flow_attr *attr,
+                                                                 const struct rte_flow_item items[],
+                                                                 const struct rte_flow_action actions[],
+                                                                 struct rte_flow_error *error)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  struct rte_pmd_ntacc_flow_template *tmpl;
+  struct rte_flow *flow;
+
+  tmpl = rte_zmalloc(internals->name, sizeof(struct rte_pmd_ntacc_flow_template), 0);
+  flow = rte_zmalloc(internals->name, sizeof(struct rte_flow), 0);
+  if (!tmpl || !flow) {
+    rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Out of memory");
+    goto TemplateError;
+  }
+
+  if (_flow_create(dev, flow, attr, items, actions, tmpl, tmpl->ntpl_buf, tmpl->filter_buf, error) != 0) {
+    goto TemplateError;
+  }
+  rte_free(flow);
+
+  NTACC_LOCK(&internals->lock);
+  LIST_INSERT_HEAD(&internals->templates, tmpl, next);
+  NTACC_UNLOCK(&internals->lock);
+  return tmpl;
+
+TemplateError:
+  if (flow) {
+    rte_free(flow);
+  }
+  if (tmpl) {
+    rte_free(tmpl);
+  }
+  return NULL;
+}
+
+/**
+ * Insert a flow through a flow template. The pattern is only parsed for
+ * its key values. The assign command and the keyset are the ones of the
+ * template, so a single KeyList command is sent to the adapter.
+ * Must be called with internals->configlock held.
+ */
+static struct rte_flow *_flow_template_insert_locked(struct rte_eth_dev *dev,
+                                                     struct rte_pmd_ntacc_flow_template *tmpl,
+                                                     const struct rte_flow_item items[],
+                                                     struct rte_flow_error *error)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  const struct rte_flow_item *item;
+  struct rte_flow *flow;
+  struct color_s color = tmpl->color;
+  uint64_t typeMask = tmpl->actionMask;
+  bool filterContinue = false;
+  bool tunnel = false;
+  uint8_t nb_ports = 0;
+  uint8_t list_ports[MAX_NTACC_PORTS];
+  const char *ntpl_str = NULL;
+  uint8_t nb_items = 0;
+
+  flow = rte_zmalloc(internals->name, sizeof(struct rte_flow), 0);
+  if (!flow) {
+    rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Out of memory");
+    return NULL;
+  }
+
+  for (item = items; item->type != RTE_FLOW_ITEM_TYPE_END; ++item) {
+    if (item->type == RTE_FLOW_ITEM_TYPE_VOID) {
+      continue;
+    }
+    if (nb_items == tmpl->nb_items || item->type != tmpl->items[nb_items]) {
+      break;
+    }
+    nb_items++;
+  }
+  if (item->type != RTE_FLOW_ITEM_TYPE_END || nb_items != tmpl->nb_items) {
+    rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_ITEM, item, "Pattern items do not match the flow template");
+    rte_free(flow);
+    return NULL;
+  }
+
+#ifndef USE_SW_STAT
+  if (tmpl->count) {
+    if (_flow_counter_alloc(dev, flow, &tmpl->countConf, &color, error) != 0) {
+      goto InsertError;
+    }
+  }
+  else if (_flow_mark_get(internals, flow, &color, error) != 0) {
+    goto InsertError;
+  }
+#endif
+
+  if (_handle_items(items,
+                    &typeMask,
+                    &tunnel,
+                    &color,
+                    &filterContinue,
+                    &nb_ports,
+                    list_ports,
+                    &ntpl_str,
+                    tmpl->filter_buf,
+                    internals,
+                    error) != 0) {
+    goto InsertError;
+  }
+
+  if (typeMask != tmpl->typeMask) {
+    rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_ITEM, NULL, "Pattern values do not match the flow template");
+    goto InsertError;
+  }
+
+  if (CreateTemplateKeyList(tmpl, internals, flow, &color, error) != 0) {
+    goto InsertError;
+  }
+
+  NTACC_LOCK(&internals->lock);
+  LIST_INSERT_HEAD(&internals->flows, flow, next);
+  NTACC_UNLOCK(&internals->lock);
+  return flow;
+
+InsertError:
+  FlushFilterValues(internals);
+#ifndef USE_SW_STAT
+  _flow_counter_free(internals, flow);
+#endif
+  rte_free(flow);
+  return NULL;
+}
+
+static struct rte_flow *_flow_template_insert(struct rte_eth_dev *dev,
+                                              struct rte_pmd_ntacc_flow_template *tmpl,
+                                              const struct rte_flow_item items[],
+                                              struct rte_flow_error *error)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  struct rte_flow *flow;
+
+  NTACC_LOCK(&internals->configlock);
+  flow = _flow_template_insert_locked(dev, tmpl, items, error);
+  NTACC_UNLOCK(&internals->configlock);
+  return flow;
+}
+
+/**
+ * Destroy a flow template. The flows inserted through the template are
+ * not destroyed. They keep the keyset and the assign command alive.
+ */
+static int _flow_template_destroy(struct rte_eth_dev *dev,
+                                  struct rte_pmd_ntacc_flow_template *tmpl,
+                                  struct rte_flow_error *error)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+
+  NTACC_LOCK(&internals->configlock);
+  NTACC_LOCK(&internals->lock);
+  LIST_REMOVE(tmpl, next);
+  _cleanUpKeySet(tmpl->keyset, internals, error);
+  NTACC_UNLOCK(&internals->lock);
+  NTACC_UNLOCK(&internals->configlock);
+  rte_free(tmpl);
+  return 0;
+}
+
+static void _flow_template_free(struct pmd_internals *internals)
+{
+  struct rte_pmd_ntacc_flow_template *tmpl;
+
+  NTACC_LOCK(&internals->configlock);
+  NTACC_LOCK(&internals->lock);
+  while (!LIST_EMPTY(&internals->templates)) {
+    tmpl = LIST_FIRST(&internals->templates);
+    LIST_REMOVE(tmpl, next);
+    _cleanUpKeySet(tmpl->keyset, internals, NULL);
+    rte_free(tmpl);
+  }
+  NTACC_UNLOCK(&internals->lock);
+  NTACC_UNLOCK(&internals->configlock);
+}
+
+static struct rte_pmd_ntacc_shunt *_shunt_create(struct rte_eth_dev *dev,
+                                                 const struct rte_pmd_ntacc_shunt_conf *conf,
+                                                 struct rte_flow_error *error)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  struct rte_pmd_ntacc_shunt *shunt;
+  char name[RTE_HASH_NAMESIZE];
+  const struct rte_flow_attr attr = { .priority = conf->priority, .ingress = 1 };
+  // The template pattern only needs a value in each key field
+  const struct rte_flow_item_ipv4 ipv4 = { .hdr = { .src_addr = RTE_BE32(1), .dst_addr = RTE_BE32(1) } };
+  const struct rte_flow_item_tcp tcp = { .hdr = { .src_port = RTE_BE16(1), .dst_port = RTE_BE16(1) } };
+  const struct rte_flow_item_udp udp = { .hdr = { .src_port = RTE_BE16(1), .dst_port = RTE_BE16(1) } };
+  struct rte_flow_item pattern[] = {
+    { .type = RTE_FLOW_ITEM_TYPE_IPV4, .spec = &ipv4 },
+    { .type = RTE_FLOW_ITEM_TYPE_TCP, .spec = &tcp },
+    { .type = RTE_FLOW_ITEM_TYPE_END },
+  };
+
+  if (conf->max_entries == 0 || conf->actions == NULL) {
+    rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_UNSPECIFIED, NULL, "A shunt table needs a size and actions");
+    return NULL;
+  }
+
+  shunt = rte_zmalloc_socket(internals->name, sizeof(struct rte_pmd_ntacc_shunt), 0, dev->data->numa_node);
+  if (!shunt) {
+    rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Out of memory");
+    return NULL;
+  }
+  shunt->entries = rte_zmalloc_socket(internals->name, sizeof(struct ntacc_shunt_entry_s) * conf->max_entries,
+                                      RTE_CACHE_LINE_SIZE, dev->data->numa_node);
+  snprintf(name, sizeof(name), "ntacc_shunt_%p", shunt);
+  struct rte_hash_parameters params = {
+    .name = name,
+    .entries = conf->max_entries,
+    .key_len = sizeof(struct rte_pmd_ntacc_shunt_key),
+    .socket_id = dev->data->numa_node,
+  };
+  shunt->hash = rte_hash_create(&params);
+  if (!shunt->entries || !shunt->hash) {
+    rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "Out of memory");
+    goto ShuntError;
+  }
+  shunt->max_entries = conf->max_entries;
+  shunt->timeout = (uint64_t)conf->timeout * rte_get_timer_hz();
+
+  if ((shunt->tcp = _flow_template_create(dev, &attr, pattern, conf->actions, error)) == NULL) {
+    goto ShuntError;
+  }
+  pattern[1].type = RTE_FLOW_ITEM_TYPE_UDP;
+  pattern[1].spec = &udp;
+  if ((shunt->udp = _flow_template_create(dev, &attr, pattern, conf->actions, error)) == NULL) {
+    goto ShuntError;
+  }
+
+  NTACC_LOCK(&internals->lock);
+  LIST_INSERT_HEAD(&internals->shunts, shunt, next);
+  NTACC_UNLOCK(&internals->lock);
+  return shunt;
+
+ShuntError:
+  if (shunt->tcp) {
+    _flow_template_destroy(dev, shunt->tcp, NULL);
+  }
+  rte_hash_free(shunt->hash);
+  rte_free(shunt->entries);
+  rte_free(shunt);
+  return NULL;
+}
+
+/**
+ * Add flows to a shunt table. A flow is only sent to the adapter if it is
+ * not in the table already.
+ * configlock is held for the whole key array, so the KeyList commands of
+ * the keys are sent back to back without other NTPL commands in between.
+ * The table entry of a key is reserved before its KeyList command is sent,
+ * so the same key can never be programmed twice.
+ */
+static int _shunt_add(struct rte_eth_dev *dev,
+                      struct rte_pmd_ntacc_shunt *shunt,
+                      const struct rte_pmd_ntacc_shunt_key keys[],
+                      uint16_t nb_keys,
+                      struct rte_flow_error *error)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  const uint64_t expire = shunt->timeout ? rte_get_timer_cycles() + shunt->timeout : UINT64_MAX;
+  struct rte_flow_item_ipv4 ipv4;
+  struct rte_flow_item_tcp tcp;
+  struct rte_flow_item_udp udp;
+  struct rte_flow_item pattern[] = {
+    { .type = RTE_FLOW_ITEM_TYPE_IPV4, .spec = &ipv4 },
+    { .type = RTE_FLOW_ITEM_TYPE_END },
+    { .type = RTE_FLOW_ITEM_TYPE_END },
+  };
+  struct rte_pmd_ntacc_flow_template *tmpl;
+  struct rte_pmd_ntacc_shunt_key key;
+  struct rte_flow *flow;
+  int32_t pos;
+  uint16_t i;
+
+  memset(&ipv4, 0, sizeof(ipv4));
+  memset(&tcp, 0, sizeof(tcp));
+  memset(&udp, 0, sizeof(udp));
+  memset(&key, 0, sizeof(key));
+  NTACC_LOCK(&internals->configlock);
+  for (i = 0; i < nb_keys; i++) {
+    key.src_addr = keys[i].src_addr;
+    key.dst_addr = keys[i].dst_addr;
+    key.src_port = keys[i].src_port;
+    key.dst_port = keys[i].dst_port;
+    key.proto = keys[i].proto;
+
+    // Zero fields are not part of the template key
+    if (!key.src_addr || !key.dst_addr || !key.src_port || !key.dst_port) {
+      rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_ITEM_SPEC, &keys[i], "All fields of a shunt key must be set");
+      break;
+    }
+    ipv4.hdr.src_addr = key.src_addr;
+    ipv4.hdr.dst_addr = key.dst_addr;
+    if (key.proto == IPPROTO_TCP) {
+      tcp.hdr.src_port = key.src_port;
+      tcp.hdr.dst_port = key.dst_port;
+      pattern[1].type = RTE_FLOW_ITEM_TYPE_TCP;
+      pattern[1].spec = &tcp;
+      tmpl = shunt->tcp;
+    }
+    else if (key.proto == IPPROTO_UDP) {
+      udp.hdr.src_port = key.src_port;
+      udp.hdr.dst_port = key.dst_port;
+      pattern[1].type = RTE_FLOW_ITEM_TYPE_UDP;
+      pattern[1].spec = &udp;
+      tmpl = shunt->udp;
+    }
+    else {
+      rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ITEM_SPEC, &keys[i], "Only TCP and UDP flows can be shunted");
+      break;
+    }
+
+    NTACC_LOCK(&internals->lock);
+    pos = rte_hash_lookup(shunt->hash, &key);
+    if (pos >= 0) {
+      // Already shunted. Restart the timeout
+      shunt->entries[pos].expire = expire;
+      NTACC_UNLOCK(&internals->lock);
+      continue;
+    }
+    // Reserve the entry
+    pos = -ENOSPC;
+    if (rte_hash_count(shunt->hash) < (int32_t)shunt->max_entries) {
+      pos = rte_hash_add_key(shunt->hash, &key);
+    }
+    if (pos < 0 || (uint32_t)pos >= shunt->max_entries) {
+      if (pos >= 0) {
+        rte_hash_del_key(shunt->hash, &key);
       }
-      filterContinue = true;
+      NTACC_UNLOCK(&internals->lock);
+      rte_flow_error_set(error, ENOSPC, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "The shunt table is full");
+      break;
     }
-  }
+    shunt->entries[pos].key = key;
+    shunt->entries[pos].flow = NULL;
+    shunt->entries[pos].expire = expire;
+    NTACC_UNLOCK(&internals->lock);
 
-  if (CreateOptimizedFilter(ntpl_buf, internals, flow, &filterContinue, typeMask, list_queues, nb_queues, key, &color, error) != 0) {
-    NTACC_UNLOCK(&internals->configlock);
-    goto FlowError;
-  }
+    flow = _flow_template_insert_locked(dev, tmpl, pattern, error);
 
-  if (!reuse) {
-    if (DoNtpl(ntpl_buf, &ntplID, internals, NULL) != 0) {
-			NTACC_UNLOCK(&internals->configlock);
-      goto FlowError;
-    }
     NTACC_LOCK(&internals->lock);
-    flow->assign_ntpl_id = ntplID;
+    if (flow == NULL) {
+      rte_hash_del_key(shunt->hash, &key);
+      NTACC_UNLOCK(&internals->lock);
+      break;
+    }
+    shunt->entries[pos].flow = flow;
+    flow->shunt = shunt;
+    flow->shuntPos = pos;
     NTACC_UNLOCK(&internals->lock);
   }
   NTACC_UNLOCK(&internals->configlock);
+  return i;
+}
 
-  if (ntpl_buf) {
-    rte_free(ntpl_buf);
-  }
-  if (filter_buf1) {
-    rte_free(filter_buf1);
-  }
+static int _shunt_remove(struct rte_eth_dev *dev,
+                         struct rte_pmd_ntacc_shunt *shunt,
+                         const struct rte_pmd_ntacc_shunt_key keys[],
+                         uint16_t nb_keys)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  struct rte_pmd_ntacc_shunt_key key;
+  int32_t pos;
+  uint16_t i;
+  int n = 0;
 
+  memset(&key, 0, sizeof(key));
+  NTACC_LOCK(&internals->configlock);
   NTACC_LOCK(&internals->lock);
-  LIST_INSERT_HEAD(&internals->flows, flow, next);
+  for (i = 0; i < nb_keys; i++) {
+    key.src_addr = keys[i].src_addr;
+    key.dst_addr = keys[i].dst_addr;
+    key.src_port = keys[i].src_port;
+    key.dst_port = keys[i].dst_port;
+    key.proto = keys[i].proto;
+    pos = rte_hash_lookup(shunt->hash, &key);
+    if (pos >= 0) {
+      _cleanUpFlow(shunt->entries[pos].flow, internals, NULL);
+      n++;
+    }
+  }
   NTACC_UNLOCK(&internals->lock);
-  return flow;
+  NTACC_UNLOCK(&internals->configlock);
+  return n;
+}
 
-FlowError:
-    if (flow) {
-      rte_free(flow);
+/**
+ * Remove the timed out flows of a shunt table. The scan goes on from
+ * where the last one stopped.
+ */
+static int _shunt_age(struct rte_eth_dev *dev,
+                      struct rte_pmd_ntacc_shunt *shunt,
+                      uint32_t max_scan)
+{
+  struct pmd_internals *internals = dev->data->dev_private;
+  const uint64_t now = rte_get_timer_cycles();
+  const void *key;
+  void *data;
+  uint32_t next;
+  int32_t pos;
+  int n = 0;
+
+  if (shunt->timeout == 0) {
+    return 0;
+  }
+
+  NTACC_LOCK(&internals->configlock);
+  NTACC_LOCK(&internals->lock);
+  next = shunt->ageNext;
+  while (max_scan--) {
+    pos = rte_hash_iterate(shunt->hash, &key, &data, &next);
+    if (pos < 0) {
+      next = 0;
+      break;
     }
-    if (ntpl_buf) {
-      rte_free(ntpl_buf);
+    if (shunt->entries[pos].expire <= now) {
+      _cleanUpFlow(shunt->entries[pos].flow, internals, NULL);
+      n++;
     }
-    if (filter_buf1) {
-      rte_free(filter_buf1);
+  }
+  shunt->ageNext = next;
+  NTACC_UNLOCK(&internals->lock);
+  NTACC_UNLOCK(&internals->configlock);
+  return n;
+}
+
+/*
+ * Destroy the flows and the templates of a shunt table. Must be called
+ * with internals->configlock and internals->lock held.
+ */
+static void _shunt_release(struct rte_pmd_ntacc_shunt *shunt, struct pmd_internals *internals)
+{
+  uint32_t pos;
+
+  for (pos = 0; pos < shunt->max_entries; pos++) {
+    if (shunt->entries[pos].flow) {
+      _cleanUpFlow(shunt->entries[pos].flow, internals, NULL);
     }
-    return NULL;
+  }
+  LIST_REMOVE(shunt->tcp, next);
+  _cleanUpKeySet(shunt->tcp->keyset, internals, NULL);
+  rte_free(shunt->tcp);
+  LIST_REMOVE(shunt->udp, next);
+  _cleanUpKeySet(shunt->udp->keyset, internals, NULL);
+  rte_free(shunt->udp);
+  LIST_REMOVE(shunt, next);
+  rte_hash_free(shunt->hash);
+  rte_free(shunt->entries);
+  rte_free(shunt);
 }
 
-static int _dev_flow_destroy(struct rte_eth_dev *dev,
-                             struct rte_flow *flow,
-                             struct rte_flow_error *error)
+static int _shunt_destroy(struct rte_eth_dev *dev,
+                          struct rte_pmd_ntacc_shunt *shunt,
+                          struct rte_flow_error *error __rte_unused)
 {
   struct pmd_internals *internals = dev->data->dev_private;
+
+  NTACC_LOCK(&internals->configlock);
   NTACC_LOCK(&internals->lock);
-  _cleanUpFlow(flow, internals, error);
+  _shunt_release(shunt, internals);
   NTACC_UNLOCK(&internals->lock);
+  NTACC_UNLOCK(&internals->configlock);
   return 0;
 }
 
-static int _dev_flow_flush(struct rte_eth_dev *dev,
-                           struct rte_flow_error *error)
+static void _shunt_free(struct pmd_internals *internals)
 {
-  struct pmd_internals *internals = dev->data->dev_private;
-
+  NTACC_LOCK(&internals->configlock);
   NTACC_LOCK(&internals->lock);
-  while (!LIST_EMPTY(&internals->flows)) {
-    struct rte_flow *flow;
-    flow = LIST_FIRST(&internals->flows);
-    _cleanUpFlow(flow, internals, error);
+  while (!LIST_EMPTY(&internals->shunts)) {
+    _shunt_release(LIST_FIRST(&internals->shunts), internals);
   }
   NTACC_UNLOCK(&internals->lock);
-  return 0;
+  NTACC_UNLOCK(&internals->configlock);
 }
 
 static unsigned int _checkHostbuffers(struct rte_eth_dev *dev, uint8_t queue)
@@ -2433,19 +5027,19 @@ static int _dev_flow_isolate(struct rte_eth_dev *dev,
     }
 
     // Delete the filter
+    NTACC_LOCK(&internals->configlock);
     NTACC_LOCK(&internals->lock);
     while (!LIST_EMPTY(&internals->defaultFlow->ntpl_id)) {
       struct filter_flow *id;
       id = LIST_FIRST(&internals->defaultFlow->ntpl_id);
       snprintf(ntpl_buf, 20, "delete=%d", id->ntpl_id);
-      NTACC_LOCK(&internals->configlock);
       DoNtpl(ntpl_buf, NULL, internals, error);
-      NTACC_UNLOCK(&internals->configlock);
       PMD_NTACC_LOG(DEBUG, "Deleting Item filter 0: %s\n", ntpl_buf);
       LIST_REMOVE(id, next);
       rte_free(id);
     }
     NTACC_UNLOCK(&internals->lock);
+    NTACC_UNLOCK(&internals->configlock);
 
 		// Check that the hostbuffers are deleted/changed
     counter = 0;
@@ -2566,12 +5160,28 @@ static int _dev_flow_validate(struct rte_eth_dev *dev __rte_unused,
   return 0;
 }
 
+static int _dev_flow_query(struct rte_eth_dev *dev __rte_unused,
+                           struct rte_flow *flow __rte_unused,
+                           const struct rte_flow_action *action,
+                           void *data __rte_unused,
+                           struct rte_flow_error *error)
+{
+  switch (action->type) {
+#ifndef USE_SW_STAT
+  case RTE_FLOW_ACTION_TYPE_COUNT:
+    return _flow_count_query(dev, &flow, (struct rte_flow_query_count *)data, 1, error);
+#endif
+  default:
+    return rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ACTION, action, "Action cannot be queried");
+  }
+}
+
 static const struct rte_flow_ops _dev_flow_ops = {
   .validate = _dev_flow_validate,
   .create = _dev_flow_create,
   .destroy = _dev_flow_destroy,
   .flush = _dev_flow_flush,
-  .query = NULL,
+  .query = _dev_flow_query,
   .isolate = _dev_flow_isolate,
 };
 
@@ -2696,9 +5306,19 @@ static struct eth_dev_ops ops = {
     .tx_queue_release = eth_queue_release,
     .rx_queue_start = eth_rx_queue_start,
     .rx_queue_stop = eth_rx_queue_stop,
+    .rxq_info_get = eth_rx_queue_info,
+    .rx_burst_mode_get = eth_rx_burst_mode_get,
+    .tx_burst_mode_get = eth_tx_burst_mode_get,
     .link_update = eth_link_update,
     .stats_get = eth_stats_get,
     .stats_reset = eth_stats_reset,
+#ifndef USE_SW_STAT
+    .xstats_get = eth_xstats_get,
+    .xstats_get_names = eth_xstats_get_names,
+    .xstats_reset = eth_stats_reset,
+    .xstats_get_by_id = eth_xstats_get_by_id,
+    .xstats_get_names_by_id = eth_xstats_get_names_by_id,
+#endif
     .flow_ctrl_get = _dev_get_flow_ctrl,
     .flow_ctrl_set = _dev_set_flow_ctrl,
     .fw_version_get = eth_fw_version_get,
@@ -2707,8 +5327,263 @@ static struct eth_dev_ops ops = {
     .promiscuous_enable = eth_promiscuous_enable,
     .promiscuous_disable = eth_promiscuous_disable,
 		.flow_ops_get = _dev_flow_ops_get,
+    .get_monitor_addr = eth_ntacc_get_monitor_addr,
 };
 
+#define NTACC_CHECK_PORT(port_id, dev, error) do { \
+  RTE_ETH_VALID_PORTID_OR_ERR_RET(port_id, -ENODEV); \
+  dev = &rte_eth_devices[port_id]; \
+  if (dev->dev_ops != &ops) { \
+    return rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_UNSPECIFIED, NULL, "Not a Napatech port"); \
+  } \
+} while (0)
+
+static struct rte_eth_dev *_ntacc_port_dev(uint16_t port_id, struct rte_flow_error *error)
+{
+  struct rte_eth_dev *dev;
+
+  if (!rte_eth_dev_is_valid_port(port_id)) {
+    rte_flow_error_set(error, ENODEV, RTE_FLOW_ERROR_TYPE_UNSPECIFIED, NULL, "Invalid port");
+    return NULL;
+  }
+  dev = &rte_eth_devices[port_id];
+  if (dev->dev_ops != &ops) {
+    rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_UNSPECIFIED, NULL, "Not a Napatech port");
+    return NULL;
+  }
+  return dev;
+}
+
+int rte_pmd_ntacc_flow_query_count(uint16_t port_id,
+                                   struct rte_flow **flows,
+                                   struct rte_flow_query_count *counts,
+                                   uint32_t nb_flows,
+                                   struct rte_flow_error *error)
+{
+  struct rte_eth_dev *dev;
+
+  NTACC_CHECK_PORT(port_id, dev, error);
+#ifdef USE_SW_STAT
+  RTE_SET_USED(flows);
+  RTE_SET_USED(counts);
+  RTE_SET_USED(nb_flows);
+  return rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_UNSPECIFIED, NULL, "COUNT requires hardware-based statistics");
+#else
+  return _flow_count_query(dev, flows, counts, nb_flows, error);
+#endif
+}
+
+struct rte_flow *rte_pmd_ntacc_flow_create_async(uint16_t port_id,
+                                                 const struct rte_flow_attr *attr,
+                                                 const struct rte_flow_item pattern[],
+                                                 const struct rte_flow_action actions[],
+                                                 void *user_data,
+                                                 struct rte_flow_error *error)
+{
+  struct rte_eth_dev *dev;
+
+  if ((dev = _ntacc_port_dev(port_id, error)) == NULL) {
+    return NULL;
+  }
+  return _flow_create_async(dev, attr, pattern, actions, user_data, error);
+}
+
+int rte_pmd_ntacc_flow_destroy_async(uint16_t port_id,
+                                     struct rte_flow *flow,
+                                     void *user_data,
+                                     struct rte_flow_error *error)
+{
+  struct rte_eth_dev *dev;
+
+  NTACC_CHECK_PORT(port_id, dev, error);
+  return _flow_destroy_async(dev, flow, user_data, error);
+}
+
+int rte_pmd_ntacc_flow_push(uint16_t port_id, struct rte_flow_error *error)
+{
+  struct rte_eth_dev *dev;
+
+  NTACC_CHECK_PORT(port_id, dev, error);
+  return _flow_push(dev, error);
+}
+
+int rte_pmd_ntacc_flow_pull(uint16_t port_id,
+                            struct rte_pmd_ntacc_flow_result res[],
+                            uint16_t nb_res,
+                            struct rte_flow_error *error)
+{
+  struct rte_eth_dev *dev;
+
+  NTACC_CHECK_PORT(port_id, dev, error);
+  return _flow_pull(dev, res, nb_res, error);
+}
+
+struct rte_pmd_ntacc_flow_template *rte_pmd_ntacc_flow_template_create(uint16_t port_id,
+                                                                       const struct rte_flow_attr *attr,
+                                                                       const struct rte_flow_item pattern[],
+                                                                       const struct rte_flow_action actions[],
+                                                                       struct rte_flow_error *error)
+{
+  struct rte_eth_dev *dev;
+
+  if ((dev = _ntacc_port_dev(port_id, error)) == NULL) {
+    return NULL;
+  }
+  return _flow_template_create(dev, attr, pattern, actions, error);
+}
+
+struct rte_flow *rte_pmd_ntacc_flow_template_insert(uint16_t port_id,
+                                                    struct rte_pmd_ntacc_flow_template *tmpl,
+                                                    const struct rte_flow_item pattern[],
+                                                    struct rte_flow_error *error)
+{
+  struct rte_eth_dev *dev;
+
+  if ((dev = _ntacc_port_dev(port_id, error)) == NULL) {
+    return NULL;
+  }
+  return _flow_template_insert(dev, tmpl, pattern, error);
+}
+
+int rte_pmd_ntacc_flow_template_destroy(uint16_t port_id,
+                                        struct rte_pmd_ntacc_flow_template *tmpl,
+                                        struct rte_flow_error *error)
+{
+  struct rte_eth_dev *dev;
+
+  NTACC_CHECK_PORT(port_id, dev, error);
+  return _flow_template_destroy(dev, tmpl, error);
+}
+
+int rte_pmd_ntacc_rx_merge_streams(uint16_t port_id,
+                                   uint16_t queue_id,
+                                   const uint32_t stream_ids[],
+                                   uint16_t nb_streams)
+{
+  struct rte_eth_dev *dev;
+  struct pmd_internals *internals;
+  struct ntacc_rx_queue *rx_q;
+  struct ntacc_rx_merge_s *merge;
+  uint16_t i;
+
+  RTE_ETH_VALID_PORTID_OR_ERR_RET(port_id, -ENODEV);
+  dev = &rte_eth_devices[port_id];
+  if (dev->dev_ops != &ops) {
+    return -ENOTSUP;
+  }
+  if (dev->data->dev_started) {
+    PMD_NTACC_LOG(ERR, "Port %u must be stopped to merge RX streams\n", port_id);
+    return -EBUSY;
+  }
+  internals = dev->data->dev_private;
+  if (queue_id >= dev->data->nb_rx_queues || !internals->rxq[queue_id].enabled) {
+    PMD_NTACC_LOG(ERR, "RX queue %u of port %u is not set up\n", queue_id, port_id);
+    return -EINVAL;
+  }
+  if (nb_streams > RTE_PMD_NTACC_MAX_MERGE_STREAMS || (nb_streams && stream_ids == NULL)) {
+    return -EINVAL;
+  }
+
+  rx_q = &internals->rxq[queue_id];
+  rte_free(rx_q->merge);
+  rx_q->merge = NULL;
+  if (nb_streams == 0) {
+    return 0;
+  }
+
+  merge = rte_zmalloc_socket(internals->name, sizeof(struct ntacc_rx_merge_s), RTE_CACHE_LINE_SIZE, dev->data->numa_node);
+  if (merge == NULL) {
+    _log_out_of_memory_errors(__func__);
+    return -ENOMEM;
+  }
+  merge->stream[0].stream_id = rx_q->stream_id;
+  for (i = 0; i < nb_streams; i++) {
+    merge->stream[i + 1].stream_id = stream_ids[i];
+  }
+  merge->nb_streams = nb_streams + 1;
+  rx_q->merge = merge;
+  return 0;
+}
+
+int rte_pmd_ntacc_rx_queue_numa(uint16_t port_id,
+                                uint16_t queue_id,
+                                int *numa_node)
+{
+  struct rte_eth_dev *dev;
+  struct pmd_internals *internals;
+
+  RTE_ETH_VALID_PORTID_OR_ERR_RET(port_id, -ENODEV);
+  dev = &rte_eth_devices[port_id];
+  if (dev->dev_ops != &ops) {
+    return -ENOTSUP;
+  }
+  internals = dev->data->dev_private;
+  if (queue_id >= dev->data->nb_rx_queues || internals->rxq == NULL || numa_node == NULL) {
+    return -EINVAL;
+  }
+  *numa_node = internals->rxq[queue_id].hbNumaNode >= 0 ? internals->rxq[queue_id].hbNumaNode : SOCKET_ID_ANY;
+  return 0;
+}
+
+struct rte_pmd_ntacc_shunt *rte_pmd_ntacc_shunt_create(uint16_t port_id,
+                                                       const struct rte_pmd_ntacc_shunt_conf *conf,
+                                                       struct rte_flow_error *error)
+{
+  struct rte_eth_dev *dev;
+
+  if ((dev = _ntacc_port_dev(port_id, error)) == NULL) {
+    return NULL;
+  }
+  if (conf == NULL) {
+    rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_UNSPECIFIED, NULL, "No shunt table configuration");
+    return NULL;
+  }
+  return _shunt_create(dev, conf, error);
+}
+
+int rte_pmd_ntacc_shunt_add(uint16_t port_id,
+                            struct rte_pmd_ntacc_shunt *shunt,
+                            const struct rte_pmd_ntacc_shunt_key keys[],
+                            uint16_t nb_keys,
+                            struct rte_flow_error *error)
+{
+  struct rte_eth_dev *dev;
+
+  NTACC_CHECK_PORT(port_id, dev, error);
+  return _shunt_add(dev, shunt, keys, nb_keys, error);
+}
+
+int rte_pmd_ntacc_shunt_remove(uint16_t port_id,
+                               struct rte_pmd_ntacc_shunt *shunt,
+                               const struct rte_pmd_ntacc_shunt_key keys[],
+                               uint16_t nb_keys)
+{
+  struct rte_eth_dev *dev;
+
+  NTACC_CHECK_PORT(port_id, dev, NULL);
+  return _shunt_remove(dev, shunt, keys, nb_keys);
+}
+
+int rte_pmd_ntacc_shunt_age(uint16_t port_id,
+                            struct rte_pmd_ntacc_shunt *shunt,
+                            uint32_t max_scan)
+{
+  struct rte_eth_dev *dev;
+
+  NTACC_CHECK_PORT(port_id, dev, NULL);
+  return _shunt_age(dev, shunt, max_scan);
+}
+
+int rte_pmd_ntacc_shunt_destroy(uint16_t port_id,
+                                struct rte_pmd_ntacc_shunt *shunt,
+                                struct rte_flow_error *error)
+{
+  struct rte_eth_dev *dev;
+
+  NTACC_CHECK_PORT(port_id, dev, error);
+  return _shunt_destroy(dev, shunt, error);
+}
+
 enum property_type_s {
   KEY_MATCH,
   ZERO_COPY_TX,
@@ -2769,7 +5644,12 @@ static int _readProperty(uint8_t adapterNo, enum property_type_s type, int *pVal
 
 static int rte_pmd_init_internals(struct rte_pci_device *dev,
                                   const uint32_t mask,
-                                  const char     *ntpl_file)
+                                  const char     *ntpl_file,
+                                  const uint32_t copyBreak,
+                                  const uint32_t txMode,
+                                  const uint32_t rxMode,
+                                  const uint32_t numaPool,
+                                  const uint32_t rxWriteback)
 {
   int iRet = 0;
   NtInfoStream_t hInfo = NULL;
@@ -2779,12 +5659,14 @@ static int rte_pmd_init_internals(struct rte_pci_device *dev,
   NtInfo_t *pInfo = NULL;
   struct rte_eth_link pmd_link;
   char name[NTACC_NAME_LEN];
+  char mzName[RTE_MEMZONE_NAMESIZE];
   uint8_t nbPortsOnAdapter = 0;
   uint8_t nbPortsInSystem = 0;
   uint8_t nbAdapters = 0;
   uint8_t adapterNo = 0;
   uint8_t offset = 0;
   uint8_t localPort = 0;
+  int numaNode = dev->device.numa_node;
   struct version_s version;
   int value;
 
@@ -2843,6 +5725,10 @@ static int rte_pmd_init_internals(struct rte_pci_device *dev,
       nbPortsOnAdapter = pInfo->u.adapter_v6.data.numPorts;
       offset = pInfo->u.adapter_v6.data.portOffset;
       adapterNo = i;
+      if (numaNode < 0) {
+        // The PCI bus does not tell the NUMA node. Use the one known by the driver
+        numaNode = pInfo->u.adapter_v6.data.numaNode;
+      }
       break;
     }
   }
@@ -2893,12 +5779,23 @@ static int rte_pmd_init_internals(struct rte_pci_device *dev,
       goto error;
     }
 
-    internals = rte_zmalloc_socket(name, sizeof(struct pmd_internals), RTE_CACHE_LINE_SIZE, dev->device.numa_node);
+    internals = rte_zmalloc_socket(name, sizeof(struct pmd_internals), RTE_CACHE_LINE_SIZE, numaNode);
     if (internals == NULL) {
       iRet = _log_out_of_memory_errors(__func__);
       goto error;
     }
 
+    // The queue statistics are kept in a memzone, so other processes can read them
+    snprintf(mzName, sizeof(mzName), RTE_PMD_NTACC_STATS_MZ_FMT, eth_dev->data->port_id);
+    internals->statsMz = rte_memzone_reserve_aligned(mzName, sizeof(struct rte_pmd_ntacc_stats),
+                                                     numaNode, 0, RTE_CACHE_LINE_SIZE);
+    if (internals->statsMz == NULL) {
+      iRet = _log_out_of_memory_errors(__func__);
+      goto error;
+    }
+    internals->stats = internals->statsMz->addr;
+    memset(internals->stats, 0, sizeof(struct rte_pmd_ntacc_stats));
+
     if (strlen(ntpl_file) > 0) {
       internals->ntpl_file  = rte_zmalloc(name, strlen(ntpl_file) + 1, 0);
       if (internals->ntpl_file == NULL) {
@@ -2928,6 +5825,12 @@ static int rte_pmd_init_internals(struct rte_pci_device *dev,
     internals->fpgaid.value = pInfo->u.port_v7.data.adapterInfo.fpgaid.value;
     internals->minTxPktSize = pInfo->u.port_v7.data.capabilities.minTxPktSize;
     internals->maxTxPktSize = pInfo->u.port_v7.data.capabilities.maxTxPktSize;
+    internals->copyBreak = (uint16_t)RTE_MIN(copyBreak, (uint32_t)UINT16_MAX);
+    internals->numaNode = numaNode;
+    internals->numaPool = numaPool ? 1 : 0;
+    internals->txMode = txMode;
+    internals->rxMode = rxMode;
+    internals->rxWriteback = rxWriteback;
 
     // Check timestamp format
     if (pInfo->u.port_v7.data.adapterInfo.timestampType == NT_TIMESTAMP_TYPE_NATIVE_UNIX) {
@@ -2987,7 +5890,7 @@ static int rte_pmd_init_internals(struct rte_pci_device *dev,
     eth_dev->data->dev_private = internals;
     eth_dev->data->dev_link = pmd_link;
     eth_dev->data->mac_addrs = &eth_addr[internals->port];
-    eth_dev->data->numa_node = dev->device.numa_node;
+    eth_dev->data->numa_node = numaNode;
 
     eth_dev->dev_ops = &ops;
 
@@ -3046,16 +5949,17 @@ static int rte_pmd_init_internals(struct rte_pci_device *dev,
       }
     }
 
-    // Set rx and tx mode according to the adapter capability
-    if (internals->mode2Rx)
-      eth_dev->rx_pkt_burst = eth_ntacc_rx_mode2;
-    else
-      eth_dev->rx_pkt_burst = eth_ntacc_rx_mode1;
+    // Set rx and tx mode according to the adapter capability and the devargs
+    eth_dev->rx_pkt_burst = eth_ntacc_rx_select(internals);
+    internals->rxBurst = eth_dev->rx_pkt_burst;
 
-    if (internals->mode2Tx)
-      eth_dev->tx_pkt_burst = eth_ntacc_tx_mode2;
-    else
-      eth_dev->tx_pkt_burst = eth_ntacc_tx_mode1;
+    if (internals->txMode == NTACC_TX_MODE_SEGMENT) {
+      internals->mode2Tx = 1;
+      internals->txMode = NTACC_TX_MODE_DEFAULT;
+    }
+    if (internals->mode2Tx && internals->txMode != NTACC_TX_MODE_DEFAULT)
+      PMD_NTACC_LOG(WARNING, "%s is not supported by the adapter. Ignored\n", ETH_NTACC_TXMODE_ARG);
+    eth_dev->tx_pkt_burst = eth_ntacc_tx_select(eth_dev);
 
     eth_dev->state = RTE_ETH_DEV_ATTACHED;
 
@@ -3086,8 +5990,11 @@ static int rte_pmd_init_internals(struct rte_pci_device *dev,
   }
   if (hInfo)
     (void)(*_NT_InfoClose)(hInfo);
-  if (internals)
+  if (internals) {
+    if (internals->statsMz)
+      rte_memzone_free(internals->statsMz);
     rte_free(internals);
+  }
   return iRet;
 }
 
@@ -3106,11 +6013,52 @@ static inline int ascii_to_ascii(const char *key __rte_unused, const char *value
   return 0;
 }
 
+static inline int ascii_to_txmode(const char *key, const char *value, void *extra_args)
+{
+  if (strcmp(value, "default") == 0) {
+    *(uint32_t*)extra_args = NTACC_TX_MODE_DEFAULT;
+  }
+  else if (strcmp(value, "stream") == 0) {
+    *(uint32_t*)extra_args = NTACC_TX_MODE_STREAM;
+  }
+  else if (strcmp(value, "segment") == 0) {
+    *(uint32_t*)extra_args = NTACC_TX_MODE_SEGMENT;
+  }
+  else {
+    PMD_NTACC_LOG(ERR, "Unknown %s \"%s\"\n", key, value);
+    return -1;
+  }
+  return 0;
+}
+
+static inline int ascii_to_rxmode(const char *key, const char *value, void *extra_args)
+{
+  uint32_t i;
+
+  for (i = 0; i < RTE_DIM(rxModeNames); i++) {
+    if (strcmp(value, rxModeNames[i]) == 0) {
+      *(uint32_t*)extra_args = i;
+      return 0;
+    }
+  }
+  PMD_NTACC_LOG(ERR, "Unknown %s \"%s\"\n", key, value);
+  return -1;
+}
+
 static int _nt_lib_open(void)
 {
-  char path[128];
-  strcpy(path, NAPATECH3_LIB_PATH);
-  strcat(path, "/libntapi.so");
+  char path[PATH_MAX];
+  const char *lib = getenv(NTACC_NTAPI_LIB_ENV);
+
+  // The library can be replaced, e.g. by a stand-in library for
+  // measuring the PMD without a SmartNIC
+  if (lib != NULL && lib[0] != 0) {
+    strlcpy(path, lib, sizeof(path));
+  }
+  else {
+    snprintf(path, sizeof(path), "%s/libntapi.so", NAPATECH3_LIB_PATH);
+  }
+  PMD_NTACC_LOG(DEBUG, "Loading %s\n", path);
 
   /* Load the library */
   _libnt = dlopen(path, RTLD_NOW);
@@ -3256,6 +6204,11 @@ static int rte_pmd_ntacc_dev_probe(struct rte_pci_driver *drv __rte_unused, stru
   struct rte_kvargs *kvlist;
   unsigned int i;
   uint32_t mask=0xFF;
+  uint32_t copyBreak=0;
+  uint32_t txMode=NTACC_TX_MODE_DEFAULT;
+  uint32_t rxMode=NTACC_RX_MODE_AUTO;
+  uint32_t numaPool=0;
+  uint32_t rxWriteback=0;
 
   char ntplStr[MAX_NTPL_NAME] = { 0 };
 
@@ -3302,20 +6255,70 @@ static int rte_pmd_ntacc_dev_probe(struct rte_pci_driver *drv __rte_unused, stru
     if ((i = rte_kvargs_count(kvlist, ETH_NTACC_MASK_ARG))) {
       assert (i == 1);
       ret = rte_kvargs_process(kvlist, ETH_NTACC_MASK_ARG, &ascii_to_u32, &mask);
+      if (ret < 0)
+        goto free_kvargs;
     }
 
     // Get filename to store ntpl
     if ((i = rte_kvargs_count(kvlist, ETH_NTACC_NTPL_ARG))) {
       assert (i == 1);
       ret = rte_kvargs_process(kvlist, ETH_NTACC_NTPL_ARG, &ascii_to_ascii, ntplStr);
+      if (ret < 0)
+        goto free_kvargs;
+    }
+
+    // Get the size below which packets are copied instead of using external buffers
+    if ((i = rte_kvargs_count(kvlist, ETH_NTACC_COPYBREAK_ARG))) {
+      assert (i == 1);
+      ret = rte_kvargs_process(kvlist, ETH_NTACC_COPYBREAK_ARG, &ascii_to_u32, &copyBreak);
+      if (ret < 0)
+        goto free_kvargs;
+#ifndef USE_EXTERNAL_BUFFER
+      PMD_NTACC_LOG(WARNING, "%s is only used with external buffers. Ignored\n", ETH_NTACC_COPYBREAK_ARG);
+#endif
     }
 
+    // Get the TX mode
+    if ((i = rte_kvargs_count(kvlist, ETH_NTACC_TXMODE_ARG))) {
+      assert (i == 1);
+      ret = rte_kvargs_process(kvlist, ETH_NTACC_TXMODE_ARG, &ascii_to_txmode, &txMode);
+      if (ret < 0)
+        goto free_kvargs;
+    }
+
+    // Select the RX function
+    if ((i = rte_kvargs_count(kvlist, ETH_NTACC_RXMODE_ARG))) {
+      assert (i == 1);
+      ret = rte_kvargs_process(kvlist, ETH_NTACC_RXMODE_ARG, &ascii_to_rxmode, &rxMode);
+      if (ret < 0)
+        goto free_kvargs;
+    }
+
+    // Create RX mempools on the adapter NUMA node
+    if ((i = rte_kvargs_count(kvlist, ETH_NTACC_NUMAPOOL_ARG))) {
+      assert (i == 1);
+      ret = rte_kvargs_process(kvlist, ETH_NTACC_NUMAPOOL_ARG, &ascii_to_u32, &numaPool);
+      if (ret < 0)
+        goto free_kvargs;
+    }
+
+    // Bytes read from an RX ring before the read offset is written back
+    if ((i = rte_kvargs_count(kvlist, ETH_NTACC_RXWB_ARG))) {
+      assert (i == 1);
+      ret = rte_kvargs_process(kvlist, ETH_NTACC_RXWB_ARG, &ascii_to_u32, &rxWriteback);
+      if (ret < 0)
+        goto free_kvargs;
+    }
+
+free_kvargs:
     rte_kvargs_free(kvlist);
+    // Fail on the first argument that does not parse
+    if (ret < 0) {
+      PMD_NTACC_LOG(ERR, "Invalid device arguments for %s: %s\n", dev->device.name, dev->device.devargs->args);
+      return -1;
+    }
   }
 
-  if (ret < 0)
-    return -1;
-
   if (first == 0) {
     ret = _nt_lib_open();
     if (ret < 0)
@@ -3328,7 +6331,7 @@ static int rte_pmd_ntacc_dev_probe(struct rte_pci_driver *drv __rte_unused, stru
     first++;
   }
 
-  if (rte_pmd_init_internals(dev, mask, ntplStr) < 0)
+  if (rte_pmd_init_internals(dev, mask, ntplStr, copyBreak, txMode, rxMode, numaPool, rxWriteback) < 0)
     return -1;
 
   return 0;
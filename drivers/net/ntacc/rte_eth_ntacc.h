@@ -35,8 +35,14 @@
 #define __RTE_ETH_NTACC_H__
 
 #include <rte_ethdev_pci.h>
+#include <rte_flow.h>
+
+#include "rte_pmd_ntacc.h"
 
 #define SEGMENT_LENGTH  (1024*1024)
+#define NTACC_RX_SEG_STASH 64  /* mbufs reserved per RX queue for jumbo segments */
+#define NTACC_MAX_NUMA_POOLS 16 /* RX mempool copies on the adapter NUMA node per port */
+#define NTACC_MAX_PENDING_NUMA_POOLS 64 /* Copies of closed ports waiting for their mbufs to be returned */
 
 //#define NTACC_LOCK(a)    { printf(" Req Lock %s(%p) - %u\n", __FILE__, a, __LINE__); rte_spinlock_lock(a); printf(" Got Lock %s(%p) - %u\n", __FILE__, a, __LINE__); }
 //#define NTACC_UNLOCK(a)  { rte_spinlock_unlock(a); printf("Unlocked %s(%p) - %u\n", __FILE__, a, __LINE__); }
@@ -56,11 +62,32 @@ struct filter_hash_s {
   uint32_t ntpl_id;
 };
 
+#define NTACC_KEYSET_BUCKETS 256  /* Buckets in the keyset lookup table. Power of 2 */
+
+/**
+ * Capture options of the assign command of a flow.
+ */
+struct capture_s {
+  uint32_t sample;   // Deliver 1 of sample packets. 0 or 1 delivers all packets
+  uint16_t slice;    // Snap length of the packets. 0 delivers the full packets
+};
+
+/**
+ * Software shadow of a keyset programmed in the adapter. The keyset is found
+ * by hashing typeMask, port, queues, capture options and color delivery, and
+ * is shared by all flows with the same values. The flows also share the
+ * assign command.
+ */
 struct filter_keyset_s {
   LIST_ENTRY(filter_keyset_s) next;
   uint32_t ntpl_id1;
   uint32_t ntpl_id2;
+  uint32_t assign_ntpl_id;  // Assign command shared by the flows
+  uint32_t refcnt;          // Number of flows using the keyset
+  uint32_t hash;
   uint64_t typeMask;
+  struct capture_s capture; // Capture options of the shared assign command
+  bool     colorInfo;       // The key type delivers the color of the KeyList
   uint8_t  key;
   uint8_t  port;
   uint8_t nb_queues;
@@ -78,6 +105,69 @@ struct rte_flow {
   int priority;
   uint8_t nb_queues;
   uint8_t list_queues[256];
+  struct filter_keyset_s *keyset; // Shared keyset. NULL if none
+  uint8_t count;            // The flow has a COUNT action
+  uint8_t counter;          // Color counter used by the COUNT action or color of the MARK id
+  uint8_t countPending:1;   // The counter base is taken at the first query
+  uint8_t mark:1;           // The flow holds the color of its MARK id
+  uint64_t hitsBase;        // Counter values at flow creation or last reset
+  uint64_t bytesBase;
+  struct ntacc_flow_op_s *createOp; // Asynchronous create not done yet
+  struct rte_pmd_ntacc_shunt *shunt; // Shunt table of the flow. NULL if none
+  int32_t shuntPos;                  // Position of the flow in the shunt table
+};
+
+/* A flow in a shunt table */
+struct ntacc_shunt_entry_s {
+  struct rte_pmd_ntacc_shunt_key key;
+  struct rte_flow *flow;
+  uint64_t expire;                   // Timer cycle count when the flow times out
+};
+
+/**
+ * Shunt table. The flows are inserted through a TCP and a UDP flow
+ * template, and looked up by their 5-tuple in a hash table.
+ */
+struct rte_pmd_ntacc_shunt {
+  LIST_ENTRY(rte_pmd_ntacc_shunt) next;
+  struct rte_pmd_ntacc_flow_template *tcp;
+  struct rte_pmd_ntacc_flow_template *udp;
+  struct rte_hash *hash;
+  struct ntacc_shunt_entry_s *entries; // Indexed by the position in the hash table
+  uint32_t max_entries;
+  uint32_t ageNext;                  // Where the next ageing scan starts
+  uint64_t timeout;                  // Flow lifetime in timer cycles. 0 if flows do not time out
+};
+
+/**
+ * Asynchronous flow operation.
+ */
+struct ntacc_flow_op_s {
+  TAILQ_ENTRY(ntacc_flow_op_s) next;
+  struct rte_flow *flow;
+  void *user_data;
+  uint8_t destroy;                  // Destroy the flow, else create it
+  uint8_t cancelled;                // The flow is destroyed in the same batch as it is created
+  int status;
+  struct rte_flow_error error;
+  struct rte_flow_conv_rule *rule;  // Copy of the rule to create
+};
+TAILQ_HEAD(ntacc_flow_op_list_s, ntacc_flow_op_s);
+
+/**
+ * Asynchronous flow operations are enqueued by the application, pushed to
+ * the flow thread in batches and pulled by the application when done.
+ */
+struct ntacc_flow_queue_s {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  pthread_t thread;
+  int run;
+  struct ntacc_flow_op_list_s enqueued;
+  struct ntacc_flow_op_list_s pushed;
+  struct ntacc_flow_op_list_s done;
+  char *ntpl_buf;                   // Scratch buffers reused by all flows
+  char *filter_buf1;
 };
 
 enum {
@@ -85,29 +175,86 @@ enum {
   SYM_HASH_ENA_PER_PORT,
 };
 
+#ifdef USE_EXTERNAL_BUFFER
+/**
+ * Release tracker for external buffers. Packets are numbered in the order they
+ * are received. A released packet sets its bit in the completion bitmap and the
+ * HW read pointer is moved past all packets released so far without a gap.
+ */
+struct ntacc_rx_release_s {
+  rte_spinlock_t lock;
+  uint64_t       mask;    /* Number of entries - 1 */
+  uint64_t      *done;    /* Completion bitmap, one bit per entry */
+  uint64_t      *offR;    /* Read offset after each packet */
+};
+#endif
+
+/* Time a merged stream with no data holds back the other streams */
+#define NTACC_RX_MERGE_IDLE_US 1000
+
+/* A stream read by a merged RX queue */
+struct ntacc_rx_merge_stream_s {
+  NtNetStreamRx_t        pNetRx;
+  NtNetBuf_t             pSeg;    /* The current segment. NULL if none */
+  struct NtNetBuf_s      pkt;     /* The current packet in pSeg */
+  uint64_t               lastTs;  /* Timestamp of the last packet returned from the stream */
+  uint64_t               idle;    /* Timer cycles when the stream ran out of data. 0 if it has data */
+  uint32_t               stream_id;
+};
+
+/* A copy of an application RX mempool on the adapter NUMA node */
+struct ntacc_numa_pool_s {
+  struct rte_mempool    *src;     /* Pool given by the application */
+  struct rte_mempool    *pool;    /* Copy used by the RX queues instead of src */
+};
+
+/* Streams merged into one RX queue in timestamp order. Stream 0 is the queue's own stream */
+struct ntacc_rx_merge_s {
+  uint16_t               nb_streams;
+  uint64_t               idleTimeout;  /* NTACC_RX_MERGE_IDLE_US in timer cycles */
+  struct ntacc_rx_merge_stream_s stream[RTE_PMD_NTACC_MAX_MERGE_STREAMS + 1];
+};
+
 struct ntacc_rx_queue {
   uint64_t iCnt;
   uint64_t oCnt;
   uint64_t offW;
   uint64_t offR;
+  uint64_t mbuf_initializer;      /* Rearm template used by the vector RX paths */
+  uint32_t wbPending;             /* Bytes read from the ring since the read offset was written back */
+  uint32_t wbThreshold;           /* Bytes read before the read offset is written back */
   struct NtNetRxHbRing_s ringControl;
   NtNetBuf_t             pSeg;    /* The current segment we are working with */
   NtNetStreamRx_t        pNetRx;
   struct rte_mempool    *mb_pool;
+  struct rte_mempool    *seg_pool;  /* Pool of the 2nd and later segments of jumbo frames */
   uint32_t               in_port;
   struct NtNetBuf_s      pkt;     /* The current packet */
+#ifdef USE_EXTERNAL_BUFFER
+  struct ntacc_rx_release_s release;
+#endif
+  struct rte_pmd_ntacc_queue_stats *stats;  /* Counters in the statistics memzone */
 #ifdef USE_SW_STAT
-  volatile uint64_t      rx_pkts;
-  volatile uint64_t      rx_bytes;
-  volatile uint64_t      err_pkts;
+  uint64_t               basePkts;    /* Counter values at the last stats reset */
+  uint64_t               baseBytes;
 #endif
 
   uint32_t               stream_id;
 	int                    stream_assigned;
   uint16_t               buf_size;
+  uint16_t               seg_size;
+  uint16_t               segStashCnt;
+  struct rte_mbuf        *segStash[NTACC_RX_SEG_STASH];
+#ifdef USE_EXTERNAL_BUFFER
+  uint16_t               copyBreak;   /* Packets smaller than this are copied */
+#endif
   int                     enabled;
   uint8_t                local_port;
   uint8_t                tsMultiplier;
+  uint8_t                mode2Rx;     /* Segments are read with NT_NetRxGet */
+  struct ntacc_rx_merge_s *merge;     /* Streams merged into the queue. NULL if not merged */
+  eth_rx_burst_t         rxBurst;     /* RX function used when the queue is not merged */
+  int                    hbNumaNode;  /* NUMA node of the host buffers of the stream. -1 if unknown */
   const char             *name;
   const char             *type;
 } __rte_cache_aligned;
@@ -115,19 +262,75 @@ struct ntacc_rx_queue {
 struct ntacc_tx_queue {
   struct NtNetTxHbRing_s ringControl;
   NtNetStreamTx_t        pNetTx;
+  struct rte_pmd_ntacc_queue_stats *stats;  /* Counters in the statistics memzone */
 #ifdef USE_SW_STAT
-  volatile uint64_t      tx_pkts;
-  volatile uint64_t      tx_bytes;
+  uint64_t               basePkts;    /* Counter values at the last stats reset */
+  uint64_t               baseBytes;
+  uint64_t               baseErrors;
 #endif
-  volatile uint64_t      err_pkts;
   volatile uint16_t     *plock;
+  uint8_t               *pSetClock;   /* Set if the next timestamped packet on the port sets the TX clock */
   uint32_t               port;
   uint16_t               minTxPktSize;
   uint16_t               maxTxPktSize;
   uint8_t                local_port;
+  uint8_t                tsDivider;   /* Converts the mbuf timestamp in ns to adapter time */
   int                    enabled;
+  uint64_t               tsFlag;      /* TX timestamp dynflag. 0 if send on timestamp is off */
 } __rte_cache_aligned;
 
+/**
+ * Add to the counters of a queue. Only one thread writes the counters of a
+ * queue. The sequence count is odd while they change, so readers in other
+ * processes can take a consistent snapshot without a lock.
+ */
+static __rte_always_inline void ntacc_stats_add(struct rte_pmd_ntacc_queue_stats *stats,
+                                                uint64_t pkts, uint64_t bytes, uint64_t errors)
+{
+  const uint32_t seq = stats->seq;
+
+  __atomic_store_n(&stats->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&stats->pkts, stats->pkts + pkts, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats->bytes, stats->bytes + bytes, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats->errors, stats->errors + errors, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * Write the read offset of an RX ring back to the adapter. The writeback
+ * is skipped until wbThreshold bytes have been read, which saves a cache
+ * line transfer to the adapter driver on most bursts. A drained ring is
+ * always written back, so the adapter gets all the room when the queue
+ * goes idle.
+ */
+static __rte_always_inline void ntacc_rx_writeback(struct ntacc_rx_queue *rx_q, uint64_t offR, uint64_t offW)
+{
+  const uint64_t last = rx_q->offR;
+
+  rx_q->wbPending += (uint32_t)(offR >= last ? offR - last : offR + 2 * rx_q->ringControl.size - last);
+  if (rx_q->wbPending >= rx_q->wbThreshold || offR == offW) {
+    *rx_q->ringControl.pRead = offR;
+    rx_q->wbPending = 0;
+  }
+}
+
+/**
+ * Set the counters of a queue. Same rules as ntacc_stats_add().
+ */
+static __rte_always_inline void ntacc_stats_set(struct rte_pmd_ntacc_queue_stats *stats,
+                                                uint64_t pkts, uint64_t bytes, uint64_t errors)
+{
+  const uint32_t seq = stats->seq;
+
+  __atomic_store_n(&stats->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&stats->pkts, pkts, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats->bytes, bytes, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats->errors, errors, __ATOMIC_RELAXED);
+  __atomic_store_n(&stats->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
 struct pmd_shared_mem_s {
   pthread_mutex_t mutex;
   int keyset[8][12];
@@ -140,6 +343,8 @@ struct version_s {
     int32_t patch;
 };
 
+#define NTACC_MAX_FILTER_VALUES 32  /* Key values in the pattern of one flow */
+
 struct filter_values_s {
 	LIST_ENTRY(filter_values_s) next;
   uint64_t mask;
@@ -176,22 +381,35 @@ struct filter_values_s {
 struct pmd_internals {
   struct ntacc_rx_queue *rxq;
   struct ntacc_tx_queue *txq;
+  uint16_t              nbRxQueues;
   uint32_t              nbStreamIDs;
   uint32_t              streamIDOffset;
   uint64_t              rss_hf;
   struct rte_flow       *defaultFlow;
+  eth_rx_burst_t        rxBurst;          // RX function of queues that are not merged
 #ifndef USE_SW_STAT
   NtStatStream_t        hStat;
+  NtStatistics_t        *statSnapshot;    // Double buffered statistics snapshot
+  uint32_t              statGen;          // Generation of the latest snapshot
+  int                   statThreadRun;
+  pthread_t             statThread;
 #endif
   NtConfigStream_t      hCfgStream;
+  struct ntacc_flow_queue_s *flowq;
+  const struct rte_memzone *statsMz;    // Memzone with the queue statistics
+  struct rte_pmd_ntacc_stats *stats;
   int                   if_index;
   LIST_HEAD(_flows, rte_flow) flows;
   LIST_HEAD(filter_values_t, filter_values_s) filter_values;
+  struct filter_values_s filterValuePool[NTACC_MAX_FILTER_VALUES]; // Storage of the filter_values list
+  uint8_t               nbFilterValues;
   LIST_HEAD(filter_hash_t, filter_hash_s) filter_hash;
-  LIST_HEAD(filter_keyset_t, filter_keyset_s) filter_keyset;
+  LIST_HEAD(filter_keyset_t, filter_keyset_s) filter_keyset[NTACC_KEYSET_BUCKETS];
+  LIST_HEAD(_flow_templates, rte_pmd_ntacc_flow_template) templates;
+  LIST_HEAD(_shunts, rte_pmd_ntacc_shunt) shunts;
   rte_spinlock_t        lock;
   rte_spinlock_t        statlock;
-  rte_spinlock_t        configlock;
+  rte_spinlock_t        configlock;   // Always taken before lock
   uint8_t               port;
   uint8_t               local_port;
   uint8_t               local_port_offset;
@@ -210,12 +428,35 @@ struct pmd_internals {
   key_t                 key;
   uint16_t              minTxPktSize;
   uint16_t              maxTxPktSize;
+  uint16_t              copyBreak;
+  uint32_t              txMode;
+  uint32_t              rxMode;
+  uint32_t              rxWriteback;      // Bytes read from an RX ring before the read offset is written back
+  int                   numaNode;         // NUMA node of the adapter
+  uint16_t              nbNumaPools;
+  struct ntacc_numa_pool_s numaPools[NTACC_MAX_NUMA_POOLS]; // Kept until the port is closed
   pthread_mutexattr_t   psharedm;
   struct pmd_shared_mem_s *shm;
   uint32_t              dropId;
   uint32_t              keyMatcher:1;
   uint32_t              mode2Tx:1;
   uint32_t              mode2Rx:1;
+  uint32_t              numaPool:1;       // Create RX mempools on the adapter NUMA node
+};
+
+enum {
+  NTACC_TX_MODE_DEFAULT,  /* Copy packets to the TX ring */
+  NTACC_TX_MODE_STREAM,   /* Copy packets using non-temporal stores */
+  NTACC_TX_MODE_SEGMENT,  /* Send packets through NT_NetTxGet segments */
+};
+
+enum {
+  NTACC_RX_MODE_AUTO,     /* Selected from the adapter, the build and the CPU */
+  NTACC_RX_MODE_SEGMENT,  /* Read segments with NT_NetRxGet */
+  NTACC_RX_MODE_SCALAR,   /* Read the RX ring */
+  NTACC_RX_MODE_SSE,      /* Read the RX ring with the vector RX functions */
+  NTACC_RX_MODE_AVX2,
+  NTACC_RX_MODE_AVX512,
 };
 
 enum {
@@ -224,6 +465,7 @@ enum {
   ACTION_DROP      = 1 << 2,
   ACTION_FORWARD   = 1 << 3,
   ACTION_HASH      = 1 << 4,
+  ACTION_COUNT     = 1 << 5,
 };
 
 
@@ -244,7 +486,6 @@ struct supportedAdapters_s {
 #ifdef USE_EXTERNAL_BUFFER
 struct externalBufferInfo_s {
   struct ntacc_rx_queue           *rx_q;
-  uint64_t                        offR;
   struct rte_mbuf_ext_shared_info shinfo;
   uint64_t cnt;
 };
@@ -252,6 +493,24 @@ struct externalBufferInfo_s {
 
 int DoNtpl(const char *ntplStr, uint32_t *pNtplID, struct pmd_internals *internals, struct rte_flow_error *error);
 
+void eth_ntacc_rx_get_ring(struct ntacc_rx_queue *rx_q);
+uint16_t eth_ntacc_rx_jumbo(struct ntacc_rx_queue *rx_q, struct rte_mbuf *mbuf, const u_char *data, uint16_t data_len);
+#ifndef USE_EXTERNAL_BUFFER
+#ifdef RTE_ARCH_X86
+uint16_t eth_ntacc_rx_mode1_sse(void *queue, struct rte_mbuf **bufs, const uint16_t nb_pkts);
+#ifdef CC_AVX2_SUPPORT
+uint16_t eth_ntacc_rx_mode1_avx2(void *queue, struct rte_mbuf **bufs, const uint16_t nb_pkts);
+#endif
+#ifdef CC_AVX512_SUPPORT
+uint16_t eth_ntacc_rx_mode1_avx512(void *queue, struct rte_mbuf **bufs, const uint16_t nb_pkts);
+#endif
+#endif
+#endif
+
+extern bool enable_ts[RTE_MAX_ETHPORTS];
+extern uint64_t timestamp_rx_dynflag;
+extern int timestamp_dynfield_offset;
+
 extern int ntacc_logtype;
 
 #define PMD_NTACC_LOG(level, fmt, args...) rte_log(RTE_LOG_ ## level, ntacc_logtype, \
@@ -0,0 +1,234 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2010-2014 Intel Corporation. All rights reserved.
+ *   Copyright(c) 2014 6WIND S.A.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __RTE_ETH_NTACC_VEC_H__
+#define __RTE_ETH_NTACC_VEC_H__
+
+#include <rte_mbuf.h>
+#include <rte_memcpy.h>
+#include <rte_prefetch.h>
+#include <rte_vect.h>
+#include <nt.h>
+
+#include "rte_eth_ntacc.h"
+
+/**
+ * Common part of the vector mode1 RX paths. Each ISA specific file includes
+ * this header and is compiled with its own -m flags, so both the mbuf stores
+ * below and the rte_memcpy of the payload use the widest registers available.
+ */
+
+/* Number of descriptors walked and prefetched ahead of the conversion */
+#define NTACC_VEC_RX_LOOKAHEAD 8
+
+/* Offload flags indexed by the dyn3 descriptor length */
+static const uint64_t ntacc_vec_rx_ol_flags[64] = {
+  [22] = PKT_RX_FDIR_ID | PKT_RX_FDIR,
+  [24] = PKT_RX_FDIR_FLX | PKT_RX_FDIR,
+  [26] = PKT_RX_RSS_HASH,
+};
+
+/**
+ * Convert one dyn3 descriptor into the mbuf. Same result as the scalar
+ * eth_ntacc_convert_pkt_to_mbuf, but the descriptor length switch is replaced
+ * by select masks and the mbuf header is written with whole vector stores:
+ * rearm_data, ol_flags and rx_descriptor_fields1 are adjacent in the mbuf.
+ * The dyn3 bit layout is owned by the NTAPI header, so the fields are still
+ * extracted through NtDyn3Descr_t.
+ */
+static __rte_always_inline uint16_t ntacc_vec_rx_convert(NtDyn3Descr_t *dyn3,
+                                                         struct rte_mbuf *mbuf,
+                                                         struct ntacc_rx_queue *rx_q,
+                                                         uint64_t rearm,
+                                                         uint64_t ts_flag)
+{
+  const uint32_t descrLength = dyn3->descrLength;
+  const uint32_t color = (uint32_t)(((dyn3->color_hi << 14) & 0xFFFFC000) | dyn3->color_lo);
+  const uint16_t data_len = (uint16_t)(dyn3->capLength - descrLength);
+
+  /* All ones when the descriptor is of the given length */
+  const uint32_t is22 = -(uint32_t)(descrLength == 22);
+  const uint32_t is24 = -(uint32_t)(descrLength == 24);
+  const uint32_t is26 = -(uint32_t)(descrLength == 26);
+  /* A colormask descriptor only carries fdir values for a known protocol */
+  const uint32_t fdir24 = is24 & -(uint32_t)(color != 0);
+
+  const uint32_t ptype = color & is24;
+  const uint32_t hash_lo = ((uint32_t)dyn3->offset0 & fdir24) | ((uint32_t)dyn3->color_hi & is26);
+  const uint32_t hash_hi = (color & is22) | ((uint32_t)dyn3->offset1 & fdir24);
+  const uint64_t ol_flags = (ntacc_vec_rx_ol_flags[descrLength] & -(uint64_t)((is24 & ~fdir24) == 0)) | ts_flag;
+
+  /* Port is the upper 16 bits of rearm_data */
+  rearm += (uint64_t)(dyn3->rxPort - rx_q->local_port) << 48;
+
+  RTE_BUILD_BUG_ON(offsetof(struct rte_mbuf, ol_flags) !=
+                   offsetof(struct rte_mbuf, rearm_data) + 8);
+  RTE_BUILD_BUG_ON(offsetof(struct rte_mbuf, rx_descriptor_fields1) !=
+                   offsetof(struct rte_mbuf, rearm_data) + 16);
+  RTE_BUILD_BUG_ON(offsetof(struct rte_mbuf, pkt_len) !=
+                   offsetof(struct rte_mbuf, rx_descriptor_fields1) + 4);
+  RTE_BUILD_BUG_ON(offsetof(struct rte_mbuf, data_len) !=
+                   offsetof(struct rte_mbuf, rx_descriptor_fields1) + 8);
+  RTE_BUILD_BUG_ON(offsetof(struct rte_mbuf, hash) !=
+                   offsetof(struct rte_mbuf, rx_descriptor_fields1) + 12);
+
+  /* packet_type | pkt_len, data_len | vlan_tci | hash.rss/fdir.lo */
+  const uint64_t fields_lo = ptype | ((uint64_t)data_len << 32);
+  const uint64_t fields_hi = data_len | ((uint64_t)hash_lo << 32);
+#ifdef __AVX2__
+  _mm256_storeu_si256((__m256i *)&mbuf->rearm_data,
+                      _mm256_set_epi64x(fields_hi, fields_lo, ol_flags, rearm));
+#else
+  _mm_storeu_si128((__m128i *)&mbuf->rearm_data, _mm_set_epi64x(ol_flags, rearm));
+  _mm_storeu_si128((__m128i *)&mbuf->rx_descriptor_fields1, _mm_set_epi64x(fields_hi, fields_lo));
+#endif
+  mbuf->hash.fdir.hi = hash_hi;
+
+  if (ts_flag) {
+    *RTE_MBUF_DYNFIELD(mbuf, timestamp_dynfield_offset, rte_mbuf_timestamp_t *) =
+      dyn3->timestamp * rx_q->tsMultiplier;
+  }
+
+  if (likely(data_len <= rx_q->buf_size)) {
+    rte_memcpy((u_char *)mbuf->buf_addr + mbuf->data_off, (uint8_t*)dyn3 + descrLength, data_len);
+#ifdef COPY_OFFSET0
+    mbuf->data_off += dyn3->offset0;
+#endif
+    return data_len;
+  }
+  /* Try read jumbo frame into multi mbufs. */
+  return eth_ntacc_rx_jumbo(rx_q, mbuf, (uint8_t*)dyn3 + descrLength, data_len);
+}
+
+/**
+ * The mode1 RX burst. The descriptor chain is walked up to
+ * NTACC_VEC_RX_LOOKAHEAD packets ahead, prefetching payloads and mbufs,
+ * before the packets are converted.
+ */
+static __rte_always_inline uint16_t ntacc_vec_rx_mode1(void *queue,
+                                                       struct rte_mbuf **bufs,
+                                                       const uint16_t nb_pkts)
+{
+  struct ntacc_rx_queue *rx_q = queue;
+  NtDyn3Descr_t *dyn3[NTACC_VEC_RX_LOOKAHEAD];
+
+  if (unlikely(rx_q->pNetRx == NULL || nb_pkts == 0)) {
+    return 0;
+  }
+
+  if (unlikely(rx_q->ringControl.ring == NULL)) {
+    eth_ntacc_rx_get_ring(rx_q);
+    return 0;
+  }
+
+  uint64_t offR = rx_q->offR;
+  uint64_t offW = rx_q->offW;
+
+  /* Check if we have packets */
+  if (unlikely(offR == offW)) {
+    rx_q->offW = *rx_q->ringControl.pWrite & rx_q->ringControl.mask;
+    return 0;
+  }
+
+  /* Allocate buffers */
+  if (unlikely(rte_mempool_get_bulk(rx_q->mb_pool, (void **)bufs, nb_pkts) != 0)) {
+    return 0;
+  }
+
+  const uint64_t ringSize = 2 * rx_q->ringControl.size;
+  const uint64_t rearm = rx_q->mbuf_initializer;
+  const uint64_t ts_flag = enable_ts[rx_q->in_port] ? timestamp_rx_dynflag : 0;
+  uint16_t num_rx = 0;
+  uint32_t bytes = 0;
+  uint8_t *ring;
+  if (offR > rx_q->ringControl.size) {
+    ring = rx_q->ringControl.ring + (offR - rx_q->ringControl.size);
+  }
+  else {
+    ring = rx_q->ringControl.ring + offR;
+  }
+
+  while ((offR != offW) && (num_rx < nb_pkts)) {
+    const unsigned int room = RTE_MIN(nb_pkts - num_rx, NTACC_VEC_RX_LOOKAHEAD);
+    unsigned int nb = 0;
+    unsigned int i;
+
+    /* Walk the descriptors of this batch and start fetching the packets */
+    while ((offR != offW) && (nb < room)) {
+      NtDyn3Descr_t *pDescr = (NtDyn3Descr_t*)(ring);
+      const uint32_t capLength = pDescr->capLength;
+
+      dyn3[nb] = pDescr;
+      rte_prefetch0(ring + RTE_CACHE_LINE_SIZE);
+      rte_prefetch0(&bufs[num_rx + nb]->rearm_data);
+      nb++;
+
+      offR += capLength;
+      ring += capLength;
+      if (offR >= ringSize) {
+        offR -= ringSize;
+      }
+      rte_prefetch0(ring);
+    }
+
+    for (i = 0; i < nb; i++) {
+      bytes += ntacc_vec_rx_convert(dyn3[i], bufs[num_rx + i], rx_q, rearm, ts_flag);
+    }
+    num_rx += nb;
+
+    if (unlikely(offR == offW) && num_rx < nb_pkts && offW == rx_q->offW) {
+      // The window is used up. Read the write offset once more, so a busy
+      // ring is not left for the next burst
+      offW = *rx_q->ringControl.pWrite & rx_q->ringControl.mask;
+    }
+  }
+
+  /* Refresh the HW pointer */
+  ntacc_rx_writeback(rx_q, offR, offW);
+  rx_q->offR = offR;
+  rx_q->offW = offW;
+
+#ifdef USE_SW_STAT
+  ntacc_stats_add(rx_q->stats, num_rx, bytes, 0);
+#else
+  RTE_SET_USED(bytes);
+#endif
+
+  if (unlikely(num_rx < nb_pkts)) {
+    rte_mempool_put_bulk(rx_q->mb_pool, (void * const *)(bufs + num_rx), nb_pkts-num_rx);
+  }
+  return num_rx;
+}
+
+#endif
@@ -0,0 +1,589 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright(c) 2010-2014 Intel Corporation. All rights reserved.
+ *   Copyright(c) 2014 6WIND S.A.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __RTE_PMD_NTACC_H__
+#define __RTE_PMD_NTACC_H__
+
+/**
+ * @file rte_pmd_ntacc.h
+ *
+ * Napatech SmartNIC PMD specific functions.
+ */
+
+#include <stdio.h>
+
+#include <rte_compat.h>
+#include <rte_common.h>
+#include <rte_flow.h>
+#include <rte_memzone.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Name of the memzone with the queue statistics of a port. Takes the port id. */
+#define RTE_PMD_NTACC_STATS_MZ_FMT "ntacc_stats_%u"
+
+/** Maximum number of RX or TX queues of a port. */
+#define RTE_PMD_NTACC_MAX_QUEUES 256
+
+/** Maximum number of streams merged into an RX queue besides its own stream. */
+#define RTE_PMD_NTACC_MAX_MERGE_STREAMS 7
+
+/**
+ * Counters of one queue. Each queue has its own cache line, and only one
+ * thread writes it. The sequence count is odd while the counters are
+ * updated. Use rte_pmd_ntacc_queue_stats_read() to read them.
+ */
+struct rte_pmd_ntacc_queue_stats {
+  uint32_t seq;     /**< Sequence count. Odd while the counters are updated. */
+  uint64_t pkts;    /**< Packets received or sent. */
+  uint64_t bytes;   /**< Bytes received or sent. */
+  uint64_t errors;  /**< Packets dropped (RX) or failed (TX). */
+} __rte_cache_aligned;
+
+/**
+ * Queue statistics of a port, kept in the memzone named by
+ * RTE_PMD_NTACC_STATS_MZ_FMT. The counters are never reset, so they can be
+ * read by secondary processes and monitoring tools without IPC and
+ * without locks.
+ *
+ * With software statistics the counters are updated by the RX and TX
+ * bursts. Otherwise the RX counters are copied from the adapter statistics
+ * every 100 ms, and only the TX errors are counted.
+ */
+struct rte_pmd_ntacc_stats {
+  uint16_t nb_rx_queues;  /**< Number of configured RX queues. */
+  uint16_t nb_tx_queues;  /**< Number of configured TX queues. */
+  struct rte_pmd_ntacc_queue_stats rxq[RTE_PMD_NTACC_MAX_QUEUES];
+  struct rte_pmd_ntacc_queue_stats txq[RTE_PMD_NTACC_MAX_QUEUES];
+};
+
+/**
+ * Find the queue statistics of a port. Can be called from a primary or a
+ * secondary process.
+ *
+ * @param port_id
+ *   The port identifier of the Ethernet device.
+ *
+ * @return
+ *   The queue statistics, or NULL if the port is not a Napatech port.
+ */
+static inline const struct rte_pmd_ntacc_stats *
+rte_pmd_ntacc_stats_lookup(uint16_t port_id)
+{
+  char name[RTE_MEMZONE_NAMESIZE];
+  const struct rte_memzone *mz;
+
+  snprintf(name, sizeof(name), RTE_PMD_NTACC_STATS_MZ_FMT, port_id);
+  mz = rte_memzone_lookup(name);
+  return mz != NULL ? (const struct rte_pmd_ntacc_stats *)mz->addr : NULL;
+}
+
+/**
+ * Take a consistent snapshot of the counters of a queue. The read is
+ * retried if the counters are updated while reading.
+ *
+ * @param stats
+ *   Counters of the queue.
+ * @param snapshot
+ *   Copy of the counters.
+ */
+static inline void
+rte_pmd_ntacc_queue_stats_read(const struct rte_pmd_ntacc_queue_stats *stats,
+                               struct rte_pmd_ntacc_queue_stats *snapshot)
+{
+  uint32_t seq;
+
+  do {
+    seq = __atomic_load_n(&stats->seq, __ATOMIC_ACQUIRE);
+    snapshot->pkts = __atomic_load_n(&stats->pkts, __ATOMIC_RELAXED);
+    snapshot->bytes = __atomic_load_n(&stats->bytes, __ATOMIC_RELAXED);
+    snapshot->errors = __atomic_load_n(&stats->errors, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while ((seq & 1) != 0 || seq != __atomic_load_n(&stats->seq, __ATOMIC_RELAXED));
+  snapshot->seq = seq;
+}
+
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice.
+ *
+ * Query the counters of a number of flows with a COUNT action in one call.
+ * The counters of all flows are read from the same statistics snapshot.
+ * The snapshot is updated every 100 ms.
+ *
+ * @param port_id
+ *   The port identifier of the Ethernet device.
+ * @param flows
+ *   Array of nb_flows flows created on port_id.
+ * @param counts
+ *   Array of nb_flows counters. The reset field of each counter is an input
+ *   as for rte_flow_query().
+ * @param nb_flows
+ *   Number of flows to query.
+ * @param error
+ *   Perform verbose error reporting if not NULL.
+ *
+ * @return
+ *   - (0) if successful.
+ *   - (-ENODEV) if *port_id* is invalid.
+ *   - (-ENOTSUP) if the port is not a Napatech port or counters are not supported.
+ *   - (-EINVAL) if a flow has no COUNT action.
+ *   - (-EIO) if the statistics are not available.
+ */
+__rte_experimental
+int rte_pmd_ntacc_flow_query_count(uint16_t port_id,
+                                   struct rte_flow **flows,
+                                   struct rte_flow_query_count *counts,
+                                   uint32_t nb_flows,
+                                   struct rte_flow_error *error);
+
+/**
+ * Result of an asynchronous flow operation returned by rte_pmd_ntacc_flow_pull().
+ */
+struct rte_pmd_ntacc_flow_result {
+  struct rte_flow *flow;       /**< Flow handle. NULL if a create failed. */
+  void *user_data;             /**< User data given when the operation was enqueued. */
+  int status;                  /**< 0 on success, otherwise a negative errno. */
+  struct rte_flow_error error; /**< Error details if status is not 0. */
+};
+
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice.
+ *
+ * Enqueue the creation of a flow. The flow is programmed into the adapter
+ * by a control thread after rte_pmd_ntacc_flow_push() is called. All
+ * operations pushed together are programmed as one batch. The rule is
+ * copied, so it can be reused as soon as the function returns.
+ *
+ * The returned handle must not be used before the result of the create has
+ * been pulled with status 0. The only exception is
+ * rte_pmd_ntacc_flow_destroy_async() when the destroy is pushed in the same
+ * batch as the create.
+ *
+ * @param port_id
+ *   The port identifier of the Ethernet device.
+ * @param attr
+ *   Flow rule attributes.
+ * @param pattern
+ *   Pattern specification (list terminated by the END pattern item).
+ * @param actions
+ *   Associated actions (list terminated by the END action).
+ * @param user_data
+ *   Returned in the result of the operation.
+ * @param error
+ *   Perform verbose error reporting if not NULL.
+ *
+ * @return
+ *   A flow handle on success, NULL otherwise and rte_errno is set.
+ */
+__rte_experimental
+struct rte_flow *rte_pmd_ntacc_flow_create_async(uint16_t port_id,
+                                                 const struct rte_flow_attr *attr,
+                                                 const struct rte_flow_item pattern[],
+                                                 const struct rte_flow_action actions[],
+                                                 void *user_data,
+                                                 struct rte_flow_error *error);
+
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice.
+ *
+ * Enqueue the destruction of a flow. If the create of the flow is pushed in
+ * the same batch, the flow is never programmed into the adapter and the
+ * create completes with status -ECANCELED.
+ *
+ * @param port_id
+ *   The port identifier of the Ethernet device.
+ * @param flow
+ *   Flow handle to destroy.
+ * @param user_data
+ *   Returned in the result of the operation.
+ * @param error
+ *   Perform verbose error reporting if not NULL.
+ *
+ * @return
+ *   0 on success, a negative errno value otherwise.
+ */
+__rte_experimental
+int rte_pmd_ntacc_flow_destroy_async(uint16_t port_id,
+                                     struct rte_flow *flow,
+                                     void *user_data,
+                                     struct rte_flow_error *error);
+
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice.
+ *
+ * Hand all enqueued flow operations to the control thread as one batch.
+ *
+ * @param port_id
+ *   The port identifier of the Ethernet device.
+ * @param error
+ *   Perform verbose error reporting if not NULL.
+ *
+ * @return
+ *   0 on success, a negative errno value otherwise.
+ */
+__rte_experimental
+int rte_pmd_ntacc_flow_push(uint16_t port_id, struct rte_flow_error *error);
+
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice.
+ *
+ * Get the results of completed flow operations. Results are returned in
+ * the order the operations were enqueued.
+ *
+ * @param port_id
+ *   The port identifier of the Ethernet device.
+ * @param res
+ *   Array of nb_res results to fill.
+ * @param nb_res
+ *   Maximum number of results to return.
+ * @param error
+ *   Perform verbose error reporting if not NULL.
+ *
+ * @return
+ *   The number of results returned, a negative errno value on error.
+ */
+__rte_experimental
+int rte_pmd_ntacc_flow_pull(uint16_t port_id,
+                            struct rte_pmd_ntacc_flow_result res[],
+                            uint16_t nb_res,
+                            struct rte_flow_error *error);
+
+/**
+ * Flow template. Opaque handle returned by rte_pmd_ntacc_flow_template_create().
+ */
+struct rte_pmd_ntacc_flow_template;
+
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice.
+ *
+ * Create a flow template. The attributes, the actions and the shape of the
+ * pattern are compiled once into a keyset and an assign command. Flows
+ * inserted through the template only add their key values to the keyset.
+ *
+ * The fields of the pattern with a value define the key. The values
+ * themselves are not added as a flow. The pattern must have at least one
+ * field with a value.
+ *
+ * @param port_id
+ *   The port identifier of the Ethernet device.
+ * @param attr
+ *   Flow rule attributes.
+ * @param pattern
+ *   Pattern specification (list terminated by the END pattern item).
+ * @param actions
+ *   Associated actions (list terminated by the END action).
+ * @param error
+ *   Perform verbose error reporting if not NULL.
+ *
+ * @return
+ *   A template handle on success, NULL otherwise and rte_errno is set.
+ */
+__rte_experimental
+struct rte_pmd_ntacc_flow_template *rte_pmd_ntacc_flow_template_create(uint16_t port_id,
+                                                                       const struct rte_flow_attr *attr,
+                                                                       const struct rte_flow_item pattern[],
+                                                                       const struct rte_flow_action actions[],
+                                                                       struct rte_flow_error *error);
+
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice.
+ *
+ * Create a flow through a flow template. The pattern must have the same
+ * item types and the same fields with a value as the template pattern.
+ * Only the values may differ. The ports and NTPL items of the template
+ * pattern are used. The flow is destroyed with rte_flow_destroy().
+ *
+ * @param port_id
+ *   The port identifier of the Ethernet device.
+ * @param tmpl
+ *   Flow template created on port_id.
+ * @param pattern
+ *   Pattern specification (list terminated by the END pattern item).
+ * @param error
+ *   Perform verbose error reporting if not NULL.
+ *
+ * @return
+ *   A flow handle on success, NULL otherwise and rte_errno is set.
+ */
+__rte_experimental
+struct rte_flow *rte_pmd_ntacc_flow_template_insert(uint16_t port_id,
+                                                    struct rte_pmd_ntacc_flow_template *tmpl,
+                                                    const struct rte_flow_item pattern[],
+                                                    struct rte_flow_error *error);
+
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice.
+ *
+ * Destroy a flow template. Flows inserted through the template are not
+ * destroyed. Templates are destroyed when the port is closed.
+ *
+ * @param port_id
+ *   The port identifier of the Ethernet device.
+ * @param tmpl
+ *   Flow template to destroy.
+ * @param error
+ *   Perform verbose error reporting if not NULL.
+ *
+ * @return
+ *   0 on success, a negative errno value otherwise.
+ */
+__rte_experimental
+int rte_pmd_ntacc_flow_template_destroy(uint16_t port_id,
+                                        struct rte_pmd_ntacc_flow_template *tmpl,
+                                        struct rte_flow_error *error);
+
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice.
+ *
+ * Merge adapter streams into an RX queue. The queue reads its own stream
+ * and the given streams, and returns the packets in timestamp order. This
+ * gives time ordered capture from several ports or adapters on one core.
+ * Packets are directed to the streams with NTPL assign commands.
+ *
+ * The port must be stopped and the queue set up. The merge is kept until
+ * it is changed or the queue is set up again.
+ *
+ * @param port_id
+ *   The port identifier of the Ethernet device.
+ * @param queue_id
+ *   The RX queue to merge the streams into.
+ * @param stream_ids
+ *   Adapter stream IDs to merge into the queue.
+ * @param nb_streams
+ *   Number of stream IDs. At most RTE_PMD_NTACC_MAX_MERGE_STREAMS.
+ *   0 removes the merge.
+ *
+ * @return
+ *   0 on success, a negative errno value otherwise.
+ */
+__rte_experimental
+int rte_pmd_ntacc_rx_merge_streams(uint16_t port_id,
+                                   uint16_t queue_id,
+                                   const uint32_t stream_ids[],
+                                   uint16_t nb_streams);
+
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice.
+ *
+ * Get the NUMA node of the host buffers of an RX queue. The host buffers
+ * are assigned to the queue when the port is started. For the best
+ * throughput the queue should be polled from a core on this node. The
+ * node of the queue mempool is given by rte_eth_rx_queue_info_get().
+ *
+ * @param port_id
+ *   The port identifier of the Ethernet device.
+ * @param queue_id
+ *   The RX queue.
+ * @param[out] numa_node
+ *   NUMA node of the host buffers. SOCKET_ID_ANY if it is not known.
+ *
+ * @return
+ *   0 on success, a negative errno value otherwise.
+ */
+__rte_experimental
+int rte_pmd_ntacc_rx_queue_numa(uint16_t port_id,
+                                uint16_t queue_id,
+                                int *numa_node);
+
+/**
+ * 5-tuple of a shunted flow. The fields are in network byte order.
+ */
+struct rte_pmd_ntacc_shunt_key {
+  rte_be32_t src_addr;  /**< IPv4 source address. */
+  rte_be32_t dst_addr;  /**< IPv4 destination address. */
+  rte_be16_t src_port;  /**< TCP or UDP source port. */
+  rte_be16_t dst_port;  /**< TCP or UDP destination port. */
+  uint8_t proto;        /**< IPPROTO_TCP or IPPROTO_UDP. */
+  uint8_t reserved[3];  /**< Must be zero. */
+};
+
+/**
+ * Configuration of a shunt table.
+ */
+struct rte_pmd_ntacc_shunt_conf {
+  uint32_t max_entries;   /**< Maximum number of flows in the table. */
+  uint32_t timeout;       /**< Seconds a flow is kept after it is added. 0 to keep it until removed. */
+  uint32_t priority;      /**< Priority of the flows. See rte_flow_attr. */
+  const struct rte_flow_action *actions;  /**< Actions of the flows, e.g. DROP. Ends with END. */
+};
+
+/**
+ * Shunt table. Opaque handle returned by rte_pmd_ntacc_shunt_create().
+ */
+struct rte_pmd_ntacc_shunt;
+
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice.
+ *
+ * Create a shunt table. A shunt table holds IPv4 TCP and UDP flows, which
+ * all get the same actions in the adapter. It is meant for flows the
+ * application has seen enough of, e.g. to drop the rest of a TCP session
+ * in the adapter after its first packets.
+ *
+ * The flows are inserted through flow templates, so adding a flow is a
+ * single key insert in the adapter. The functions of a table must not be
+ * called from several threads at the same time.
+ *
+ * @param port_id
+ *   The port identifier of the Ethernet device.
+ * @param conf
+ *   Table configuration.
+ * @param error
+ *   Perform verbose error reporting if not NULL.
+ *
+ * @return
+ *   The shunt table or NULL with rte_errno set.
+ */
+__rte_experimental
+struct rte_pmd_ntacc_shunt *rte_pmd_ntacc_shunt_create(uint16_t port_id,
+                                                       const struct rte_pmd_ntacc_shunt_conf *conf,
+                                                       struct rte_flow_error *error);
+
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice.
+ *
+ * Add flows to a shunt table. A flow already in the table gets a new
+ * timeout.
+ *
+ * @param port_id
+ *   The port identifier of the Ethernet device.
+ * @param shunt
+ *   Shunt table.
+ * @param keys
+ *   Flows to add.
+ * @param nb_keys
+ *   Number of flows.
+ * @param error
+ *   Perform verbose error reporting if not NULL.
+ *
+ * @return
+ *   Number of flows added. If less than nb_keys, error is set for the
+ *   first flow that was not added.
+ */
+__rte_experimental
+int rte_pmd_ntacc_shunt_add(uint16_t port_id,
+                            struct rte_pmd_ntacc_shunt *shunt,
+                            const struct rte_pmd_ntacc_shunt_key keys[],
+                            uint16_t nb_keys,
+                            struct rte_flow_error *error);
+
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice.
+ *
+ * Remove flows from a shunt table. Flows that are not in the table are
+ * ignored.
+ *
+ * @param port_id
+ *   The port identifier of the Ethernet device.
+ * @param shunt
+ *   Shunt table.
+ * @param keys
+ *   Flows to remove.
+ * @param nb_keys
+ *   Number of flows.
+ *
+ * @return
+ *   Number of flows removed, a negative errno value on error.
+ */
+__rte_experimental
+int rte_pmd_ntacc_shunt_remove(uint16_t port_id,
+                               struct rte_pmd_ntacc_shunt *shunt,
+                               const struct rte_pmd_ntacc_shunt_key keys[],
+                               uint16_t nb_keys);
+
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice.
+ *
+ * Remove the timed out flows of a shunt table. Each call checks up to
+ * max_scan flows and goes on where the last call stopped, so the cost of
+ * a call is bounded. Call it regularly, e.g. from the main loop.
+ *
+ * @param port_id
+ *   The port identifier of the Ethernet device.
+ * @param shunt
+ *   Shunt table.
+ * @param max_scan
+ *   Maximum number of flows to check.
+ *
+ * @return
+ *   Number of flows removed, a negative errno value on error.
+ */
+__rte_experimental
+int rte_pmd_ntacc_shunt_age(uint16_t port_id,
+                            struct rte_pmd_ntacc_shunt *shunt,
+                            uint32_t max_scan);
+
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice.
+ *
+ * Destroy a shunt table and all its flows. Tables are destroyed when the
+ * port is closed.
+ *
+ * @param port_id
+ *   The port identifier of the Ethernet device.
+ * @param shunt
+ *   Shunt table to destroy.
+ * @param error
+ *   Perform verbose error reporting if not NULL.
+ *
+ * @return
+ *   0 on success, a negative errno value otherwise.
+ */
+__rte_experimental
+int rte_pmd_ntacc_shunt_destroy(uint16_t port_id,
+                                struct rte_pmd_ntacc_shunt *shunt,
+                                struct rte_flow_error *error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RTE_PMD_NTACC_H__ */
@@ -2480,6 +2480,13 @@ enum rte_flow_action_type {
 	 * See struct rte_flow_action_meter_color.
 	 */
 	RTE_FLOW_ACTION_TYPE_METER_COLOR,
+
+	/**
+	 * Slice the packets to a snap length before they are delivered.
+	 *
+	 * See struct rte_flow_action_slice.
+	 */
+	RTE_FLOW_ACTION_TYPE_SLICE,
 };
 
 /**
@@ -3391,6 +3398,17 @@ struct rte_flow_action_sample {
 		/**< sub-action list specific for the sampling hit cases. */
 };
 
+/**
+ * RTE_FLOW_ACTION_TYPE_SLICE
+ *
+ * Slice the matching packets to a snap length. Only the first
+ * length bytes of a packet are delivered to the host. Packets
+ * shorter than the snap length are delivered unchanged.
+ */
+struct rte_flow_action_slice {
+	uint16_t length; /**< Snap length in bytes. */
+};
+
 /**
  * Verbose error types.
  *
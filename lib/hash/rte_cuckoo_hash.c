@@ -11,6 +11,7 @@
 #include <sys/queue.h>
 
 #include <rte_common.h>
+#include <rte_cycles.h>
 #include <rte_memory.h>         /* for definition of RTE_CACHE_LINE_SIZE */
 #include <rte_log.h>
 #include <rte_prefetch.h>
@@ -32,6 +33,14 @@
 #include "rte_hash.h"
 #include "rte_cuckoo_hash.h"
 
+#if defined(RTE_ARCH_X86)
+#include "rte_cmp_x86.h"
+#endif
+
+#if defined(RTE_ARCH_ARM64)
+#include "rte_cmp_arm64.h"
+#endif
+
 /* Mask of all flags supported by this version */
 #define RTE_HASH_EXTRA_FLAGS_MASK (RTE_HASH_EXTRA_FLAGS_TRANS_MEM_SUPPORT | \
 				   RTE_HASH_EXTRA_FLAGS_MULTI_WRITER_ADD | \
@@ -45,6 +54,30 @@
 		CURRENT_BKT != NULL;                                          \
 		CURRENT_BKT = CURRENT_BKT->next)
 
+/*
+ * Table storing all different key compare functions
+ * (multi-process supported)
+ */
+#if defined(RTE_ARCH_X86) || defined(RTE_ARCH_ARM64)
+static const rte_hash_cmp_eq_t cmp_jump_table[NUM_KEY_CMP_CASES] = {
+	NULL,
+	rte_hash_k16_cmp_eq,
+	rte_hash_k32_cmp_eq,
+	rte_hash_k48_cmp_eq,
+	rte_hash_k64_cmp_eq,
+	rte_hash_k80_cmp_eq,
+	rte_hash_k96_cmp_eq,
+	rte_hash_k112_cmp_eq,
+	rte_hash_k128_cmp_eq,
+	memcmp
+};
+#else
+static const rte_hash_cmp_eq_t cmp_jump_table[NUM_KEY_CMP_CASES] = {
+	NULL,
+	memcmp
+};
+#endif
+
 TAILQ_HEAD(rte_hash_list, rte_tailq_entry);
 
 static struct rte_tailq_elem rte_hash_tailq = {
@@ -134,6 +167,57 @@ get_alt_bucket_index(const struct rte_hash *h,
 	return (cur_bkt_idx ^ sig) & h->bucket_bitmask;
 }
 
+/*
+ * Bucket tables are allocated with one extra bucket in front of them,
+ * holding a header with the bitmask of the table and its key store.
+ */
+static inline struct rte_hash_bucket_hdr *
+bucket_table_hdr(const struct rte_hash_bucket *buckets)
+{
+	return (struct rte_hash_bucket_hdr *)(uintptr_t)(buckets - 1);
+}
+
+static struct rte_hash_bucket *
+bucket_table_alloc(uint32_t num_buckets, int socket_id)
+{
+	struct rte_hash_bucket *tbl;
+
+	tbl = rte_zmalloc_socket(NULL,
+			(num_buckets + 1) * sizeof(struct rte_hash_bucket),
+			RTE_CACHE_LINE_SIZE, socket_id);
+	if (tbl == NULL)
+		return NULL;
+
+	bucket_table_hdr(tbl + 1)->bucket_bitmask = num_buckets - 1;
+	return tbl + 1;
+}
+
+static void
+bucket_table_free(struct rte_hash_bucket *buckets)
+{
+	if (buckets != NULL)
+		rte_free(buckets - 1);
+}
+
+/*
+ * Readers load the bucket table once and take the bitmask and the key
+ * store from its header, so that neither an index nor a key index is
+ * ever applied to a table of another size swapped in by
+ * rte_hash_resize().
+ */
+static inline struct rte_hash_bucket *
+get_bucket_table(const struct rte_hash *h, uint32_t *bitmask,
+		 const struct rte_hash_key **key_store)
+{
+	struct rte_hash_bucket *buckets =
+			__atomic_load_n(&h->buckets, __ATOMIC_ACQUIRE);
+	const struct rte_hash_bucket_hdr *hdr = bucket_table_hdr(buckets);
+
+	*bitmask = hdr->bucket_bitmask;
+	*key_store = hdr->key_store;
+	return buckets;
+}
+
 struct rte_hash *
 rte_hash_create(const struct rte_hash_parameters *params)
 {
@@ -144,7 +228,7 @@ rte_hash_create(const struct rte_hash_parameters *params)
 	struct rte_ring *r_ext = NULL;
 	char hash_name[RTE_HASH_NAMESIZE];
 	void *k = NULL;
-	void *buckets = NULL;
+	struct rte_hash_bucket *buckets = NULL;
 	void *buckets_ext = NULL;
 	char ring_name[RTE_RING_NAMESIZE];
 	char ext_ring_name[RTE_RING_NAMESIZE];
@@ -293,9 +377,7 @@ rte_hash_create(const struct rte_hash_parameters *params)
 		goto err_unlock;
 	}
 
-	buckets = rte_zmalloc_socket(NULL,
-				num_buckets * sizeof(struct rte_hash_bucket),
-				RTE_CACHE_LINE_SIZE, params->socket_id);
+	buckets = bucket_table_alloc(num_buckets, params->socket_id);
 
 	if (buckets == NULL) {
 		RTE_LOG(ERR, HASH, "buckets memory allocation failed\n");
@@ -415,6 +497,7 @@ rte_hash_create(const struct rte_hash_parameters *params)
 	h->key_entry_size = key_entry_size;
 	h->hash_func_init_val = params->hash_func_init_val;
 
+	h->socket_id = params->socket_id;
 	h->num_buckets = num_buckets;
 	h->bucket_bitmask = h->num_buckets - 1;
 	h->buckets = buckets;
@@ -423,6 +506,7 @@ rte_hash_create(const struct rte_hash_parameters *params)
 	h->hash_func = (params->hash_func == NULL) ?
 		default_hash_func : params->hash_func;
 	h->key_store = k;
+	bucket_table_hdr(buckets)->key_store = k;
 	h->free_slots = r;
 	h->ext_bkt_to_free = ext_bkt_to_free;
 	h->tbl_chng_cnt = tbl_chng_cnt;
@@ -437,6 +521,12 @@ rte_hash_create(const struct rte_hash_parameters *params)
 	h->readwrite_concur_lf_support = readwrite_concur_lf_support;
 
 #if defined(RTE_ARCH_X86)
+#if defined(CC_AVX2_SUPPORT) && RTE_HASH_BUCKET_ENTRIES >= 8
+	if (rte_cpu_get_flag_enabled(RTE_CPUFLAG_AVX2) &&
+			rte_vect_get_max_simd_bitwidth() >= RTE_VECT_SIMD_256)
+		h->sig_cmp_fn = RTE_HASH_COMPARE_AVX2;
+	else
+#endif
 	if (rte_cpu_get_flag_enabled(RTE_CPUFLAG_SSE2))
 		h->sig_cmp_fn = RTE_HASH_COMPARE_SSE;
 	else
@@ -477,7 +567,7 @@ rte_hash_create(const struct rte_hash_parameters *params)
 	rte_free(te);
 	rte_free(local_free_slots);
 	rte_free(h);
-	rte_free(buckets);
+	bucket_table_free(buckets);
 	rte_free(buckets_ext);
 	rte_free(k);
 	rte_free(tbl_chng_cnt);
@@ -516,6 +606,13 @@ rte_hash_free(struct rte_hash *h)
 	if (h->dq)
 		rte_rcu_qsbr_dq_delete(h->dq);
 
+	if (h->aging) {
+		rte_free(h->aging->last_seen);
+		rte_free(h->aging->next);
+		rte_free(h->aging->wheel);
+		rte_free(h->aging);
+	}
+
 	if (h->use_local_cache)
 		rte_free(h->local_free_slots);
 	if (h->writer_takes_lock)
@@ -523,7 +620,7 @@ rte_hash_free(struct rte_hash *h)
 	rte_ring_free(h->free_slots);
 	rte_ring_free(h->free_ext_bkts);
 	rte_free(h->key_store);
-	rte_free(h->buckets);
+	bucket_table_free(h->buckets);
 	rte_free(h->buckets_ext);
 	rte_free(h->tbl_chng_cnt);
 	rte_free(h->ext_bkt_to_free);
@@ -636,6 +733,15 @@ rte_hash_reset(struct rte_hash *h)
 	memset(h->key_store, 0, h->key_entry_size * (h->entries + 1));
 	*h->tbl_chng_cnt = 0;
 
+	if (h->aging) {
+		for (i = 0; i < h->entries + 1; i++)
+			h->aging->next[i] = AGING_NOT_QUEUED;
+		memset(h->aging->wheel, 0,
+			(h->aging->wheel_mask + 1) * sizeof(uint32_t));
+		h->aging->cur_tick = rte_get_timer_cycles() >>
+					h->aging->tick_shift;
+	}
+
 	/* reset the free ring */
 	rte_ring_reset(h->free_slots);
 
@@ -1004,12 +1110,36 @@ alloc_slot(const struct rte_hash *h, struct lcore_cache *cached_free_slots)
 	return slot_id;
 }
 
+/* Link a key index into the aging wheel bucket of the given time */
+static inline void
+aging_enqueue(struct rte_hash_aging *a, uint32_t key_idx, uint64_t expiry)
+{
+	uint64_t tick = RTE_MAX(expiry >> a->tick_shift, a->cur_tick);
+	uint32_t b = tick & a->wheel_mask;
+
+	a->next[key_idx] = a->wheel[b];
+	a->wheel[b] = key_idx;
+}
+
+/* Start the idle time of a newly added key */
+static inline void
+aging_insert(const struct rte_hash *h, uint32_t key_idx, uint64_t now)
+{
+	struct rte_hash_aging *a = h->aging;
+
+	__atomic_store_n(&a->last_seen[key_idx], now, __ATOMIC_RELAXED);
+	/* The index of a deleted key stays queued until it is walked */
+	if (a->next[key_idx] == AGING_NOT_QUEUED)
+		aging_enqueue(a, key_idx, now + a->timeout);
+}
+
+/* Add a key whose bucket indexes have already been computed */
 static inline int32_t
-__rte_hash_add_key_with_hash(const struct rte_hash *h, const void *key,
-						hash_sig_t sig, void *data)
+__rte_hash_add_key_with_idx(const struct rte_hash *h, const void *key,
+			hash_sig_t sig, void *data,
+			uint32_t prim_bucket_idx, uint32_t sec_bucket_idx)
 {
 	uint16_t short_sig;
-	uint32_t prim_bucket_idx, sec_bucket_idx;
 	struct rte_hash_bucket *prim_bkt, *sec_bkt, *cur_bkt;
 	struct rte_hash_key *new_k, *keys = h->key_store;
 	uint32_t ext_bkt_id = 0;
@@ -1022,12 +1152,8 @@ __rte_hash_add_key_with_hash(const struct rte_hash *h, const void *key,
 	struct rte_hash_bucket *last;
 
 	short_sig = get_short_sig(sig);
-	prim_bucket_idx = get_prim_bucket_index(h, sig);
-	sec_bucket_idx = get_alt_bucket_index(h, prim_bucket_idx, short_sig);
 	prim_bkt = &h->buckets[prim_bucket_idx];
 	sec_bkt = &h->buckets[sec_bucket_idx];
-	rte_prefetch0(prim_bkt);
-	rte_prefetch0(sec_bkt);
 
 	/* Check if key is already inserted in primary location */
 	__hash_rw_writer_lock(h);
@@ -1079,6 +1205,9 @@ __rte_hash_add_key_with_hash(const struct rte_hash *h, const void *key,
 	/* Copy key */
 	memcpy(new_k->key, key, h->key_len);
 
+	if (h->aging)
+		aging_insert(h, slot_id, rte_get_timer_cycles());
+
 	/* Find an empty slot and insert */
 	ret = rte_hash_cuckoo_insert_mw(h, prim_bkt, sec_bkt, key, data,
 					short_sig, slot_id, &ret_val);
@@ -1197,6 +1326,22 @@ __rte_hash_add_key_with_hash(const struct rte_hash *h, const void *key,
 
 }
 
+static inline int32_t
+__rte_hash_add_key_with_hash(const struct rte_hash *h, const void *key,
+						hash_sig_t sig, void *data)
+{
+	uint32_t prim_bucket_idx, sec_bucket_idx;
+
+	prim_bucket_idx = get_prim_bucket_index(h, sig);
+	sec_bucket_idx = get_alt_bucket_index(h, prim_bucket_idx,
+					get_short_sig(sig));
+	rte_prefetch0(&h->buckets[prim_bucket_idx]);
+	rte_prefetch0(&h->buckets[sec_bucket_idx]);
+
+	return __rte_hash_add_key_with_idx(h, key, sig, data,
+					prim_bucket_idx, sec_bucket_idx);
+}
+
 int32_t
 rte_hash_add_key_with_hash(const struct rte_hash *h,
 			const void *key, hash_sig_t sig)
@@ -1242,17 +1387,18 @@ rte_hash_add_key_data(const struct rte_hash *h, const void *key, void *data)
 
 /* Search one bucket to find the match key - uses rw lock */
 static inline int32_t
-search_one_bucket_l(const struct rte_hash *h, const void *key,
+search_one_bucket_l(const struct rte_hash *h,
+		const struct rte_hash_key *keys, const void *key,
 		uint16_t sig, void **data,
 		const struct rte_hash_bucket *bkt)
 {
 	int i;
-	struct rte_hash_key *k, *keys = h->key_store;
+	const struct rte_hash_key *k;
 
 	for (i = 0; i < RTE_HASH_BUCKET_ENTRIES; i++) {
 		if (bkt->sig_current[i] == sig &&
 				bkt->key_idx[i] != EMPTY_SLOT) {
-			k = (struct rte_hash_key *) ((char *)keys +
+			k = (const struct rte_hash_key *) ((const char *)keys +
 					bkt->key_idx[i] * h->key_entry_size);
 
 			if (rte_hash_cmp_eq(key, k->key, h) == 0) {
@@ -1271,12 +1417,13 @@ search_one_bucket_l(const struct rte_hash *h, const void *key,
 
 /* Search one bucket to find the match key */
 static inline int32_t
-search_one_bucket_lf(const struct rte_hash *h, const void *key, uint16_t sig,
+search_one_bucket_lf(const struct rte_hash *h, const struct rte_hash_key *keys,
+			const void *key, uint16_t sig,
 			void **data, const struct rte_hash_bucket *bkt)
 {
 	int i;
 	uint32_t key_idx;
-	struct rte_hash_key *k, *keys = h->key_store;
+	const struct rte_hash_key *k;
 
 	for (i = 0; i < RTE_HASH_BUCKET_ENTRIES; i++) {
 		/* Signature comparison is done before the acquire-load
@@ -1290,7 +1437,8 @@ search_one_bucket_lf(const struct rte_hash *h, const void *key, uint16_t sig,
 			key_idx = __atomic_load_n(&bkt->key_idx[i],
 					  __ATOMIC_ACQUIRE);
 			if (key_idx != EMPTY_SLOT) {
-				k = (struct rte_hash_key *) ((char *)keys +
+				k = (const struct rte_hash_key *) (
+						(const char *)keys +
 						key_idx * h->key_entry_size);
 
 				if (rte_hash_cmp_eq(key, k->key, h) == 0) {
@@ -1316,30 +1464,33 @@ __rte_hash_lookup_with_hash_l(const struct rte_hash *h, const void *key,
 				hash_sig_t sig, void **data)
 {
 	uint32_t prim_bucket_idx, sec_bucket_idx;
-	struct rte_hash_bucket *bkt, *cur_bkt;
+	struct rte_hash_bucket *buckets, *bkt, *cur_bkt;
+	const struct rte_hash_key *key_store;
+	uint32_t bitmask;
 	int ret;
 	uint16_t short_sig;
 
-	short_sig = get_short_sig(sig);
-	prim_bucket_idx = get_prim_bucket_index(h, sig);
-	sec_bucket_idx = get_alt_bucket_index(h, prim_bucket_idx, short_sig);
+	__hash_rw_reader_lock(h);
 
-	bkt = &h->buckets[prim_bucket_idx];
+	buckets = get_bucket_table(h, &bitmask, &key_store);
+	short_sig = get_short_sig(sig);
+	prim_bucket_idx = sig & bitmask;
+	sec_bucket_idx = (prim_bucket_idx ^ short_sig) & bitmask;
 
-	__hash_rw_reader_lock(h);
+	bkt = &buckets[prim_bucket_idx];
 
 	/* Check if key is in primary location */
-	ret = search_one_bucket_l(h, key, short_sig, data, bkt);
+	ret = search_one_bucket_l(h, key_store, key, short_sig, data, bkt);
 	if (ret != -1) {
 		__hash_rw_reader_unlock(h);
 		return ret;
 	}
 	/* Calculate secondary hash */
-	bkt = &h->buckets[sec_bucket_idx];
+	bkt = &buckets[sec_bucket_idx];
 
 	/* Check if key is in secondary location */
 	FOR_EACH_BUCKET(cur_bkt, bkt) {
-		ret = search_one_bucket_l(h, key, short_sig,
+		ret = search_one_bucket_l(h, key_store, key, short_sig,
 					data, cur_bkt);
 		if (ret != -1) {
 			__hash_rw_reader_unlock(h);
@@ -1357,14 +1508,14 @@ __rte_hash_lookup_with_hash_lf(const struct rte_hash *h, const void *key,
 					hash_sig_t sig, void **data)
 {
 	uint32_t prim_bucket_idx, sec_bucket_idx;
-	struct rte_hash_bucket *bkt, *cur_bkt;
+	struct rte_hash_bucket *buckets, *bkt, *cur_bkt;
+	const struct rte_hash_key *key_store;
+	uint32_t bitmask;
 	uint32_t cnt_b, cnt_a;
 	int ret;
 	uint16_t short_sig;
 
 	short_sig = get_short_sig(sig);
-	prim_bucket_idx = get_prim_bucket_index(h, sig);
-	sec_bucket_idx = get_alt_bucket_index(h, prim_bucket_idx, short_sig);
 
 	do {
 		/* Load the table change counter before the lookup
@@ -1374,18 +1525,24 @@ __rte_hash_lookup_with_hash_lf(const struct rte_hash *h, const void *key,
 		cnt_b = __atomic_load_n(h->tbl_chng_cnt,
 				__ATOMIC_ACQUIRE);
 
+		/* The table may have been resized since the last try */
+		buckets = get_bucket_table(h, &bitmask, &key_store);
+		prim_bucket_idx = sig & bitmask;
+		sec_bucket_idx = (prim_bucket_idx ^ short_sig) & bitmask;
+
 		/* Check if key is in primary location */
-		bkt = &h->buckets[prim_bucket_idx];
-		ret = search_one_bucket_lf(h, key, short_sig, data, bkt);
+		bkt = &buckets[prim_bucket_idx];
+		ret = search_one_bucket_lf(h, key_store, key, short_sig,
+					   data, bkt);
 		if (ret != -1)
 			return ret;
 		/* Calculate secondary hash */
-		bkt = &h->buckets[sec_bucket_idx];
+		bkt = &buckets[sec_bucket_idx];
 
 		/* Check if key is in secondary location */
 		FOR_EACH_BUCKET(cur_bkt, bkt) {
-			ret = search_one_bucket_lf(h, key, short_sig,
-						data, cur_bkt);
+			ret = search_one_bucket_lf(h, key_store, key,
+						short_sig, data, cur_bkt);
 			if (ret != -1)
 				return ret;
 		}
@@ -1578,6 +1735,352 @@ rte_hash_rcu_qsbr_add(struct rte_hash *h, struct rte_hash_rcu_config *cfg)
 	return 0;
 }
 
+/*
+ * Place the key at position @key_idx of the key store of @t in the bucket
+ * tables of @t. @t describes the tables being built by rte_hash_resize(),
+ * which no other thread sees yet. The same cuckoo path search as in
+ * __rte_hash_add_key_with_idx() is used, so the new tables reach the load
+ * of a table filled by rte_hash_add_key().
+ */
+static int
+resize_insert(const struct rte_hash *t, uint32_t *ext_idx, hash_sig_t sig,
+		uint32_t key_idx)
+{
+	const struct rte_hash_key *k = RTE_PTR_ADD(t->key_store,
+			(size_t)key_idx * t->key_entry_size);
+	const struct rte_hash_key *key = (const void *)k->key;
+	struct rte_hash_bucket *prim_bkt, *sec_bkt, *cur_bkt;
+	uint32_t prim_bucket_idx, sec_bucket_idx;
+	uint16_t short_sig;
+	int32_t ret_val;
+	unsigned int i;
+
+	short_sig = get_short_sig(sig);
+	prim_bucket_idx = get_prim_bucket_index(t, sig);
+	sec_bucket_idx = get_alt_bucket_index(t, prim_bucket_idx, short_sig);
+	prim_bkt = &t->buckets[prim_bucket_idx];
+	sec_bkt = &t->buckets[sec_bucket_idx];
+
+	if (rte_hash_cuckoo_insert_mw(t, prim_bkt, sec_bkt, key, k->pdata,
+			short_sig, key_idx, &ret_val) == 0)
+		return 0;
+	if (rte_hash_cuckoo_make_space_mw(t, prim_bkt, sec_bkt, key, k->pdata,
+			short_sig, prim_bucket_idx, key_idx, &ret_val) == 0)
+		return 0;
+	if (rte_hash_cuckoo_make_space_mw(t, sec_bkt, prim_bkt, key, k->pdata,
+			short_sig, sec_bucket_idx, key_idx, &ret_val) == 0)
+		return 0;
+
+	if (!t->ext_table_support)
+		return -ENOSPC;
+
+	FOR_EACH_BUCKET(cur_bkt, sec_bkt) {
+		for (i = 0; i < RTE_HASH_BUCKET_ENTRIES; i++) {
+			if (cur_bkt->key_idx[i] == EMPTY_SLOT) {
+				cur_bkt->sig_current[i] = short_sig;
+				cur_bkt->key_idx[i] = key_idx;
+				return 0;
+			}
+		}
+	}
+
+	/* Link the next unused extendable bucket */
+	if (*ext_idx > t->num_buckets)
+		return -ENOSPC;
+	cur_bkt = &t->buckets_ext[*ext_idx - 1];
+	(*ext_idx)++;
+	cur_bkt->sig_current[0] = short_sig;
+	cur_bkt->key_idx[0] = key_idx;
+	rte_hash_get_last_bkt(sec_bkt)->next = cur_bkt;
+	return 0;
+}
+
+/*
+ * Recreate a defer queue of the default size so that it keeps holding
+ * all the entries of a grown table. The queue is empty when called.
+ */
+static void
+resize_rcu_qsbr_dq(struct rte_hash *h, uint32_t size)
+{
+	struct rte_rcu_qsbr_dq_parameters params = {0};
+	char rcu_dq_name[RTE_RCU_QSBR_DQ_NAMESIZE];
+
+	if (rte_rcu_qsbr_dq_delete(h->dq) != 0)
+		return;
+
+	snprintf(rcu_dq_name, sizeof(rcu_dq_name), "HASH_RCU_%s", h->name);
+	params.name = rcu_dq_name;
+	params.size = size;
+	params.trigger_reclaim_limit = h->hash_rcu_cfg->trigger_reclaim_limit;
+	params.max_reclaim_size = h->hash_rcu_cfg->max_reclaim_size;
+	params.esize = sizeof(struct __rte_hash_rcu_dq_entry);
+	params.free_fn = __hash_rcu_qsbr_free_resource;
+	params.p = h;
+	params.v = h->hash_rcu_cfg->v;
+	h->dq = rte_rcu_qsbr_dq_create(&params);
+	if (h->dq == NULL) {
+		/* Try to get the previous queue back */
+		params.size = h->hash_rcu_cfg->dq_size;
+		h->dq = rte_rcu_qsbr_dq_create(&params);
+		if (h->dq == NULL)
+			RTE_LOG(ERR, HASH, "HASH defer queue creation failed, "
+				"deleted entries are reclaimed synchronously\n");
+		return;
+	}
+	h->hash_rcu_cfg->dq_size = size;
+}
+
+int
+rte_hash_resize(struct rte_hash *h, uint32_t entries)
+{
+	struct rte_hash_bucket *buckets = NULL, *buckets_ext = NULL;
+	struct rte_hash_bucket *old_buckets, *old_buckets_ext, *cur_bkt;
+	struct rte_ring *r = NULL, *r_ext = NULL;
+	struct rte_ring *old_r = NULL, *old_r_ext = NULL;
+	struct rte_hash_key *key_slot;
+	struct rte_hash t;
+	char ring_name[RTE_RING_NAMESIZE];
+	uint32_t *ext_bkt_to_free = NULL, *old_ext_bkt_to_free;
+	uint32_t *free_idx = NULL;
+	void *k = NULL, *old_k;
+	uint32_t num_key_slots, old_key_slots, num_buckets, tbl_chng_cnt = 0;
+	uint32_t num_free, num_low, n, i, j, key_idx, ext_idx = 1;
+	unsigned int pending;
+	int ret;
+
+	RETURN_IF_TRUE((h == NULL), -EINVAL);
+	if ((entries > RTE_HASH_ENTRIES_MAX) ||
+			(entries < RTE_HASH_BUCKET_ENTRIES))
+		return -EINVAL;
+
+	/* Indexes held in the lcore caches and indexes of deleted keys
+	 * still owned by the application cannot be accounted for.
+	 * Without the multi-writer flag, the caller is the only writer,
+	 * so the tables cannot change while the new ones are built.
+	 */
+	if (h->use_local_cache || h->aging != NULL ||
+			(h->no_free_on_del && h->hash_rcu_cfg == NULL))
+		return -ENOTSUP;
+
+	num_key_slots = entries + 1;
+	old_key_slots = h->entries + 1;
+	num_buckets = rte_align32pow2(entries) / RTE_HASH_BUCKET_ENTRIES;
+
+	if (h->hash_rcu_cfg != NULL) {
+		/* Free the keys deleted before the resize */
+		rte_rcu_qsbr_synchronize(h->hash_rcu_cfg->v,
+					RTE_QSBR_THRID_INVALID);
+		if (h->dq != NULL) {
+			__hash_rw_writer_lock(h);
+			rte_rcu_qsbr_dq_reclaim(h->dq, ~0, NULL, &pending,
+						NULL);
+			__hash_rw_writer_unlock(h);
+			if (pending != 0)
+				return -EAGAIN;
+		}
+	}
+
+	free_idx = rte_malloc(NULL, sizeof(uint32_t) *
+			RTE_MAX(num_key_slots, old_key_slots), 0);
+	if (free_idx == NULL)
+		return -ENOMEM;
+	num_free = rte_ring_sc_dequeue_burst_elem(h->free_slots, free_idx,
+				sizeof(uint32_t), old_key_slots - 1, NULL);
+
+	if (old_key_slots - 1 - num_free > entries) {
+		ret = -ENOSPC;
+		goto err_free;
+	}
+
+	/* Free positions that remain within the new size go first, they
+	 * take the keys stored beyond it when shrinking.
+	 */
+	for (i = 0, num_low = 0; i < num_free; i++) {
+		if (free_idx[i] < num_key_slots) {
+			key_idx = free_idx[num_low];
+			free_idx[num_low++] = free_idx[i];
+			free_idx[i] = key_idx;
+		}
+	}
+
+	ret = -ENOMEM;
+	k = rte_zmalloc_socket(NULL, (uint64_t)h->key_entry_size *
+			num_key_slots, RTE_CACHE_LINE_SIZE, h->socket_id);
+	buckets = bucket_table_alloc(num_buckets, h->socket_id);
+	if (k == NULL || buckets == NULL) {
+		RTE_LOG(ERR, HASH, "memory allocation failed\n");
+		goto err_free;
+	}
+
+	if (rte_ring_get_capacity(h->free_slots) < num_key_slots - 1) {
+		snprintf(ring_name, sizeof(ring_name), "HT%u_%s", entries,
+								h->name);
+		r = rte_ring_create_elem(ring_name, sizeof(uint32_t),
+				rte_align32pow2(num_key_slots), h->socket_id, 0);
+		if (r == NULL) {
+			RTE_LOG(ERR, HASH, "memory allocation failed\n");
+			goto err_free;
+		}
+	}
+
+	if (h->ext_table_support) {
+		buckets_ext = rte_zmalloc_socket(NULL,
+				num_buckets * sizeof(struct rte_hash_bucket),
+				RTE_CACHE_LINE_SIZE, h->socket_id);
+		if (buckets_ext == NULL) {
+			RTE_LOG(ERR, HASH, "ext buckets memory allocation "
+							"failed\n");
+			goto err_free;
+		}
+
+		if (rte_ring_get_capacity(h->free_ext_bkts) < num_buckets) {
+			snprintf(ring_name, sizeof(ring_name), "HT_EXT%u_%s",
+							entries, h->name);
+			r_ext = rte_ring_create_elem(ring_name,
+					sizeof(uint32_t),
+					rte_align32pow2(num_buckets + 1),
+					h->socket_id, 0);
+			if (r_ext == NULL) {
+				RTE_LOG(ERR, HASH, "ext buckets memory "
+						"allocation failed\n");
+				goto err_free;
+			}
+		}
+
+		if (h->readwrite_concur_lf_support) {
+			ext_bkt_to_free = rte_zmalloc(NULL, sizeof(uint32_t) *
+							num_key_slots, 0);
+			if (ext_bkt_to_free == NULL) {
+				RTE_LOG(ERR, HASH, "ext bkt to free memory "
+						"allocation failed\n");
+				goto err_free;
+			}
+		}
+	}
+
+	/* The new tables are described by a copy of the table header and
+	 * filled without locks or barriers, as no reader can see them yet.
+	 * Readers keep using the current tables meanwhile.
+	 */
+	bucket_table_hdr(buckets)->key_store = k;
+	t = *h;
+	t.key_store = k;
+	t.buckets = buckets;
+	t.buckets_ext = buckets_ext;
+	t.num_buckets = num_buckets;
+	t.bucket_bitmask = num_buckets - 1;
+	t.writer_takes_lock = 0;
+	t.readwrite_concur_lf_support = 0;
+	t.tbl_chng_cnt = &tbl_chng_cnt;
+
+	memcpy(k, h->key_store, (size_t)h->key_entry_size *
+			RTE_MIN(num_key_slots, old_key_slots));
+
+	ret = -ENOSPC;
+	for (i = 0, n = 0; i < h->num_buckets; i++) {
+		FOR_EACH_BUCKET(cur_bkt, &h->buckets[i]) {
+			for (j = 0; j < RTE_HASH_BUCKET_ENTRIES; j++) {
+				key_idx = cur_bkt->key_idx[j];
+				if (key_idx == EMPTY_SLOT)
+					continue;
+				key_slot = RTE_PTR_ADD(h->key_store,
+					(size_t)key_idx * h->key_entry_size);
+				if (key_idx >= num_key_slots) {
+					/* Move the key within the new size */
+					key_idx = free_idx[n++];
+					memcpy(RTE_PTR_ADD(k, (size_t)key_idx *
+						h->key_entry_size), key_slot,
+						h->key_entry_size);
+				}
+				if (resize_insert(&t, &ext_idx,
+						rte_hash_hash(h, key_slot->key),
+						key_idx) < 0)
+					goto err_free;
+			}
+		}
+	}
+
+	if (h->dq != NULL && num_key_slots > old_key_slots &&
+			h->hash_rcu_cfg->dq_size == old_key_slots)
+		resize_rcu_qsbr_dq(h, num_key_slots);
+
+	/* Only the switch to the new tables is done under the writer lock */
+	__hash_rw_writer_lock(h);
+
+	old_k = h->key_store;
+	old_buckets = h->buckets;
+	old_buckets_ext = h->buckets_ext;
+	old_ext_bkt_to_free = h->ext_bkt_to_free;
+
+	/* Readers take the key store from the header of the bucket table
+	 * they loaded, so old buckets are never used with the new key
+	 * store, whose key indexes may refer past the end of it.
+	 */
+	h->key_store = k;
+	h->buckets_ext = buckets_ext;
+	h->ext_bkt_to_free = ext_bkt_to_free;
+	__atomic_store_n(&h->buckets, buckets, __ATOMIC_RELEASE);
+	h->num_buckets = num_buckets;
+	h->bucket_bitmask = num_buckets - 1;
+	h->entries = entries;
+	__atomic_store_n(h->tbl_chng_cnt, *h->tbl_chng_cnt + 1,
+			 __ATOMIC_RELEASE);
+
+	__hash_rw_writer_unlock(h);
+
+	/* Give back the free positions not taken by moved keys, and add
+	 * the new ones.
+	 */
+	if (r != NULL) {
+		old_r = h->free_slots;
+		h->free_slots = r;
+	}
+	memmove(free_idx, &free_idx[n], (num_low - n) * sizeof(uint32_t));
+	n = num_low - n;
+	for (i = old_key_slots; i < num_key_slots; i++)
+		free_idx[n++] = i;
+	rte_ring_sp_enqueue_bulk_elem(h->free_slots, free_idx,
+				sizeof(uint32_t), n, NULL);
+
+	if (h->ext_table_support) {
+		if (r_ext != NULL) {
+			old_r_ext = h->free_ext_bkts;
+			h->free_ext_bkts = r_ext;
+		} else
+			rte_ring_reset(h->free_ext_bkts);
+		for (i = ext_idx; i <= num_buckets; i++)
+			rte_ring_sp_enqueue_elem(h->free_ext_bkts, &i,
+							sizeof(uint32_t));
+	}
+
+	/* Lock free readers may still be walking the old tables */
+	if (h->readwrite_concur_lf_support)
+		rte_rcu_qsbr_synchronize(h->hash_rcu_cfg->v,
+					RTE_QSBR_THRID_INVALID);
+
+	rte_free(old_k);
+	bucket_table_free(old_buckets);
+	rte_free(old_buckets_ext);
+	rte_free(old_ext_bkt_to_free);
+	rte_ring_free(old_r);
+	rte_ring_free(old_r_ext);
+	rte_free(free_idx);
+
+	return 0;
+
+err_free:
+	rte_ring_sp_enqueue_bulk_elem(h->free_slots, free_idx,
+				sizeof(uint32_t), num_free, NULL);
+	rte_free(free_idx);
+	rte_free(k);
+	bucket_table_free(buckets);
+	rte_free(buckets_ext);
+	rte_free(ext_bkt_to_free);
+	rte_ring_free(r);
+	rte_ring_free(r_ext);
+	return ret;
+}
+
 static inline void
 remove_entry(const struct rte_hash *h, struct rte_hash_bucket *bkt,
 		unsigned int i)
@@ -1676,25 +2179,23 @@ search_and_remove(const struct rte_hash *h, const void *key,
 	return -1;
 }
 
+/* Remove a key from its buckets. Writer holds the lock before calling
+ * this. The index of an ext bkt emptied by the removal is returned in
+ * ext_bkt_idx, EMPTY_SLOT otherwise.
+ */
 static inline int32_t
-__rte_hash_del_key_with_hash(const struct rte_hash *h, const void *key,
-						hash_sig_t sig)
+__rte_hash_del_key_bkt(const struct rte_hash *h, const void *key,
+			uint16_t short_sig, struct rte_hash_bucket *prim_bkt,
+			struct rte_hash_bucket *sec_bkt, uint32_t *ext_bkt_idx)
 {
-	uint32_t prim_bucket_idx, sec_bucket_idx;
-	struct rte_hash_bucket *prim_bkt, *sec_bkt, *prev_bkt, *last_bkt;
+	struct rte_hash_bucket *prev_bkt, *last_bkt;
 	struct rte_hash_bucket *cur_bkt;
 	int pos;
 	int32_t ret, i;
-	uint16_t short_sig;
-	uint32_t index = EMPTY_SLOT;
-	struct __rte_hash_rcu_dq_entry rcu_dq_entry;
+	uint32_t index;
 
-	short_sig = get_short_sig(sig);
-	prim_bucket_idx = get_prim_bucket_index(h, sig);
-	sec_bucket_idx = get_alt_bucket_index(h, prim_bucket_idx, short_sig);
-	prim_bkt = &h->buckets[prim_bucket_idx];
+	*ext_bkt_idx = EMPTY_SLOT;
 
-	__hash_rw_writer_lock(h);
 	/* look for key in primary bucket */
 	ret = search_and_remove(h, key, prim_bkt, short_sig, &pos);
 	if (ret != -1) {
@@ -1704,9 +2205,6 @@ __rte_hash_del_key_with_hash(const struct rte_hash *h, const void *key,
 		goto return_bkt;
 	}
 
-	/* Calculate secondary hash */
-	sec_bkt = &h->buckets[sec_bucket_idx];
-
 	FOR_EACH_BUCKET(cur_bkt, sec_bkt) {
 		ret = search_and_remove(h, key, cur_bkt, short_sig, &pos);
 		if (ret != -1) {
@@ -1717,13 +2215,12 @@ __rte_hash_del_key_with_hash(const struct rte_hash *h, const void *key,
 		}
 	}
 
-	__hash_rw_writer_unlock(h);
 	return -ENOENT;
 
 /* Search last bucket to see if empty to be recycled */
 return_bkt:
 	if (!last_bkt)
-		goto return_key;
+		return ret;
 
 	while (last_bkt->next) {
 		prev_bkt = last_bkt;
@@ -1738,6 +2235,7 @@ __rte_hash_del_key_with_hash(const struct rte_hash *h, const void *key,
 	if (i == RTE_HASH_BUCKET_ENTRIES) {
 		prev_bkt->next = NULL;
 		index = last_bkt - h->buckets_ext + 1;
+		*ext_bkt_idx = index;
 		/* Recycle the empty bkt if
 		 * no_free_on_del is disabled.
 		 */
@@ -1758,24 +2256,60 @@ __rte_hash_del_key_with_hash(const struct rte_hash *h, const void *key,
 							sizeof(uint32_t));
 	}
 
-return_key:
+	return ret;
+}
+
+/* Hand deleted entries over to the integrated RCU QSBR. Writer holds the
+ * lock before calling this.
+ */
+static inline void
+__hash_rcu_qsbr_free_deleted(const struct rte_hash *h,
+			struct __rte_hash_rcu_dq_entry *rcu_dq_entry,
+			unsigned int n)
+{
+	unsigned int i;
+
+	if (h->dq == NULL) {
+		/* Wait for quiescent state change if using
+		 * RTE_HASH_QSBR_MODE_SYNC, once for all the entries
+		 */
+		rte_rcu_qsbr_synchronize(h->hash_rcu_cfg->v,
+					 RTE_QSBR_THRID_INVALID);
+		for (i = 0; i < n; i++)
+			__hash_rcu_qsbr_free_resource((void *)((uintptr_t)h),
+						      &rcu_dq_entry[i], 1);
+		return;
+	}
+
+	/* Push into QSBR FIFO if using RTE_HASH_QSBR_MODE_DQ */
+	for (i = 0; i < n; i++)
+		if (rte_rcu_qsbr_dq_enqueue(h->dq, &rcu_dq_entry[i]) != 0)
+			RTE_LOG(ERR, HASH, "Failed to push QSBR FIFO\n");
+}
+
+static inline int32_t
+__rte_hash_del_key_with_hash(const struct rte_hash *h, const void *key,
+						hash_sig_t sig)
+{
+	uint32_t prim_bucket_idx, sec_bucket_idx;
+	uint16_t short_sig;
+	int32_t ret;
+	struct __rte_hash_rcu_dq_entry rcu_dq_entry;
+
+	short_sig = get_short_sig(sig);
+	prim_bucket_idx = get_prim_bucket_index(h, sig);
+	sec_bucket_idx = get_alt_bucket_index(h, prim_bucket_idx, short_sig);
+
+	__hash_rw_writer_lock(h);
+	ret = __rte_hash_del_key_bkt(h, key, short_sig,
+			&h->buckets[prim_bucket_idx],
+			&h->buckets[sec_bucket_idx],
+			&rcu_dq_entry.ext_bkt_idx);
 	/* Using internal RCU QSBR */
-	if (h->hash_rcu_cfg) {
+	if (ret >= 0 && h->hash_rcu_cfg) {
 		/* Key index where key is stored, adding the first dummy index */
 		rcu_dq_entry.key_idx = ret + 1;
-		rcu_dq_entry.ext_bkt_idx = index;
-		if (h->dq == NULL) {
-			/* Wait for quiescent state change if using
-			 * RTE_HASH_QSBR_MODE_SYNC
-			 */
-			rte_rcu_qsbr_synchronize(h->hash_rcu_cfg->v,
-						 RTE_QSBR_THRID_INVALID);
-			__hash_rcu_qsbr_free_resource((void *)((uintptr_t)h),
-						      &rcu_dq_entry, 1);
-		} else if (h->dq)
-			/* Push into QSBR FIFO if using RTE_HASH_QSBR_MODE_DQ */
-			if (rte_rcu_qsbr_dq_enqueue(h->dq, &rcu_dq_entry) != 0)
-				RTE_LOG(ERR, HASH, "Failed to push QSBR FIFO\n");
+		__hash_rcu_qsbr_free_deleted(h, &rcu_dq_entry, 1);
 	}
 	__hash_rw_writer_unlock(h);
 	return ret;
@@ -1847,6 +2381,23 @@ rte_hash_free_key_with_position(const struct rte_hash *h,
 
 }
 
+#if defined(__SSE2__) && RTE_HASH_BUCKET_ENTRIES >= 8
+/* Match a signature against the signatures of a bucket, 8 at a time */
+static inline uint32_t
+compare_bucket_sse(const struct rte_hash_bucket *bkt, __m128i vsig)
+{
+	uint32_t matches = 0;
+	unsigned int i;
+
+	for (i = 0; i < RTE_HASH_BUCKET_ENTRIES; i += 8)
+		matches |= (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi16(
+				_mm_load_si128(
+				(__m128i const *)&bkt->sig_current[i]), vsig))
+				<< (i << 1);
+	return matches;
+}
+#endif
+
 static inline void
 compare_signatures(uint32_t *prim_hash_matches, uint32_t *sec_hash_matches,
 			const struct rte_hash_bucket *prim_bkt,
@@ -1858,35 +2409,42 @@ compare_signatures(uint32_t *prim_hash_matches, uint32_t *sec_hash_matches,
 
 	/* For match mask the first bit of every two bits indicates the match */
 	switch (sig_cmp_fn) {
-#if defined(__SSE2__)
-	case RTE_HASH_COMPARE_SSE:
-		/* Compare all signatures in the bucket */
-		*prim_hash_matches = _mm_movemask_epi8(_mm_cmpeq_epi16(
-				_mm_load_si128(
-					(__m128i const *)prim_bkt->sig_current),
-				_mm_set1_epi16(sig)));
-		/* Compare all signatures in the bucket */
-		*sec_hash_matches = _mm_movemask_epi8(_mm_cmpeq_epi16(
-				_mm_load_si128(
-					(__m128i const *)sec_bkt->sig_current),
-				_mm_set1_epi16(sig)));
+#if defined(CC_AVX2_SUPPORT) && RTE_HASH_BUCKET_ENTRIES >= 8
+	case RTE_HASH_COMPARE_AVX2:
+		compare_signatures_avx2(prim_hash_matches, sec_hash_matches,
+				prim_bkt, sec_bkt, sig);
+		break;
+#endif
+#if defined(__SSE2__) && RTE_HASH_BUCKET_ENTRIES >= 8
+	case RTE_HASH_COMPARE_SSE: {
+		__m128i vsig = _mm_set1_epi16(sig);
+
+		/* Compare all signatures in the buckets */
+		*prim_hash_matches = compare_bucket_sse(prim_bkt, vsig);
+		*sec_hash_matches = compare_bucket_sse(sec_bkt, vsig);
+		}
 		break;
-#elif defined(__ARM_NEON)
+#elif defined(__ARM_NEON) && RTE_HASH_BUCKET_ENTRIES >= 8
 	case RTE_HASH_COMPARE_NEON: {
 		uint16x8_t vmat, vsig, x;
 		int16x8_t shift = {-15, -13, -11, -9, -7, -5, -3, -1};
 
 		vsig = vld1q_dup_u16((uint16_t const *)&sig);
-		/* Compare all signatures in the primary bucket */
-		vmat = vceqq_u16(vsig,
-			vld1q_u16((uint16_t const *)prim_bkt->sig_current));
-		x = vshlq_u16(vandq_u16(vmat, vdupq_n_u16(0x8000)), shift);
-		*prim_hash_matches = (uint32_t)(vaddvq_u16(x));
-		/* Compare all signatures in the secondary bucket */
-		vmat = vceqq_u16(vsig,
-			vld1q_u16((uint16_t const *)sec_bkt->sig_current));
-		x = vshlq_u16(vandq_u16(vmat, vdupq_n_u16(0x8000)), shift);
-		*sec_hash_matches = (uint32_t)(vaddvq_u16(x));
+		/* Compare all signatures in the buckets, 8 at a time */
+		for (i = 0; i < RTE_HASH_BUCKET_ENTRIES; i += 8) {
+			vmat = vceqq_u16(vsig, vld1q_u16((uint16_t const *)
+					&prim_bkt->sig_current[i]));
+			x = vshlq_u16(vandq_u16(vmat, vdupq_n_u16(0x8000)),
+					shift);
+			*prim_hash_matches |=
+				(uint32_t)(vaddvq_u16(x)) << (i << 1);
+			vmat = vceqq_u16(vsig, vld1q_u16((uint16_t const *)
+					&sec_bkt->sig_current[i]));
+			x = vshlq_u16(vandq_u16(vmat, vdupq_n_u16(0x8000)),
+					shift);
+			*sec_hash_matches |=
+				(uint32_t)(vaddvq_u16(x)) << (i << 1);
+		}
 		}
 		break;
 #endif
@@ -1902,6 +2460,7 @@ compare_signatures(uint32_t *prim_hash_matches, uint32_t *sec_hash_matches,
 
 static inline void
 __bulk_lookup_l(const struct rte_hash *h, const void **keys,
+		const struct rte_hash_key *key_store,
 		const struct rte_hash_bucket **primary_bkt,
 		const struct rte_hash_bucket **secondary_bkt,
 		uint16_t *sig, int32_t num_keys, int32_t *positions,
@@ -1914,8 +2473,6 @@ __bulk_lookup_l(const struct rte_hash *h, const void **keys,
 	uint32_t sec_hitmask[RTE_HASH_LOOKUP_BULK_MAX] = {0};
 	struct rte_hash_bucket *cur_bkt, *next_bkt;
 
-	__hash_rw_reader_lock(h);
-
 	/* Compare signatures and prefetch key slot of first hit */
 	for (i = 0; i < num_keys; i++) {
 		compare_signatures(&prim_hitmask[i], &sec_hitmask[i],
@@ -1930,7 +2487,7 @@ __bulk_lookup_l(const struct rte_hash *h, const void **keys,
 				primary_bkt[i]->key_idx[first_hit];
 			const struct rte_hash_key *key_slot =
 				(const struct rte_hash_key *)(
-				(const char *)h->key_store +
+				(const char *)key_store +
 				key_idx * h->key_entry_size);
 			rte_prefetch0(key_slot);
 			continue;
@@ -1944,7 +2501,7 @@ __bulk_lookup_l(const struct rte_hash *h, const void **keys,
 				secondary_bkt[i]->key_idx[first_hit];
 			const struct rte_hash_key *key_slot =
 				(const struct rte_hash_key *)(
-				(const char *)h->key_store +
+				(const char *)key_store +
 				key_idx * h->key_entry_size);
 			rte_prefetch0(key_slot);
 		}
@@ -1961,7 +2518,7 @@ __bulk_lookup_l(const struct rte_hash *h, const void **keys,
 				primary_bkt[i]->key_idx[hit_index];
 			const struct rte_hash_key *key_slot =
 				(const struct rte_hash_key *)(
-				(const char *)h->key_store +
+				(const char *)key_store +
 				key_idx * h->key_entry_size);
 
 			/*
@@ -1989,7 +2546,7 @@ __bulk_lookup_l(const struct rte_hash *h, const void **keys,
 				secondary_bkt[i]->key_idx[hit_index];
 			const struct rte_hash_key *key_slot =
 				(const struct rte_hash_key *)(
-				(const char *)h->key_store +
+				(const char *)key_store +
 				key_idx * h->key_entry_size);
 
 			/*
@@ -2017,7 +2574,6 @@ __bulk_lookup_l(const struct rte_hash *h, const void **keys,
 	if ((hits == ((1ULL << num_keys) - 1)) || !h->ext_table_support) {
 		if (hit_mask != NULL)
 			*hit_mask = hits;
-		__hash_rw_reader_unlock(h);
 		return;
 	}
 
@@ -2028,10 +2584,10 @@ __bulk_lookup_l(const struct rte_hash *h, const void **keys,
 		next_bkt = secondary_bkt[i]->next;
 		FOR_EACH_BUCKET(cur_bkt, next_bkt) {
 			if (data != NULL)
-				ret = search_one_bucket_l(h, keys[i],
+				ret = search_one_bucket_l(h, key_store, keys[i],
 						sig[i], &data[i], cur_bkt);
 			else
-				ret = search_one_bucket_l(h, keys[i],
+				ret = search_one_bucket_l(h, key_store, keys[i],
 						sig[i], NULL, cur_bkt);
 			if (ret != -1) {
 				positions[i] = ret;
@@ -2041,17 +2597,14 @@ __bulk_lookup_l(const struct rte_hash *h, const void **keys,
 		}
 	}
 
-	__hash_rw_reader_unlock(h);
-
 	if (hit_mask != NULL)
 		*hit_mask = hits;
 }
 
 static inline void
 __bulk_lookup_lf(const struct rte_hash *h, const void **keys,
-		const struct rte_hash_bucket **primary_bkt,
-		const struct rte_hash_bucket **secondary_bkt,
-		uint16_t *sig, int32_t num_keys, int32_t *positions,
+		const hash_sig_t *prim_hash, const uint16_t *sig,
+		int32_t num_keys, int32_t *positions,
 		uint64_t *hit_mask, void *data[])
 {
 	uint64_t hits = 0;
@@ -2059,7 +2612,12 @@ __bulk_lookup_lf(const struct rte_hash *h, const void **keys,
 	int32_t ret;
 	uint32_t prim_hitmask[RTE_HASH_LOOKUP_BULK_MAX] = {0};
 	uint32_t sec_hitmask[RTE_HASH_LOOKUP_BULK_MAX] = {0};
+	const struct rte_hash_bucket *primary_bkt[RTE_HASH_LOOKUP_BULK_MAX];
+	const struct rte_hash_bucket *secondary_bkt[RTE_HASH_LOOKUP_BULK_MAX];
+	const struct rte_hash_bucket *buckets;
+	const struct rte_hash_key *key_store;
 	struct rte_hash_bucket *cur_bkt, *next_bkt;
+	uint32_t bitmask, prim_index;
 	uint32_t cnt_b, cnt_a;
 
 	for (i = 0; i < num_keys; i++)
@@ -2073,6 +2631,17 @@ __bulk_lookup_lf(const struct rte_hash *h, const void **keys,
 		cnt_b = __atomic_load_n(h->tbl_chng_cnt,
 					__ATOMIC_ACQUIRE);
 
+		/* The table may have been resized since the last try, the
+		 * buckets and the key store are taken from the same table.
+		 */
+		buckets = get_bucket_table(h, &bitmask, &key_store);
+		for (i = 0; i < num_keys; i++) {
+			prim_index = prim_hash[i] & bitmask;
+			primary_bkt[i] = &buckets[prim_index];
+			secondary_bkt[i] =
+				&buckets[(prim_index ^ sig[i]) & bitmask];
+		}
+
 		/* Compare signatures and prefetch key slot of first hit */
 		for (i = 0; i < num_keys; i++) {
 			compare_signatures(&prim_hitmask[i], &sec_hitmask[i],
@@ -2087,7 +2656,7 @@ __bulk_lookup_lf(const struct rte_hash *h, const void **keys,
 					primary_bkt[i]->key_idx[first_hit];
 				const struct rte_hash_key *key_slot =
 					(const struct rte_hash_key *)(
-					(const char *)h->key_store +
+					(const char *)key_store +
 					key_idx * h->key_entry_size);
 				rte_prefetch0(key_slot);
 				continue;
@@ -2101,7 +2670,7 @@ __bulk_lookup_lf(const struct rte_hash *h, const void **keys,
 					secondary_bkt[i]->key_idx[first_hit];
 				const struct rte_hash_key *key_slot =
 					(const struct rte_hash_key *)(
-					(const char *)h->key_store +
+					(const char *)key_store +
 					key_idx * h->key_entry_size);
 				rte_prefetch0(key_slot);
 			}
@@ -2119,7 +2688,7 @@ __bulk_lookup_lf(const struct rte_hash *h, const void **keys,
 					__ATOMIC_ACQUIRE);
 				const struct rte_hash_key *key_slot =
 					(const struct rte_hash_key *)(
-					(const char *)h->key_store +
+					(const char *)key_store +
 					key_idx * h->key_entry_size);
 
 				/*
@@ -2151,7 +2720,7 @@ __bulk_lookup_lf(const struct rte_hash *h, const void **keys,
 					__ATOMIC_ACQUIRE);
 				const struct rte_hash_key *key_slot =
 					(const struct rte_hash_key *)(
-					(const char *)h->key_store +
+					(const char *)key_store +
 					key_idx * h->key_entry_size);
 
 				/*
@@ -2192,12 +2761,13 @@ __bulk_lookup_lf(const struct rte_hash *h, const void **keys,
 				FOR_EACH_BUCKET(cur_bkt, next_bkt) {
 					if (data != NULL)
 						ret = search_one_bucket_lf(h,
-							keys[i], sig[i],
-							&data[i], cur_bkt);
+							key_store, keys[i],
+							sig[i], &data[i],
+							cur_bkt);
 					else
 						ret = search_one_bucket_lf(h,
-								keys[i], sig[i],
-								NULL, cur_bkt);
+							key_store, keys[i],
+							sig[i], NULL, cur_bkt);
 					if (ret != -1) {
 						positions[i] = ret;
 						hits |= 1ULL << i;
@@ -2230,14 +2800,18 @@ __bulk_lookup_lf(const struct rte_hash *h, const void **keys,
 static inline void
 __bulk_lookup_prefetching_loop(const struct rte_hash *h,
 	const void **keys, int32_t num_keys,
-	uint16_t *sig,
+	hash_sig_t *prim_hash, uint16_t *sig,
 	const struct rte_hash_bucket **primary_bkt,
-	const struct rte_hash_bucket **secondary_bkt)
+	const struct rte_hash_bucket **secondary_bkt,
+	const struct rte_hash_key **key_store)
 {
 	int32_t i;
-	uint32_t prim_hash[RTE_HASH_LOOKUP_BULK_MAX];
 	uint32_t prim_index[RTE_HASH_LOOKUP_BULK_MAX];
 	uint32_t sec_index[RTE_HASH_LOOKUP_BULK_MAX];
+	const struct rte_hash_bucket *buckets;
+	uint32_t bitmask;
+
+	buckets = get_bucket_table(h, &bitmask, key_store);
 
 	/* Prefetch first keys */
 	for (i = 0; i < PREFETCH_OFFSET && i < num_keys; i++)
@@ -2253,11 +2827,11 @@ __bulk_lookup_prefetching_loop(const struct rte_hash *h,
 		prim_hash[i] = rte_hash_hash(h, keys[i]);
 
 		sig[i] = get_short_sig(prim_hash[i]);
-		prim_index[i] = get_prim_bucket_index(h, prim_hash[i]);
-		sec_index[i] = get_alt_bucket_index(h, prim_index[i], sig[i]);
+		prim_index[i] = prim_hash[i] & bitmask;
+		sec_index[i] = (prim_index[i] ^ sig[i]) & bitmask;
 
-		primary_bkt[i] = &h->buckets[prim_index[i]];
-		secondary_bkt[i] = &h->buckets[sec_index[i]];
+		primary_bkt[i] = &buckets[prim_index[i]];
+		secondary_bkt[i] = &buckets[sec_index[i]];
 
 		rte_prefetch0(primary_bkt[i]);
 		rte_prefetch0(secondary_bkt[i]);
@@ -2268,11 +2842,11 @@ __bulk_lookup_prefetching_loop(const struct rte_hash *h,
 		prim_hash[i] = rte_hash_hash(h, keys[i]);
 
 		sig[i] = get_short_sig(prim_hash[i]);
-		prim_index[i] = get_prim_bucket_index(h, prim_hash[i]);
-		sec_index[i] = get_alt_bucket_index(h, prim_index[i], sig[i]);
+		prim_index[i] = prim_hash[i] & bitmask;
+		sec_index[i] = (prim_index[i] ^ sig[i]) & bitmask;
 
-		primary_bkt[i] = &h->buckets[prim_index[i]];
-		secondary_bkt[i] = &h->buckets[sec_index[i]];
+		primary_bkt[i] = &buckets[prim_index[i]];
+		secondary_bkt[i] = &buckets[sec_index[i]];
 
 		rte_prefetch0(primary_bkt[i]);
 		rte_prefetch0(secondary_bkt[i]);
@@ -2285,15 +2859,21 @@ __rte_hash_lookup_bulk_l(const struct rte_hash *h, const void **keys,
 			int32_t num_keys, int32_t *positions,
 			uint64_t *hit_mask, void *data[])
 {
+	hash_sig_t prim_hash[RTE_HASH_LOOKUP_BULK_MAX];
 	uint16_t sig[RTE_HASH_LOOKUP_BULK_MAX];
 	const struct rte_hash_bucket *primary_bkt[RTE_HASH_LOOKUP_BULK_MAX];
 	const struct rte_hash_bucket *secondary_bkt[RTE_HASH_LOOKUP_BULK_MAX];
+	const struct rte_hash_key *key_store;
 
-	__bulk_lookup_prefetching_loop(h, keys, num_keys, sig,
-		primary_bkt, secondary_bkt);
+	__hash_rw_reader_lock(h);
 
-	__bulk_lookup_l(h, keys, primary_bkt, secondary_bkt, sig, num_keys,
-		positions, hit_mask, data);
+	__bulk_lookup_prefetching_loop(h, keys, num_keys, prim_hash, sig,
+		primary_bkt, secondary_bkt, &key_store);
+
+	__bulk_lookup_l(h, keys, key_store, primary_bkt, secondary_bkt, sig,
+		num_keys, positions, hit_mask, data);
+
+	__hash_rw_reader_unlock(h);
 }
 
 static inline void
@@ -2301,14 +2881,16 @@ __rte_hash_lookup_bulk_lf(const struct rte_hash *h, const void **keys,
 			int32_t num_keys, int32_t *positions,
 			uint64_t *hit_mask, void *data[])
 {
+	hash_sig_t prim_hash[RTE_HASH_LOOKUP_BULK_MAX];
 	uint16_t sig[RTE_HASH_LOOKUP_BULK_MAX];
 	const struct rte_hash_bucket *primary_bkt[RTE_HASH_LOOKUP_BULK_MAX];
 	const struct rte_hash_bucket *secondary_bkt[RTE_HASH_LOOKUP_BULK_MAX];
+	const struct rte_hash_key *key_store;
 
-	__bulk_lookup_prefetching_loop(h, keys, num_keys, sig,
-		primary_bkt, secondary_bkt);
+	__bulk_lookup_prefetching_loop(h, keys, num_keys, prim_hash, sig,
+		primary_bkt, secondary_bkt, &key_store);
 
-	__bulk_lookup_lf(h, keys, primary_bkt, secondary_bkt, sig, num_keys,
+	__bulk_lookup_lf(h, keys, prim_hash, sig, num_keys,
 		positions, hit_mask, data);
 }
 
@@ -2366,6 +2948,13 @@ __rte_hash_lookup_with_hash_bulk_l(const struct rte_hash *h,
 	uint16_t sig[RTE_HASH_LOOKUP_BULK_MAX];
 	const struct rte_hash_bucket *primary_bkt[RTE_HASH_LOOKUP_BULK_MAX];
 	const struct rte_hash_bucket *secondary_bkt[RTE_HASH_LOOKUP_BULK_MAX];
+	const struct rte_hash_bucket *buckets;
+	const struct rte_hash_key *key_store;
+	uint32_t bitmask;
+
+	__hash_rw_reader_lock(h);
+
+	buckets = get_bucket_table(h, &bitmask, &key_store);
 
 	/*
 	 * Prefetch keys, calculate primary and
@@ -2375,18 +2964,20 @@ __rte_hash_lookup_with_hash_bulk_l(const struct rte_hash *h,
 		rte_prefetch0(keys[i]);
 
 		sig[i] = get_short_sig(prim_hash[i]);
-		prim_index[i] = get_prim_bucket_index(h, prim_hash[i]);
-		sec_index[i] = get_alt_bucket_index(h, prim_index[i], sig[i]);
+		prim_index[i] = prim_hash[i] & bitmask;
+		sec_index[i] = (prim_index[i] ^ sig[i]) & bitmask;
 
-		primary_bkt[i] = &h->buckets[prim_index[i]];
-		secondary_bkt[i] = &h->buckets[sec_index[i]];
+		primary_bkt[i] = &buckets[prim_index[i]];
+		secondary_bkt[i] = &buckets[sec_index[i]];
 
 		rte_prefetch0(primary_bkt[i]);
 		rte_prefetch0(secondary_bkt[i]);
 	}
 
-	__bulk_lookup_l(h, keys, primary_bkt, secondary_bkt, sig, num_keys,
-		positions, hit_mask, data);
+	__bulk_lookup_l(h, keys, key_store, primary_bkt, secondary_bkt, sig,
+		num_keys, positions, hit_mask, data);
+
+	__hash_rw_reader_unlock(h);
 }
 
 static inline void
@@ -2396,11 +2987,13 @@ __rte_hash_lookup_with_hash_bulk_lf(const struct rte_hash *h,
 			uint64_t *hit_mask, void *data[])
 {
 	int32_t i;
-	uint32_t prim_index[RTE_HASH_LOOKUP_BULK_MAX];
-	uint32_t sec_index[RTE_HASH_LOOKUP_BULK_MAX];
+	uint32_t prim_index, sec_index;
 	uint16_t sig[RTE_HASH_LOOKUP_BULK_MAX];
-	const struct rte_hash_bucket *primary_bkt[RTE_HASH_LOOKUP_BULK_MAX];
-	const struct rte_hash_bucket *secondary_bkt[RTE_HASH_LOOKUP_BULK_MAX];
+	const struct rte_hash_bucket *buckets;
+	const struct rte_hash_key *key_store;
+	uint32_t bitmask;
+
+	buckets = get_bucket_table(h, &bitmask, &key_store);
 
 	/*
 	 * Prefetch keys, calculate primary and
@@ -2410,17 +3003,14 @@ __rte_hash_lookup_with_hash_bulk_lf(const struct rte_hash *h,
 		rte_prefetch0(keys[i]);
 
 		sig[i] = get_short_sig(prim_hash[i]);
-		prim_index[i] = get_prim_bucket_index(h, prim_hash[i]);
-		sec_index[i] = get_alt_bucket_index(h, prim_index[i], sig[i]);
-
-		primary_bkt[i] = &h->buckets[prim_index[i]];
-		secondary_bkt[i] = &h->buckets[sec_index[i]];
+		prim_index = prim_hash[i] & bitmask;
+		sec_index = (prim_index ^ sig[i]) & bitmask;
 
-		rte_prefetch0(primary_bkt[i]);
-		rte_prefetch0(secondary_bkt[i]);
+		rte_prefetch0(&buckets[prim_index]);
+		rte_prefetch0(&buckets[sec_index]);
 	}
 
-	__bulk_lookup_lf(h, keys, primary_bkt, secondary_bkt, sig, num_keys,
+	__bulk_lookup_lf(h, keys, prim_hash, sig, num_keys,
 		positions, hit_mask, data);
 }
 
@@ -2470,6 +3060,330 @@ rte_hash_lookup_with_hash_bulk_data(const struct rte_hash *h,
 	return __builtin_popcountl(*hit_mask);
 }
 
+/*
+ * Hash all the keys of a bulk add or delete first, then compute their
+ * bucket indexes and prefetch the buckets, so that the cache misses of
+ * the batch overlap.
+ */
+static inline void
+__bulk_write_prefetching_loop(const struct rte_hash *h,
+	const void **keys, int32_t num_keys, hash_sig_t *sig,
+	uint32_t *prim_index, uint32_t *sec_index)
+{
+	int32_t i;
+
+	/* Prefetch first keys */
+	for (i = 0; i < PREFETCH_OFFSET && i < num_keys; i++)
+		rte_prefetch0(keys[i]);
+
+	for (i = 0; i < num_keys; i++) {
+		if (i + PREFETCH_OFFSET < num_keys)
+			rte_prefetch0(keys[i + PREFETCH_OFFSET]);
+
+		sig[i] = rte_hash_hash(h, keys[i]);
+		prim_index[i] = get_prim_bucket_index(h, sig[i]);
+		sec_index[i] = get_alt_bucket_index(h, prim_index[i],
+					get_short_sig(sig[i]));
+
+		rte_prefetch0(&h->buckets[prim_index[i]]);
+		rte_prefetch0(&h->buckets[sec_index[i]]);
+	}
+}
+
+int
+rte_hash_add_bulk(const struct rte_hash *h, const void **keys,
+		void *data[], uint32_t num_keys, int32_t *positions)
+{
+	hash_sig_t sig[RTE_HASH_LOOKUP_BULK_MAX];
+	uint32_t prim_index[RTE_HASH_LOOKUP_BULK_MAX];
+	uint32_t sec_index[RTE_HASH_LOOKUP_BULK_MAX];
+	struct rte_hash t;
+	const struct rte_hash *w = h;
+	uint32_t i;
+	int added = 0;
+
+	RETURN_IF_TRUE(((h == NULL) || (keys == NULL) || (num_keys == 0) ||
+			(num_keys > RTE_HASH_LOOKUP_BULK_MAX) ||
+			(positions == NULL)), -EINVAL);
+
+	__bulk_write_prefetching_loop(h, keys, num_keys, sig,
+			prim_index, sec_index);
+
+	/* The whole batch is added under one writer lock. The keys are
+	 * added through a copy of the table header that does not take the
+	 * lock again; it shares all the tables with h.
+	 */
+	if (h->writer_takes_lock) {
+		t = *h;
+		t.writer_takes_lock = 0;
+		w = &t;
+	}
+
+	__hash_rw_writer_lock(h);
+	for (i = 0; i < num_keys; i++) {
+		/* Buckets of the next keys may have been evicted by the
+		 * cuckoo path search of the previous ones.
+		 */
+		if (i + PREFETCH_OFFSET < num_keys) {
+			rte_prefetch0(&h->buckets[prim_index[i +
+						PREFETCH_OFFSET]]);
+			rte_prefetch0(&h->buckets[sec_index[i +
+						PREFETCH_OFFSET]]);
+		}
+		positions[i] = __rte_hash_add_key_with_idx(w, keys[i], sig[i],
+				data != NULL ? data[i] : NULL,
+				prim_index[i], sec_index[i]);
+		if (positions[i] >= 0)
+			added++;
+	}
+	__hash_rw_writer_unlock(h);
+
+	return added;
+}
+
+int
+rte_hash_del_bulk(const struct rte_hash *h, const void **keys,
+		uint32_t num_keys, int32_t *positions)
+{
+	hash_sig_t sig[RTE_HASH_LOOKUP_BULK_MAX];
+	uint32_t prim_index[RTE_HASH_LOOKUP_BULK_MAX];
+	uint32_t sec_index[RTE_HASH_LOOKUP_BULK_MAX];
+	struct __rte_hash_rcu_dq_entry rcu_dq_entry[RTE_HASH_LOOKUP_BULK_MAX];
+	uint32_t ext_bkt_idx;
+	uint32_t i;
+	unsigned int n_rcu = 0;
+	int deleted = 0;
+
+	RETURN_IF_TRUE(((h == NULL) || (keys == NULL) || (num_keys == 0) ||
+			(num_keys > RTE_HASH_LOOKUP_BULK_MAX) ||
+			(positions == NULL)), -EINVAL);
+
+	__bulk_write_prefetching_loop(h, keys, num_keys, sig,
+			prim_index, sec_index);
+
+	/* The whole batch is removed under one writer lock */
+	__hash_rw_writer_lock(h);
+	for (i = 0; i < num_keys; i++) {
+		positions[i] = __rte_hash_del_key_bkt(h, keys[i],
+				get_short_sig(sig[i]),
+				&h->buckets[prim_index[i]],
+				&h->buckets[sec_index[i]], &ext_bkt_idx);
+		if (positions[i] < 0)
+			continue;
+		deleted++;
+		if (h->hash_rcu_cfg) {
+			rcu_dq_entry[n_rcu].key_idx = positions[i] + 1;
+			rcu_dq_entry[n_rcu].ext_bkt_idx = ext_bkt_idx;
+			n_rcu++;
+		}
+	}
+	/* Using internal RCU QSBR, one grace period covers the batch */
+	if (n_rcu != 0)
+		__hash_rcu_qsbr_free_deleted(h, rcu_dq_entry, n_rcu);
+	__hash_rw_writer_unlock(h);
+
+	return deleted;
+}
+
+int
+rte_hash_aging_add(struct rte_hash *h, const struct rte_hash_aging_config *cfg)
+{
+	struct rte_hash_aging *a;
+	const void *key;
+	void *data;
+	uint32_t wheel_size, iter = 0, i;
+	uint64_t now;
+	int32_t pos;
+
+	if (h == NULL || cfg == NULL || cfg->timeout == 0) {
+		rte_errno = EINVAL;
+		return 1;
+	}
+
+	wheel_size = cfg->wheel_size;
+	if (wheel_size == 0)
+		wheel_size = RTE_HASH_AGING_WHEEL_SIZE;
+	if (wheel_size < 2 || !rte_is_power_of_2(wheel_size)) {
+		rte_errno = EINVAL;
+		return 1;
+	}
+
+	/* Indexes are queued by the single writer without any lock */
+	if (h->use_local_cache) {
+		rte_errno = ENOTSUP;
+		return 1;
+	}
+
+	if (h->aging) {
+		rte_errno = EEXIST;
+		return 1;
+	}
+
+	a = rte_zmalloc_socket(NULL, sizeof(struct rte_hash_aging), 0,
+				h->socket_id);
+	if (a == NULL)
+		goto err;
+	a->last_seen = rte_zmalloc_socket(NULL,
+				(h->entries + 1) * sizeof(uint64_t),
+				RTE_CACHE_LINE_SIZE, h->socket_id);
+	a->next = rte_malloc_socket(NULL, (h->entries + 1) * sizeof(uint32_t),
+				RTE_CACHE_LINE_SIZE, h->socket_id);
+	a->wheel = rte_zmalloc_socket(NULL, wheel_size * sizeof(uint32_t),
+				RTE_CACHE_LINE_SIZE, h->socket_id);
+	if (a->last_seen == NULL || a->next == NULL || a->wheel == NULL)
+		goto err;
+
+	/* A timeout spans less than one revolution of the wheel */
+	while ((cfg->timeout >> a->tick_shift) >= wheel_size - 1)
+		a->tick_shift++;
+	a->timeout = cfg->timeout;
+	a->wheel_mask = wheel_size - 1;
+	now = rte_get_timer_cycles();
+	a->cur_tick = now >> a->tick_shift;
+	for (i = 0; i < h->entries + 1; i++)
+		a->next[i] = AGING_NOT_QUEUED;
+
+	/* Keys already in the table start idling now */
+	while ((pos = rte_hash_iterate(h, &key, &data, &iter)) >= 0) {
+		a->last_seen[pos + 1] = now;
+		aging_enqueue(a, pos + 1, now + a->timeout);
+	}
+
+	h->aging = a;
+
+	return 0;
+
+err:
+	RTE_LOG(ERR, HASH, "memory allocation failed\n");
+	if (a != NULL) {
+		rte_free(a->last_seen);
+		rte_free(a->next);
+		rte_free(a->wheel);
+		rte_free(a);
+	}
+	rte_errno = ENOMEM;
+	return 1;
+}
+
+/* Record the use of a key found at the given position */
+static inline void
+aging_touch(const struct rte_hash *h, int32_t position, uint64_t now)
+{
+	uint64_t *last_seen = &h->aging->last_seen[position + 1];
+
+	/* Avoid dirtying the line when the key was already seen at now */
+	if (__atomic_load_n(last_seen, __ATOMIC_RELAXED) != now)
+		__atomic_store_n(last_seen, now, __ATOMIC_RELAXED);
+}
+
+int32_t
+rte_hash_lookup_touch(const struct rte_hash *h, const void *key, uint64_t now)
+{
+	int32_t ret;
+
+	RETURN_IF_TRUE(((h == NULL) || (key == NULL)), -EINVAL);
+
+	ret = __rte_hash_lookup_with_hash(h, key, rte_hash_hash(h, key), NULL);
+	if (ret >= 0 && h->aging)
+		aging_touch(h, ret, now);
+
+	return ret;
+}
+
+int
+rte_hash_lookup_bulk_touch(const struct rte_hash *h, const void **keys,
+		uint32_t num_keys, int32_t *positions, uint64_t now)
+{
+	uint32_t i;
+
+	RETURN_IF_TRUE(((h == NULL) || (keys == NULL) || (num_keys == 0) ||
+			(num_keys > RTE_HASH_LOOKUP_BULK_MAX) ||
+			(positions == NULL)), -EINVAL);
+
+	__rte_hash_lookup_bulk(h, keys, num_keys, positions, NULL, NULL);
+	if (h->aging == NULL)
+		return 0;
+
+	for (i = 0; i < num_keys; i++) {
+		if (positions[i] >= 0)
+			aging_touch(h, positions[i], now);
+	}
+
+	return 0;
+}
+
+int
+rte_hash_aging_expire(struct rte_hash *h, uint64_t now, int32_t *positions,
+		uint32_t max_positions)
+{
+	struct rte_hash_aging *a;
+	struct rte_hash_key *k;
+	uint64_t now_tick, last_seen;
+	uint32_t b, key_idx, next, tail;
+	uint32_t n = 0;
+
+	RETURN_IF_TRUE(((h == NULL) || (positions == NULL && max_positions)),
+			-EINVAL);
+
+	a = h->aging;
+	if (a == NULL)
+		return -EINVAL;
+
+	now_tick = now >> a->tick_shift;
+	/* Each bucket is walked at most once, however late the call is */
+	if (now_tick > a->cur_tick && now_tick - a->cur_tick > a->wheel_mask)
+		a->cur_tick = now_tick - a->wheel_mask - 1;
+
+	for (; a->cur_tick < now_tick; a->cur_tick++) {
+		b = a->cur_tick & a->wheel_mask;
+		key_idx = a->wheel[b];
+		a->wheel[b] = EMPTY_SLOT;
+
+		while (key_idx != EMPTY_SLOT) {
+			next = a->next[key_idx];
+			last_seen = __atomic_load_n(&a->last_seen[key_idx],
+						__ATOMIC_RELAXED);
+			if (last_seen + a->timeout > now) {
+				/* Used since it was queued */
+				aging_enqueue(a, key_idx,
+						last_seen + a->timeout);
+				key_idx = next;
+				continue;
+			}
+
+			/* Deleted keys are dropped from the wheel here */
+			k = RTE_PTR_ADD(h->key_store,
+					key_idx * h->key_entry_size);
+			if (rte_hash_lookup(h, k->key) != (int32_t)key_idx - 1) {
+				a->next[key_idx] = AGING_NOT_QUEUED;
+				key_idx = next;
+				continue;
+			}
+
+			if (n == max_positions) {
+				/* Put the rest back for the next call */
+				tail = key_idx;
+				while (a->next[tail] != EMPTY_SLOT)
+					tail = a->next[tail];
+				a->next[tail] = a->wheel[b];
+				a->wheel[b] = key_idx;
+				return n;
+			}
+
+			/* Reported again after another timeout unless used
+			 * or deleted.
+			 */
+			positions[n++] = key_idx - 1;
+			__atomic_store_n(&a->last_seen[key_idx], now,
+					__ATOMIC_RELAXED);
+			aging_enqueue(a, key_idx, now + a->timeout);
+			key_idx = next;
+		}
+	}
+
+	return n;
+}
+
 int32_t
 rte_hash_iterate(const struct rte_hash *h, const void **key, void **data, uint32_t *next)
 {
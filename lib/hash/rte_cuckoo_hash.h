@@ -11,14 +11,6 @@
 #ifndef _RTE_CUCKOO_HASH_H_
 #define _RTE_CUCKOO_HASH_H_
 
-#if defined(RTE_ARCH_X86)
-#include "rte_cmp_x86.h"
-#endif
-
-#if defined(RTE_ARCH_ARM64)
-#include "rte_cmp_arm64.h"
-#endif
-
 /* Macro to enable/disable run-time checking of function parameters */
 #if defined(RTE_LIBRTE_HASH_DEBUG)
 #define RETURN_IF_TRUE(cond, retval) do { \
@@ -61,23 +53,6 @@ enum cmp_jump_table_case {
 	KEY_OTHER_BYTES,
 	NUM_KEY_CMP_CASES,
 };
-
-/*
- * Table storing all different key compare functions
- * (multi-process supported)
- */
-const rte_hash_cmp_eq_t cmp_jump_table[NUM_KEY_CMP_CASES] = {
-	NULL,
-	rte_hash_k16_cmp_eq,
-	rte_hash_k32_cmp_eq,
-	rte_hash_k48_cmp_eq,
-	rte_hash_k64_cmp_eq,
-	rte_hash_k80_cmp_eq,
-	rte_hash_k96_cmp_eq,
-	rte_hash_k112_cmp_eq,
-	rte_hash_k128_cmp_eq,
-	memcmp
-};
 #else
 /*
  * All different options to select a key compare function,
@@ -88,26 +63,23 @@ enum cmp_jump_table_case {
 	KEY_OTHER_BYTES,
 	NUM_KEY_CMP_CASES,
 };
-
-/*
- * Table storing all different key compare functions
- * (multi-process supported)
- */
-const rte_hash_cmp_eq_t cmp_jump_table[NUM_KEY_CMP_CASES] = {
-	NULL,
-	memcmp
-};
-
 #endif
 
 
-/** Number of items per bucket. */
+/** Number of items per bucket, set with the hash_bucket_entries option. */
+#ifndef RTE_HASH_BUCKET_ENTRIES
 #define RTE_HASH_BUCKET_ENTRIES		8
+#endif
 
 #if !RTE_IS_POWER_OF_2(RTE_HASH_BUCKET_ENTRIES)
 #error RTE_HASH_BUCKET_ENTRIES must be a power of 2
 #endif
 
+/* Signature match masks hold two bits per entry in 32 bits */
+#if RTE_HASH_BUCKET_ENTRIES > 16
+#error RTE_HASH_BUCKET_ENTRIES must not be larger than 16
+#endif
+
 #define NULL_SIGNATURE			0
 
 #define EMPTY_SLOT			0
@@ -142,6 +114,7 @@ enum rte_hash_sig_compare_function {
 	RTE_HASH_COMPARE_SCALAR = 0,
 	RTE_HASH_COMPARE_SSE,
 	RTE_HASH_COMPARE_NEON,
+	RTE_HASH_COMPARE_AVX2,
 	RTE_HASH_COMPARE_NUM
 };
 
@@ -156,11 +129,45 @@ struct rte_hash_bucket {
 	void *next;
 } __rte_cache_aligned;
 
+#if defined(CC_AVX2_SUPPORT) && RTE_HASH_BUCKET_ENTRIES >= 8
+/* Signature compare of rte_cuckoo_hash_avx2.c, see compare_signatures() */
+void
+compare_signatures_avx2(uint32_t *prim_hash_matches,
+			uint32_t *sec_hash_matches,
+			const struct rte_hash_bucket *prim_bkt,
+			const struct rte_hash_bucket *sec_bkt,
+			uint16_t sig);
+#endif
+
+/** Header kept in the bucket slot in front of each bucket table */
+struct rte_hash_bucket_hdr {
+	uint32_t bucket_bitmask;
+	/**< Bitmask for getting bucket index from hash signature. */
+	void *key_store;
+	/**< Key store the key indexes of the table refer to. */
+};
+
+/** Idle time tracking of the keys, see rte_hash_aging_add() */
+struct rte_hash_aging {
+	uint64_t timeout;       /**< Idle time after which keys expire. */
+	uint64_t *last_seen;    /**< Last use time, per key index. */
+	uint32_t *next;
+	/**< Next key index in the same wheel bucket, per key index.
+	 * EMPTY_SLOT ends a list, AGING_NOT_QUEUED marks a key index
+	 * that is in no list.
+	 */
+	uint32_t *wheel;        /**< First key index of each wheel bucket. */
+	uint32_t wheel_mask;    /**< Number of wheel buckets minus 1. */
+	uint32_t tick_shift;    /**< Log2 of the time covered by a bucket. */
+	uint64_t cur_tick;      /**< Next wheel tick to expire. */
+};
+
 /** A hash table structure. */
 struct rte_hash {
 	char name[RTE_HASH_NAMESIZE];   /**< Name of the hash. */
 	uint32_t entries;               /**< Total table entries. */
 	uint32_t num_buckets;           /**< Number of buckets in table. */
+	int socket_id;                  /**< Socket the tables live on. */
 
 	struct rte_ring *free_slots;
 	/**< Ring that stores all indexes of the free slots in the key table */
@@ -173,6 +180,8 @@ struct rte_hash {
 	/**< HASH RCU QSBR configuration structure */
 	struct rte_rcu_qsbr_dq *dq;	/**< RCU QSBR defer queue. */
 
+	struct rte_hash_aging *aging;	/**< Idle time tracking, if enabled. */
+
 	/* Fields used in lookup */
 
 	uint32_t key_len __rte_cache_aligned;
@@ -238,4 +247,10 @@ struct queue_node {
 /** @internal Default RCU defer queue entries to reclaim in one go. */
 #define RTE_HASH_RCU_DQ_RECLAIM_MAX	16
 
+/** @internal Default number of buckets of the aging timer wheel. */
+#define RTE_HASH_AGING_WHEEL_SIZE	256
+
+/** @internal Marks a key index that is in no aging wheel bucket. */
+#define AGING_NOT_QUEUED		UINT32_MAX
+
 #endif
@@ -0,0 +1,46 @@
+/* SPDX-License-Identifier: BSD-3-Clause
+ * Copyright(c) 2010-2016 Intel Corporation
+ */
+
+#include <stdint.h>
+
+#include <rte_common.h>
+#include <rte_vect.h>
+
+#include "rte_hash.h"
+#include "rte_cuckoo_hash.h"
+
+/*
+ * Built with -mavx2 when the baseline does not include it, so it must only
+ * be called once the CPU is known to support AVX2, see rte_hash_create().
+ */
+void
+compare_signatures_avx2(uint32_t *prim_hash_matches,
+			uint32_t *sec_hash_matches,
+			const struct rte_hash_bucket *prim_bkt,
+			const struct rte_hash_bucket *sec_bkt,
+			uint16_t sig)
+{
+	__m256i vsig = _mm256_set1_epi16(sig);
+
+#if RTE_HASH_BUCKET_ENTRIES == 16
+	/* Compare all signatures of each bucket at once */
+	*prim_hash_matches = _mm256_movemask_epi8(_mm256_cmpeq_epi16(
+			_mm256_load_si256((__m256i const *)prim_bkt->sig_current),
+			vsig));
+	*sec_hash_matches = _mm256_movemask_epi8(_mm256_cmpeq_epi16(
+			_mm256_load_si256((__m256i const *)sec_bkt->sig_current),
+			vsig));
+#else
+	/* Compare both buckets at once, one per 128-bit lane */
+	uint32_t matches = _mm256_movemask_epi8(_mm256_cmpeq_epi16(
+			_mm256_inserti128_si256(_mm256_castsi128_si256(
+				_mm_load_si128((__m128i const *)
+					prim_bkt->sig_current)),
+				_mm_load_si128((__m128i const *)
+					sec_bkt->sig_current), 1),
+			vsig));
+	*prim_hash_matches = matches & 0xffff;
+	*sec_hash_matches = matches >> 16;
+#endif
+}
@@ -123,6 +123,19 @@ struct rte_hash_rcu_config {
 	/**< Function to call to free the resource (key-data). */
 };
 
+/** HASH aging configuration structure. */
+struct rte_hash_aging_config {
+	uint64_t timeout;
+	/**< Idle time after which a key expires, in timer cycles
+	 * (see rte_get_timer_cycles()).
+	 */
+	uint32_t wheel_size;
+	/**< Number of buckets of the timer wheel, a power of 2
+	 * (0 selects 256). Keys are reported expired up to about
+	 * 2 * timeout / (wheel_size - 1) cycles late.
+	 */
+};
+
 /** @internal A hash table structure. */
 struct rte_hash;
 
@@ -649,6 +662,75 @@ int
 rte_hash_lookup_bulk(const struct rte_hash *h, const void **keys,
 		      uint32_t num_keys, int32_t *positions);
 
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice
+ *
+ * Add multiple keys to the hash table, updating the data of the keys
+ * already present.
+ * All keys are hashed and their buckets prefetched before the first
+ * one is added, then they are added under a single writer lock.
+ * This operation is not multi-thread safe
+ * and should only be called from one thread by default.
+ * Thread safety can be enabled by setting flag during
+ * table creation.
+ *
+ * @param h
+ *   Hash table to add the keys to.
+ * @param keys
+ *   A pointer to a list of keys to add.
+ * @param data
+ *   A pointer to a list of data to store with the keys, or NULL to store
+ *   no data.
+ * @param num_keys
+ *   How many keys are in the keys list (less than RTE_HASH_LOOKUP_BULK_MAX).
+ * @param positions
+ *   Output containing, for each key, the position it was added at, as
+ *   returned by rte_hash_add_key(), or a negative error code
+ *   (-ENOSPC if there is no space in the hash for this key).
+ * @return
+ *   -EINVAL if there's an error, otherwise the number of keys added.
+ */
+__rte_experimental
+int
+rte_hash_add_bulk(const struct rte_hash *h, const void **keys,
+		void *data[], uint32_t num_keys, int32_t *positions);
+
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice
+ *
+ * Remove multiple keys from the hash table.
+ * All keys are hashed and their buckets prefetched first, then they are
+ * removed under a single writer lock. With the integrated RCU QSBR in
+ * RTE_HASH_QSBR_MODE_SYNC mode, the batch waits for a single grace period.
+ * This operation is not multi-thread safe
+ * and should only be called from one thread by default.
+ * Thread safety can be enabled by setting flag during
+ * table creation.
+ * If RTE_HASH_EXTRA_FLAGS_NO_FREE_ON_DEL or
+ * RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF is enabled and
+ * internal RCU is NOT enabled, the key indexes returned in positions
+ * must be freed with rte_hash_free_key_with_position(), as for
+ * rte_hash_del_key().
+ *
+ * @param h
+ *   Hash table to remove the keys from.
+ * @param keys
+ *   A pointer to a list of keys to remove.
+ * @param num_keys
+ *   How many keys are in the keys list (less than RTE_HASH_LOOKUP_BULK_MAX).
+ * @param positions
+ *   Output containing, for each key, the position it was removed from, as
+ *   returned by rte_hash_del_key(), or -ENOENT if the key was not found.
+ * @return
+ *   -EINVAL if there's an error, otherwise the number of keys removed.
+ */
+__rte_experimental
+int
+rte_hash_del_bulk(const struct rte_hash *h, const void **keys,
+		uint32_t num_keys, int32_t *positions);
+
 /**
  * Iterate through the hash table, returning key-value pairs.
  *
@@ -694,6 +776,155 @@ rte_hash_iterate(const struct rte_hash *h, const void **key, void **data, uint32
 __rte_experimental
 int rte_hash_rcu_qsbr_add(struct rte_hash *h, struct rte_hash_rcu_config *cfg);
 
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice
+ *
+ * Change the number of entries of a hash table while it is in use.
+ * New bucket and key tables are built beside the current ones and
+ * published at once, and the old tables are freed when no reader uses
+ * them anymore. Readers keep running on the current tables while the new
+ * ones are built; with RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY they only wait
+ * on the lock while the tables are switched.
+ * Keys keep their positions, except when shrinking: keys stored at
+ * positions beyond the new size are moved to free positions within it.
+ * This API must be called from the writer thread. For lock free tables,
+ * it waits on the RCU QSBR variable, so the caller must not be an online
+ * reader of it.
+ * Keys must have been added with the signature rte_hash_hash() returns
+ * for them, as the table is rebuilt from the stored keys.
+ * Iteration with rte_hash_iterate() must restart after a resize.
+ *
+ * @param h
+ *   Hash table to resize.
+ * @param entries
+ *   New number of entries, with the same limits as in rte_hash_create().
+ * @return
+ *   - 0 if successful.
+ *   - -EINVAL if the parameters are invalid.
+ *   - -ENOTSUP if the table uses RTE_HASH_EXTRA_FLAGS_MULTI_WRITER_ADD,
+ *     has aging enabled with rte_hash_aging_add(), or leaves the freeing of deleted keys to the application
+ *     (RTE_HASH_EXTRA_FLAGS_NO_FREE_ON_DEL, or lock free without RCU QSBR
+ *     added with rte_hash_rcu_qsbr_add()).
+ *   - -ENOSPC if the keys do not fit in the new table.
+ *   - -EAGAIN if deleted keys could not all be reclaimed.
+ *   - -ENOMEM if memory could not be allocated.
+ *   The table is left unchanged on error.
+ */
+__rte_experimental
+int rte_hash_resize(struct rte_hash *h, uint32_t entries);
+
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice
+ *
+ * Enable the tracking of the idle time of the keys of a hash table.
+ * Each key position gets a last use timestamp, updated by the
+ * rte_hash_lookup_touch() family, and keys are kept in a timer wheel so
+ * that rte_hash_aging_expire() only walks the keys due at that time
+ * instead of the whole table. Keys added from then on, and the keys
+ * already in the table, start idling at the time they are added.
+ * The wheel is maintained by the writer: this API,
+ * rte_hash_aging_expire() and the add APIs must be called from the same
+ * single writer thread. Touching lookups may run on any reader.
+ *
+ * @param h
+ *   the hash object to enable aging on
+ * @param cfg
+ *   aging configuration
+ * @return
+ *   On success - 0
+ *   On error - 1 with error code set in rte_errno.
+ *   Possible rte_errno codes are:
+ *   - EINVAL - invalid pointer, zero timeout or wheel size not a power of 2
+ *   - ENOTSUP - table uses RTE_HASH_EXTRA_FLAGS_MULTI_WRITER_ADD
+ *   - EEXIST - aging already enabled
+ *   - ENOMEM - memory allocation failure
+ */
+__rte_experimental
+int rte_hash_aging_add(struct rte_hash *h,
+		const struct rte_hash_aging_config *cfg);
+
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice
+ *
+ * Find a key in the hash table and, if found, record its use at the
+ * given time. Same as rte_hash_lookup() when aging is not enabled.
+ *
+ * @param h
+ *   Hash table to look in.
+ * @param key
+ *   Key to find.
+ * @param now
+ *   Current time, from rte_get_timer_cycles().
+ * @return
+ *   Same as rte_hash_lookup().
+ */
+__rte_experimental
+int32_t
+rte_hash_lookup_touch(const struct rte_hash *h, const void *key, uint64_t now);
+
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice
+ *
+ * Find multiple keys in the hash table and record the use of the keys
+ * found at the given time. Same as rte_hash_lookup_bulk() when aging is
+ * not enabled.
+ *
+ * @param h
+ *   Hash table to look in.
+ * @param keys
+ *   A pointer to a list of keys to look for.
+ * @param num_keys
+ *   How many keys are in the keys list (less than RTE_HASH_LOOKUP_BULK_MAX).
+ * @param positions
+ *   Output containing a list of values, corresponding to the list of keys
+ *   that can be used by the caller as an offset into an array of user data.
+ *   These values are unique for each key, and are the same values that were
+ *   returned when each key was added. If a key in the list was not found,
+ *   then -ENOENT will be the value.
+ * @param now
+ *   Current time, from rte_get_timer_cycles().
+ * @return
+ *   -EINVAL if there's an error, otherwise 0.
+ */
+__rte_experimental
+int
+rte_hash_lookup_bulk_touch(const struct rte_hash *h, const void **keys,
+		uint32_t num_keys, int32_t *positions, uint64_t now);
+
+/**
+ * @warning
+ * @b EXPERIMENTAL: this API may change without prior notice
+ *
+ * Report the keys that were not added or used for the aging timeout.
+ * Only the wheel buckets elapsed since the previous call are walked, so
+ * the cost follows the number of keys due rather than the table size.
+ * Keys are not deleted: the application deletes them once it has
+ * released their state. A reported key that is neither deleted nor used
+ * is reported again after another timeout.
+ * This API must be called from the writer thread, see rte_hash_aging_add().
+ *
+ * @param h
+ *   Hash table to expire keys from.
+ * @param now
+ *   Current time, from rte_get_timer_cycles().
+ * @param positions
+ *   Output array of the positions of the expired keys.
+ * @param max_positions
+ *   Size of the positions array. If more keys are expired, the next
+ *   call reports the rest.
+ * @return
+ *   - The number of positions stored.
+ *   - -EINVAL if the parameters are invalid or aging is not enabled.
+ */
+__rte_experimental
+int
+rte_hash_aging_expire(struct rte_hash *h, uint64_t now, int32_t *positions,
+		uint32_t max_positions);
+
 #ifdef __cplusplus
 }
 #endif
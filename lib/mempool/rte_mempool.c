@@ -42,10 +42,6 @@ static struct rte_tailq_elem rte_mempool_tailq = {
 };
 EAL_REGISTER_TAILQ(rte_mempool_tailq)
 
-#define CACHE_FLUSHTHRESH_MULTIPLIER 1.5
-#define CALC_CACHE_FLUSHTHRESH(c)	\
-	((typeof(c))((c) * CACHE_FLUSHTHRESH_MULTIPLIER))
-
 #if defined(RTE_ARCH_X86)
 /*
  * return the greatest common divisor between a and b (fast algorithm)
@@ -732,7 +728,7 @@ static void
 mempool_cache_init(struct rte_mempool_cache *cache, uint32_t size)
 {
 	cache->size = size;
-	cache->flushthresh = CALC_CACHE_FLUSHTHRESH(size);
+	cache->flushthresh = RTE_MEMPOOL_CACHE_FLUSHTHRESH(size);
 	cache->len = 0;
 }
 
@@ -792,6 +788,9 @@ rte_mempool_create_empty(const char *name, unsigned n, unsigned elt_size,
 	unsigned int mz_flags = RTE_MEMZONE_1GB|RTE_MEMZONE_SIZE_HINT_ONLY;
 	struct rte_mempool_objsz objsz;
 	unsigned lcore_id;
+	struct rte_mempool_cache_adapt *adapt;
+	size_t adapt_offset;
+	unsigned int cache_size_max;
 	int ret;
 
 	/* compilation-time checks */
@@ -816,7 +815,7 @@ rte_mempool_create_empty(const char *name, unsigned n, unsigned elt_size,
 
 	/* asked cache too big */
 	if (cache_size > RTE_MEMPOOL_CACHE_MAX_SIZE ||
-	    CALC_CACHE_FLUSHTHRESH(cache_size) > n) {
+	    RTE_MEMPOOL_CACHE_FLUSHTHRESH(cache_size) > n) {
 		rte_errno = EINVAL;
 		return NULL;
 	}
@@ -851,6 +850,11 @@ rte_mempool_create_empty(const char *name, unsigned n, unsigned elt_size,
 	mempool_size = MEMPOOL_HEADER_SIZE(mp, cache_size);
 	mempool_size += private_data_size;
 	mempool_size = RTE_ALIGN_CEIL(mempool_size, RTE_MEMPOOL_ALIGN);
+	/* adaptive cache state follows the private data */
+	adapt_offset = mempool_size;
+	if (cache_size != 0 && (flags & MEMPOOL_F_CACHE_ADAPTIVE))
+		mempool_size += sizeof(struct rte_mempool_cache_adapt) *
+			RTE_MAX_LCORE;
 
 	ret = snprintf(mz_name, sizeof(mz_name), RTE_MEMPOOL_MZ_FORMAT, name);
 	if (ret < 0 || ret >= (int)sizeof(mz_name)) {
@@ -890,12 +894,27 @@ rte_mempool_create_empty(const char *name, unsigned n, unsigned elt_size,
 	mp->local_cache = (struct rte_mempool_cache *)
 		RTE_PTR_ADD(mp, MEMPOOL_HEADER_SIZE(mp, 0));
 
-	/* Init all default caches. */
+	/*
+	 * Init all default caches. Adaptive caches are bounded so that a
+	 * single one can always be filled up to its flush threshold.
+	 */
 	if (cache_size != 0) {
 		for (lcore_id = 0; lcore_id < RTE_MAX_LCORE; lcore_id++)
 			mempool_cache_init(&mp->local_cache[lcore_id],
 					   cache_size);
 	}
+	if (cache_size != 0 && (flags & MEMPOOL_F_CACHE_ADAPTIVE)) {
+		cache_size_max = RTE_MIN(cache_size *
+			RTE_MEMPOOL_CACHE_ADAPT_GROWTH,
+			(unsigned int)RTE_MEMPOOL_CACHE_MAX_SIZE);
+		cache_size_max = RTE_MIN(cache_size_max, n * 2 / 3);
+		cache_size_max = RTE_MAX(cache_size_max, cache_size);
+		adapt = RTE_PTR_ADD(mp, adapt_offset);
+		memset(adapt, 0, sizeof(*adapt) * RTE_MAX_LCORE);
+		for (lcore_id = 0; lcore_id < RTE_MAX_LCORE; lcore_id++)
+			adapt[lcore_id].size_max = cache_size_max;
+		mp->cache_adapt = adapt;
+	}
 
 	te->data = mp;
 
@@ -1006,6 +1025,7 @@ rte_mempool_dump_cache(FILE *f, const struct rte_mempool *mp)
 	unsigned lcore_id;
 	unsigned count = 0;
 	unsigned cache_count;
+	uint64_t grows = 0, shrinks = 0;
 
 	fprintf(f, "  internal cache infos:\n");
 	fprintf(f, "    cache_size=%"PRIu32"\n", mp->cache_size);
@@ -1017,9 +1037,19 @@ rte_mempool_dump_cache(FILE *f, const struct rte_mempool *mp)
 		cache_count = mp->local_cache[lcore_id].len;
 		fprintf(f, "    cache_count[%u]=%"PRIu32"\n",
 			lcore_id, cache_count);
+		if (mp->cache_adapt != NULL) {
+			fprintf(f, "    cache_size[%u]=%"PRIu32"\n",
+				lcore_id, mp->local_cache[lcore_id].size);
+			grows += mp->cache_adapt[lcore_id].grows;
+			shrinks += mp->cache_adapt[lcore_id].shrinks;
+		}
 		count += cache_count;
 	}
 	fprintf(f, "    total_cache_count=%u\n", count);
+	if (mp->cache_adapt != NULL) {
+		fprintf(f, "    cache_grow=%"PRIu64"\n", grows);
+		fprintf(f, "    cache_shrink=%"PRIu64"\n", shrinks);
+	}
 	return count;
 }
 
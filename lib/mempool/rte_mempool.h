@@ -98,6 +98,19 @@ struct rte_mempool_cache {
 	void *objs[RTE_MEMPOOL_CACHE_MAX_SIZE * 3]; /**< Cache objects */
 } __rte_cache_aligned;
 
+/**
+ * @internal Run time state of the default cache of an lcore in a mempool
+ * created with MEMPOOL_F_CACHE_ADAPTIVE. It is kept out of struct
+ * rte_mempool_cache so that the cache layout does not change.
+ */
+struct rte_mempool_cache_adapt {
+	uint32_t size_max;  /**< Upper bound of the cache size. */
+	uint16_t refills;   /**< Refills from the pool in current period. */
+	uint16_t flushes;   /**< Flushes to the pool in current period. */
+	uint64_t grows;     /**< Number of times the cache grew. */
+	uint64_t shrinks;   /**< Number of times the cache shrank. */
+} __rte_cache_aligned;
+
 /**
  * A structure that stores the size of mempool elements.
  */
@@ -250,6 +263,13 @@ struct rte_mempool {
 	uint32_t nb_mem_chunks;          /**< Number of memory chunks */
 	struct rte_mempool_memhdr_list mem_list; /**< List of memory chunks */
 
+	/**
+	 * @internal Per-lcore state of the adaptive default caches, NULL
+	 * unless MEMPOOL_F_CACHE_ADAPTIVE is set. It fits in the padding
+	 * at the end of the structure, so its size and layout are kept.
+	 */
+	struct rte_mempool_cache_adapt *cache_adapt;
+
 #ifdef RTE_LIBRTE_MEMPOOL_DEBUG
 	/** Per-lcore statistics. */
 	struct rte_mempool_debug_stats stats[RTE_MAX_LCORE];
@@ -263,6 +283,19 @@ struct rte_mempool {
 #define MEMPOOL_F_SC_GET         0x0008 /**< Default get is "single-consumer".*/
 #define MEMPOOL_F_POOL_CREATED   0x0010 /**< Internal: pool is created. */
 #define MEMPOOL_F_NO_IOVA_CONTIG 0x0020 /**< Don't need IOVA contiguous objs. */
+#define MEMPOOL_F_CACHE_ADAPTIVE 0x0040 /**< Resize default caches at run time. */
+
+/**
+ * Number of pool accesses of an adaptive cache after which its size is
+ * reconsidered.
+ */
+#define RTE_MEMPOOL_CACHE_ADAPT_PERIOD 32
+
+/** An adaptive cache grows up to this factor of the pool cache size. */
+#define RTE_MEMPOOL_CACHE_ADAPT_GROWTH 4
+
+/** Calculate the flush threshold of a cache of the given size. */
+#define RTE_MEMPOOL_CACHE_FLUSHTHRESH(c) ((typeof(c))((c) * 3 / 2))
 
 /**
  * @internal When debug is enabled, store some statistics.
@@ -992,6 +1025,12 @@ typedef void (rte_mempool_ctor_t)(struct rte_mempool *, void *);
  *     "single-consumer". Otherwise, it is "multi-consumers".
  *   - MEMPOOL_F_NO_IOVA_CONTIG: If set, allocated objects won't
  *     necessarily be contiguous in IO memory.
+ *   - MEMPOOL_F_CACHE_ADAPTIVE: If set, the size of each default per-lcore
+ *     cache is adjusted at run time between *cache_size* and
+ *     RTE_MEMPOOL_CACHE_ADAPT_GROWTH times *cache_size*. A cache that
+ *     mostly refills from or mostly flushes to the common pool grows, so
+ *     that each access to the common pool moves more objects. A cache
+ *     accessing the common pool in both directions shrinks back.
  * @return
  *   The pointer to the new allocated mempool, on success. NULL on error
  *   with rte_errno set appropriately. Possible rte_errno values include:
@@ -1252,6 +1291,67 @@ rte_mempool_default_cache(struct rte_mempool *mp, unsigned lcore_id)
 	return &mp->local_cache[lcore_id];
 }
 
+/**
+ * @internal Account an access of a cache to the common pool and resize
+ * an adaptive cache at the end of each period.
+ *
+ * @param mp
+ *   A pointer to the mempool structure.
+ * @param cache
+ *   A pointer to a mempool cache structure.
+ * @param refill
+ *   Non-zero if the cache was refilled from the common pool, zero if it
+ *   was flushed to it.
+ */
+static __rte_always_inline void
+__mempool_cache_adapt(struct rte_mempool *mp, struct rte_mempool_cache *cache,
+		      int refill)
+{
+	struct rte_mempool_cache_adapt *adapt;
+	unsigned int lcore_id;
+	uint32_t imbalance, size;
+
+	if (likely(mp->cache_adapt == NULL))
+		return;
+
+	/* User-owned caches keep their size. */
+	lcore_id = rte_lcore_id();
+	if (lcore_id >= RTE_MAX_LCORE || cache != &mp->local_cache[lcore_id])
+		return;
+	adapt = &mp->cache_adapt[lcore_id];
+
+	if (refill)
+		adapt->refills++;
+	else
+		adapt->flushes++;
+	if (adapt->refills + adapt->flushes < RTE_MEMPOOL_CACHE_ADAPT_PERIOD)
+		return;
+
+	/*
+	 * A cache that goes to the common pool mostly in one direction
+	 * grows, so that each access moves more objects. Otherwise the
+	 * objects it holds are better left to the other lcores.
+	 */
+	imbalance = RTE_MAX(adapt->refills, adapt->flushes) -
+		RTE_MIN(adapt->refills, adapt->flushes);
+	size = cache->size;
+	if (imbalance * 4 >= RTE_MEMPOOL_CACHE_ADAPT_PERIOD * 3) {
+		size = RTE_MIN(size * 2, adapt->size_max);
+		if (size != cache->size)
+			adapt->grows++;
+	} else if (imbalance * 4 <= RTE_MEMPOOL_CACHE_ADAPT_PERIOD) {
+		size = RTE_MAX(size / 2, mp->cache_size);
+		if (size != cache->size)
+			adapt->shrinks++;
+	}
+
+	/* Excess objects of a shrunk cache are flushed by the next put. */
+	cache->size = size;
+	cache->flushthresh = RTE_MEMPOOL_CACHE_FLUSHTHRESH(size);
+	adapt->refills = 0;
+	adapt->flushes = 0;
+}
+
 /**
  * Flush a user-owned mempool cache to the specified mempool.
  *
@@ -1317,6 +1417,7 @@ __mempool_generic_put(struct rte_mempool *mp, void * const *obj_table,
 		rte_mempool_ops_enqueue_bulk(mp, &cache->objs[cache->size],
 				cache->len - cache->size);
 		cache->len = cache->size;
+		__mempool_cache_adapt(mp, cache, 0);
 	}
 
 	return;
@@ -1443,6 +1544,7 @@ __mempool_generic_get(struct rte_mempool *mp, void **obj_table,
 		}
 
 		cache->len += req;
+		__mempool_cache_adapt(mp, cache, 1);
 	}
 
 	/* Now fill in the response ... */